@@ -0,0 +1,66 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+/** \file velodyne_post_build_map.cpp
+    \brief This file builds a static map file from point files.
+  */
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "StaticMap.h"
+
+using namespace velodyne;
+
+int main(int argc, char** argv) {
+  if (argc < 5) {
+    std::cerr << "Usage: " << argv[0] << " <map file> <voxel size [m]> "
+      "<tile bits> <point file> [point file...]" << std::endl
+      << "Point files hold one \"x y z\" point of the map frame per line"
+      << std::endl;
+    return 1;
+  }
+  try {
+    std::vector<float> points;
+    for (int i = 4; i < argc; ++i) {
+      std::ifstream pointFile(argv[i]);
+      if (!pointFile)
+        throw std::runtime_error(std::string("cannot open ") + argv[i]);
+      float x, y, z;
+      while (pointFile >> x >> y >> z) {
+        points.push_back(x);
+        points.push_back(y);
+        points.push_back(z);
+      }
+    }
+    const size_t numVoxels = StaticMap::write(argv[1], std::atof(argv[2]),
+      std::atoi(argv[3]), points);
+    std::cout << "points: " << points.size() / 3 << std::endl
+      << "voxels: " << numVoxels << std::endl;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
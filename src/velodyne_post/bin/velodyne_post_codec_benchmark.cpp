@@ -0,0 +1,135 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file velodyne_post_codec_benchmark.cpp
+    \brief This file benchmarks the lossless scan codec on a scan log.
+  */
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <libsnappy/snappy.h>
+
+#include <libvelodyne/sensor/DataPacket.h>
+#include <libvelodyne/sensor/Calibration.h>
+
+#include "ScanBuffer.h"
+#include "ScanCodec.h"
+#include "ScanConverter.h"
+#include "ScanLogReader.h"
+
+using namespace velodyne;
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <log file> [calibration file]"
+      << std::endl;
+    return 1;
+  }
+  try {
+    std::vector<std::string> encodedScans;
+    ScanLogReader reader(argv[1]);
+    std::string encodedScan;
+    while (reader.readEncoded(encodedScan))
+      encodedScans.push_back(encodedScan);
+    std::shared_ptr<ScanConverter> converter;
+    if (argc > 2) {
+      std::ifstream calibFile(argv[2]);
+      Calibration calibration;
+      calibFile >> calibration;
+      converter = std::make_shared<ScanConverter>(calibration, 0.0, 1e3);
+    }
+    // packet payload size on the wire
+    const size_t packetSize = 1206;
+    size_t numPackets = 0;
+    size_t numPoints = 0;
+    size_t encodedSize = 0;
+    size_t snappySize = 0;
+    double decodeTime = 0.0;
+    double convertTime = 0.0;
+    double encodeTime = 0.0;
+    std::vector<DataPacket> dataPackets;
+    ScanBuffer scan;
+    std::string reencodedScan;
+    for (auto it = encodedScans.cbegin(); it != encodedScans.cend(); ++it) {
+      auto start = std::chrono::steady_clock::now();
+      ScanCodec::decode(*it, dataPackets);
+      auto end = std::chrono::steady_clock::now();
+      decodeTime += std::chrono::duration<double>(end - start).count();
+      start = std::chrono::steady_clock::now();
+      ScanCodec::encode(dataPackets, reencodedScan);
+      end = std::chrono::steady_clock::now();
+      encodeTime += std::chrono::duration<double>(end - start).count();
+      if (reencodedScan != *it) {
+        std::cerr << "Round trip mismatch in scan "
+          << it - encodedScans.cbegin() << std::endl;
+        return 1;
+      }
+      if (converter) {
+        scan.clear();
+        if (!dataPackets.empty())
+          scan.mStartTime = dataPackets.front().getTimestamp();
+        start = std::chrono::steady_clock::now();
+        for (auto pit = dataPackets.cbegin(); pit != dataPackets.cend(); ++pit)
+          converter->convert(*pit, scan);
+        end = std::chrono::steady_clock::now();
+        convertTime += std::chrono::duration<double>(end - start).count();
+        numPoints += scan.size();
+      }
+      for (auto pit = dataPackets.cbegin(); pit != dataPackets.cend(); ++pit) {
+        std::ostringstream binaryStream;
+        pit->writeBinary(binaryStream);
+        std::string compressedPacket;
+        snappySize += snappy::Compress(binaryStream.str().data(),
+          binaryStream.str().size(), &compressedPacket);
+      }
+      numPackets += dataPackets.size();
+      encodedSize += it->size();
+    }
+    if (!numPackets) {
+      std::cerr << "No packets in " << argv[1] << std::endl;
+      return 1;
+    }
+    const double rawSize = numPackets * packetSize;
+    std::cout << "scans: " << encodedScans.size() << std::endl;
+    std::cout << "packets: " << numPackets << std::endl;
+    std::cout << "raw size [B]: " << rawSize << std::endl;
+    std::cout << "encoded size [B]: " << encodedSize << std::endl;
+    std::cout << "ratio: " << rawSize / encodedSize << std::endl;
+    std::cout << "snappy ratio: " << rawSize / snappySize << std::endl;
+    std::cout << "encode throughput [MB/s]: " << rawSize / encodeTime * 1e-6
+      << std::endl;
+    std::cout << "decode throughput [MB/s]: " << rawSize / decodeTime * 1e-6
+      << std::endl;
+    std::cout << "decode throughput [packets/s]: " << numPackets / decodeTime
+      << std::endl;
+    if (converter)
+      std::cout << "decode and convert throughput [points/s]: "
+        << numPoints / (decodeTime + convertTime) << std::endl;
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
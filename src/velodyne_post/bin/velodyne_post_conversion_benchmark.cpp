@@ -0,0 +1,191 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file velodyne_post_conversion_benchmark.cpp
+    \brief This file benchmarks the conversion kernels of the optional stages
+           on synthetic packets.
+  */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <libvelodyne/sensor/DataPacket.h>
+#include <libvelodyne/sensor/Calibration.h>
+
+#include "CameraModel.h"
+#include "DepthImageProjector.h"
+#include "IntensityExtractor.h"
+#include "LaserStatistics.h"
+#include "RangeDownsampler.h"
+#include "ScanBuffer.h"
+#include "ScanConverter.h"
+
+using namespace velodyne;
+
+namespace {
+
+  /// Optional stages of a benchmarked kernel
+  enum Stage {
+    downsampling = 1,
+    intensityExtraction = 2,
+    statistics = 4,
+    cameras = 8
+  };
+
+  /// Fills a revolution of packets with the ranges of a cluttered urban
+  /// scene, as the autotuner does
+  void synthesize(const ScanConverter& converter, size_t numDataPackets,
+      std::vector<DataPacket>& dataPackets) {
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distance(0, 35000);
+    std::uniform_int_distribution<int> intensity(0, 255);
+    const size_t numBanks = std::max<size_t>(converter.getNumLasers() /
+      DataPacket::DataChunk::mLasersPerPacket, 1);
+    const size_t numBlocks = numDataPackets * DataPacket::mDataChunkNbr;
+    dataPackets.resize(numDataPackets);
+    for (size_t i = 0; i < numDataPackets; ++i) {
+      dataPackets[i].setTimestamp(i * 1000000);
+      for (size_t j = 0; j < DataPacket::mDataChunkNbr; ++j) {
+        const size_t block = i * DataPacket::mDataChunkNbr + j;
+        DataPacket::DataChunk dataChunk;
+        dataChunk.mHeaderInfo = numBanks > 1 && (block & 1) ?
+          ScanConverter::mLowerBank : ScanConverter::mUpperBank;
+        dataChunk.mRotationalInfo = (block / numBanks) * 36000 * numBanks /
+          numBlocks;
+        for (size_t k = 0; k < DataPacket::DataChunk::mLasersPerPacket;
+            ++k) {
+          const int rawDistance = distance(generator);
+          dataChunk.mLaserData[k].mDistance = rawDistance < 2000 ? 0 :
+            rawDistance;
+          dataChunk.mLaserData[k].mIntensity = intensity(generator);
+        }
+        dataPackets[i].setDataChunk(dataChunk, j);
+      }
+    }
+  }
+
+  /// Returns the best time of a number of conversions of the packets [s]
+  double measure(const ScanConverter& converter, const
+      std::vector<DataPacket>& dataPackets, const
+      std::vector<std::shared_ptr<DepthImageProjector> >& projectors,
+      bool withIntensity, size_t numRuns) {
+    ScanBuffer scan;
+    ScanBuffer intensityScan;
+    const size_t numReturns = dataPackets.size() * DataPacket::mDataChunkNbr *
+      DataPacket::DataChunk::mLasersPerPacket;
+    scan.reserve(numReturns);
+    intensityScan.reserve(numReturns);
+    double bestTime = 0.0;
+    for (size_t run = 0; run < numRuns; ++run) {
+      scan.clear();
+      intensityScan.clear();
+      for (auto it = projectors.cbegin(); it != projectors.cend(); ++it)
+        (*it)->reset();
+      const auto start = std::chrono::steady_clock::now();
+      for (auto it = dataPackets.cbegin(); it != dataPackets.cend(); ++it)
+        converter.convert(*it, scan, withIntensity ? &intensityScan : 0);
+      const double time = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+      if (run == 0 || time < bestTime)
+        bestTime = time;
+    }
+    return bestTime;
+  }
+
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1 && std::string(argv[1]) == "-h") {
+    std::cerr << "Usage: " << argv[0] << " [calibration file] "
+      "[packets per revolution] [runs]" << std::endl
+      << "Without calibration file or with \"\", all the corrections are zero"
+      << std::endl;
+    return 1;
+  }
+  try {
+    Calibration calibration;
+    if (argc > 1 && argv[1][0]) {
+      std::ifstream calibFile(argv[1]);
+      if (!calibFile) {
+        std::cerr << "Cannot open " << argv[1] << std::endl;
+        return 1;
+      }
+      calibFile >> calibration;
+    }
+    const size_t numDataPackets = argc > 2 ? std::atoi(argv[2]) : 348;
+    const size_t numRuns = argc > 3 ? std::atoi(argv[3]) : 50;
+    ScanConverter converter(calibration, 0.9, 120.0);
+    std::vector<DataPacket> dataPackets;
+    synthesize(converter, numDataPackets, dataPackets);
+    const size_t numLasers = converter.getNumLasers();
+    // a camera looking forward, as in the configuration examples
+    const double translation[3] = {0.1, 0.0, -0.2};
+    const double rotation[4] = {0.5, -0.5, 0.5, -0.5};
+    const CameraModel camera("front_camera", "/front_camera", 640, 480,
+      500.0, 500.0, 320.0, 240.0, translation, rotation,
+      converter.getAzimuthMargin(), 0.9);
+    const std::vector<std::shared_ptr<DepthImageProjector> > projectors(1,
+      std::make_shared<DepthImageProjector>(camera));
+    const unsigned int masks[] = {0, downsampling, intensityExtraction,
+      statistics, cameras, downsampling | intensityExtraction,
+      downsampling | intensityExtraction | statistics | cameras};
+    const size_t numReturns = numDataPackets * DataPacket::mDataChunkNbr *
+      DataPacket::DataChunk::mLasersPerPacket;
+    std::cout << "packets: " << numDataPackets << std::endl;
+    std::cout << "runs: " << numRuns << std::endl;
+    double baseTime = 0.0;
+    for (size_t i = 0; i < sizeof(masks) / sizeof(masks[0]); ++i) {
+      const unsigned int mask = masks[i];
+      converter.setDownsampler(mask & downsampling ?
+        std::make_shared<RangeDownsampler>(10.0, 0.1) :
+        std::shared_ptr<RangeDownsampler>());
+      converter.setIntensityExtractor(mask & intensityExtraction ?
+        std::make_shared<IntensityExtractor>(std::vector<double>(), 200.0,
+        false, 10.0, numLasers) : std::shared_ptr<IntensityExtractor>());
+      converter.setStatistics(mask & statistics ?
+        std::make_shared<LaserStatistics>(numLasers) :
+        std::shared_ptr<LaserStatistics>());
+      converter.setDepthProjectors(mask & cameras ? projectors :
+        std::vector<std::shared_ptr<DepthImageProjector> >());
+      const double time = measure(converter, dataPackets, mask & cameras ?
+        projectors : std::vector<std::shared_ptr<DepthImageProjector> >(),
+        mask & intensityExtraction, numRuns);
+      if (mask == 0)
+        baseTime = time;
+      std::cout << "features:" << (mask ? "" : " none")
+        << (mask & downsampling ? " downsampling" : "")
+        << (mask & intensityExtraction ? " intensity" : "")
+        << (mask & statistics ? " statistics" : "")
+        << (mask & cameras ? " cameras" : "")
+        << ", throughput [Mreturns/s]: " << numReturns / time * 1e-6
+        << ", relative time: " << time / baseTime << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,182 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+/** \file velodyne_post_offline.cpp
+    \brief This file converts scan logs into point logs by shards in
+           independent processes.
+  */
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <libvelodyne/sensor/Calibration.h>
+
+#include "OfflineConverter.h"
+#include "ScanExporter.h"
+#include "ScanConverter.h"
+
+using namespace velodyne;
+
+static void usage(const char* name) {
+  std::cerr << "Usage: " << name << " plan <log file> <num shards> <plan file>"
+    << std::endl
+    << "       " << name << " convert <log file> <plan file> <shard index> "
+    "<output file> <calibration file> [device name] [min distance] "
+    "[max distance] [return mode]" << std::endl
+    << "       " << name << " merge <output file> <shard output files>..."
+    << std::endl
+    << "       " << name << " export <point log file> <output file> "
+    "<arrow|parquet>" << std::endl
+    << "       " << name << " run <log file> <num workers> <output file> "
+    "<calibration file> [device name] [min distance] [max distance] "
+    "[return mode]" << std::endl;
+}
+
+static OfflineConverter createConverter(int argc, char** argv, int first) {
+  std::ifstream calibFile(argv[first]);
+  if (!calibFile)
+    throw std::runtime_error(std::string("cannot open ") + argv[first]);
+  Calibration calibration;
+  calibFile >> calibration;
+  const std::string deviceName = argc > first + 1 ? argv[first + 1] :
+    "Velodyne HDL-32E";
+  const double minDistance = argc > first + 2 ?
+    std::atof(argv[first + 2]) : 0.9;
+  const double maxDistance = argc > first + 3 ?
+    std::atof(argv[first + 3]) : 120.0;
+  const std::string returnMode = argc > first + 4 ? argv[first + 4] :
+    "single";
+  ScanConverter converter(calibration, minDistance, maxDistance);
+  if (deviceName == "Velodyne VLP-16")
+    converter.setLayout(ScanConverter::Layout::vlp16);
+  else if (deviceName == "Velodyne VLP-32C")
+    converter.setLayout(ScanConverter::Layout::vlp32c);
+  else if (deviceName != "Velodyne HDL-64E S2" &&
+      deviceName != "Velodyne HDL-32E")
+    throw std::runtime_error("unknown device " + deviceName);
+  // the HDL-64E alternates its banks between consecutive blocks, which are
+  // no pairs of returns of the same lasers
+  if (returnMode == "dual" && deviceName == "Velodyne HDL-64E S2")
+    throw std::runtime_error("dual return mode not supported on " +
+      deviceName);
+  else if (returnMode == "dual")
+    converter.setReturnMode(ScanConverter::ReturnMode::dual);
+  else if (returnMode != "single")
+    throw std::runtime_error("unknown return mode " + returnMode);
+  return OfflineConverter(converter);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+  const std::string command = argv[1];
+  try {
+    if (command == "plan" && argc == 5) {
+      const std::vector<OfflineConverter::Shard> shards =
+        OfflineConverter::plan(argv[2], std::atoi(argv[3]));
+      OfflineConverter::savePlan(argv[4], shards);
+      std::cout << "shards: " << shards.size() << std::endl;
+    }
+    else if (command == "convert" && argc >= 7) {
+      const std::vector<OfflineConverter::Shard> shards =
+        OfflineConverter::loadPlan(argv[3]);
+      const size_t shard = std::atoi(argv[4]);
+      if (shard >= shards.size())
+        throw std::runtime_error("no shard " + std::string(argv[4]));
+      const OfflineConverter converter = createConverter(argc, argv, 6);
+      std::cout << "revolutions: " << converter.convert(argv[2],
+        shards[shard], argv[5]) << std::endl;
+    }
+    else if (command == "merge" && argc >= 4)
+      OfflineConverter::merge(std::vector<std::string>(argv + 3,
+        argv + argc), argv[2]);
+    else if (command == "export" && argc == 5) {
+      const std::string format = argv[4];
+      if (format != "arrow" && format != "parquet")
+        throw std::runtime_error("unknown format " + format);
+      ScanExporter exporter(argv[3], format == "arrow" ?
+        ScanExporter::Format::arrow : ScanExporter::Format::parquet);
+      std::cout << "revolutions: " << OfflineConverter::exportPoints(argv[2],
+        exporter) << std::endl;
+    }
+    else if (command == "run" && argc >= 6) {
+      // the workers share nothing but the log file, the shards are merged
+      // once all of them succeeded
+      const OfflineConverter converter = createConverter(argc, argv, 5);
+      const std::vector<OfflineConverter::Shard> shards =
+        OfflineConverter::plan(argv[2], std::atoi(argv[3]));
+      const std::string outputFileName = argv[4];
+      std::vector<std::string> shardFileNames;
+      std::vector<pid_t> workers;
+      for (size_t k = 0; k < shards.size(); ++k) {
+        shardFileNames.push_back(outputFileName + ".shard" +
+          std::to_string(k));
+        const pid_t pid = fork();
+        if (pid < 0)
+          throw std::runtime_error("fork failed");
+        if (pid == 0) {
+          int status = 0;
+          try {
+            converter.convert(argv[2], shards[k], shardFileNames.back());
+          }
+          catch (const std::exception& e) {
+            std::cerr << "Exception in shard " << k << ": " << e.what()
+              << std::endl;
+            status = 1;
+          }
+          _exit(status);
+        }
+        workers.push_back(pid);
+      }
+      bool failed = false;
+      for (auto it = workers.cbegin(); it != workers.cend(); ++it) {
+        int status;
+        failed |= waitpid(*it, &status, 0) < 0 || !WIFEXITED(status) ||
+          WEXITSTATUS(status) != 0;
+      }
+      if (!failed)
+        OfflineConverter::merge(shardFileNames, outputFileName);
+      for (auto it = shardFileNames.cbegin(); it != shardFileNames.cend();
+          ++it)
+        std::remove(it->c_str());
+      if (failed)
+        throw std::runtime_error("a worker failed");
+    }
+    else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
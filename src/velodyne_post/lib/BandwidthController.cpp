@@ -0,0 +1,109 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+#include "BandwidthController.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "RangeDownsampler.h"
+#include "ScanBuffer.h"
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  BandwidthController::BandwidthController(size_t numLevels, double
+      targetLatency, double referenceDistance, double minKeepProbability,
+      double resolution, double initialThroughput, double probeFactor) :
+      _numLevels(numLevels),
+      _targetLatency(targetLatency),
+      _invSquaredReferenceDistance(1.0 /
+        (referenceDistance * referenceDistance)),
+      _minKeepProbability(minKeepProbability),
+      _resolution(resolution),
+      _probeFactor(probeFactor),
+      _throughput(initialThroughput),
+      _latency(0.0),
+      _numPoints(numLevels, 0),
+      _sizes(numLevels, 0) {
+    if (numLevels < 2 || numLevels > 32)
+      throw std::runtime_error("BandwidthController: number of levels "
+        "outside [2, 32]");
+    if (!(targetLatency > 0.0) || !(referenceDistance > 0.0) ||
+        !(resolution > 0.0) || !(initialThroughput > 0.0) ||
+        probeFactor < 1.0)
+      throw std::runtime_error("BandwidthController: bad parameters");
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  void BandwidthController::addStatistics(double windowDuration, uint64_t
+      traffic, size_t numDropped, double latency) {
+    if (!(windowDuration > 0.0))
+      return;
+    // the achieved throughput is the link capacity under congestion only,
+    // the estimate is otherwise probed upwards until the latency rises
+    const double achievedThroughput = traffic / windowDuration;
+    _latency = latency;
+    if (numDropped || latency > _targetLatency)
+      _throughput = std::max(0.8 * achievedThroughput, 1.0);
+    else if (latency < 0.5 * _targetLatency)
+      _throughput = std::max(_throughput, achievedThroughput) * _probeFactor;
+    else
+      _throughput = std::max(_throughput, achievedThroughput);
+  }
+
+  void BandwidthController::measure(const ScanBuffer& scan, bool withColor) {
+    const size_t numPoints = scan.size();
+    _pointLevels.resize(numPoints);
+    std::fill(_numPoints.begin(), _numPoints.end(), 0);
+    for (size_t i = 0; i < numPoints; ++i) {
+      const double keepProbability = std::min(1.0, std::max(
+        _minKeepProbability, scan.mRange[i] * scan.mRange[i] *
+        _invSquaredReferenceDistance));
+      const double hash = RangeDownsampler::hash(scan.mRing[i],
+        scan.mAzimuth[i]);
+      // the threshold halves from level 2 on
+      size_t level = 1;
+      for (double threshold = keepProbability * 4294967296.0;
+          level + 1 < _numLevels && hash < threshold; threshold *= 0.5)
+        ++level;
+      _pointLevels[i] = level;
+      ++_numPoints[level];
+    }
+    for (size_t level = _numLevels - 1; level > 0; --level)
+      _numPoints[level - 1] += _numPoints[level];
+    for (size_t level = 0; level < _numLevels; ++level)
+      _sizes[level] = _numPoints[level] * getPointSize(level, withColor);
+  }
+
+  size_t BandwidthController::selectLevel(double scanPeriod) const {
+    const double budget = _throughput * std::min(_targetLatency, scanPeriod);
+    for (size_t level = 0; level < _numLevels; ++level)
+      if (_sizes[level] <= budget)
+        return level;
+    return _numLevels - 1;
+  }
+
+}
@@ -0,0 +1,151 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+/** \file BandwidthController.h
+    \brief This file defines the BandwidthController class which selects the
+           resolution of a scan sent over a link of varying throughput.
+  */
+
+#ifndef BANDWIDTH_CONTROLLER_H
+#define BANDWIDTH_CONTROLLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace velodyne {
+
+  struct ScanBuffer;
+
+  /** The class BandwidthController selects the resolution of each scan sent
+      over a link, such that it is delivered within a target latency. Level 0
+      sends the positions as float32 x, y and z, level 1 quantizes them to
+      int16 qx, qy and qz in units of a fixed resolution and the intensity to
+      uint8, and each further level halves the keep probability of the
+      range-adaptive decimation, which is min(1, max(p_min, (d / d_ref)^2)) at
+      level 2. The decision of a return hashes its laser and azimuth as in the
+      range-adaptive downsampler, such that the returns of a coarse level are
+      a subset of the finer ones. The throughput of the link is estimated from
+      the traffic and latency reported by the subscribers: it is cut to the
+      achieved throughput when the latency exceeds the target or messages are
+      dropped, and probed upwards while the latency is below half the target.
+      Each scan gets the finest level whose size the estimated throughput
+      delivers within the target latency and the scan period.
+      \brief Bandwidth-adaptive resolution controller
+    */
+  class BandwidthController {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    BandwidthController(size_t numLevels, double targetLatency, double
+      referenceDistance, double minKeepProbability, double resolution,
+      double initialThroughput, double probeFactor);
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the number of levels
+    size_t getNumLevels() const {
+      return _numLevels;
+    }
+    /// Returns the position resolution of a level, null for float32 [m]
+    double getResolution(size_t level) const {
+      return level ? _resolution : 0.0;
+    }
+    /// Returns the size of a point at a level [B]
+    static size_t getPointSize(size_t level, bool withColor) {
+      return level ? (withColor ? 12 : 7) : (withColor ? 20 : 16);
+    }
+    /// Returns the estimated throughput of the link [B/s]
+    double getThroughput() const {
+      return _throughput;
+    }
+    /// Returns the latest mean latency reported by the subscribers [s]
+    double getLatency() const {
+      return _latency;
+    }
+    /// Returns the number of points of the last measured scan at a level
+    size_t getNumPoints(size_t level) const {
+      return _numPoints[level];
+    }
+    /// Returns the size of the last measured scan at a level [B]
+    size_t getSize(size_t level) const {
+      return _sizes[level];
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Adds the statistics of a subscriber over a window [s]: the received
+    /// traffic [B], the number of dropped messages and the mean latency [s]
+    void addStatistics(double windowDuration, uint64_t traffic, size_t
+      numDropped, double latency);
+    /// Computes the finest level of each return of a scan and the size of
+    /// the scan at each level
+    void measure(const ScanBuffer& scan, bool withColor);
+    /// Returns the level of the last measured scan given the scan period [s]
+    size_t selectLevel(double scanPeriod) const;
+    /// Returns true if a return of the last measured scan is kept at a level
+    bool keep(size_t pointIdx, size_t level) const {
+      return _pointLevels[pointIdx] >= level;
+    }
+    /** @}
+      */
+
+  protected:
+    /** \name Protected members
+      @{
+      */
+    /// Number of levels
+    size_t _numLevels;
+    /// Target latency [s]
+    double _targetLatency;
+    /// Inverse of the squared reference distance of the decimation
+    double _invSquaredReferenceDistance;
+    /// Minimum keep probability of the decimation at level 2
+    double _minKeepProbability;
+    /// Position resolution of the quantized levels [m]
+    double _resolution;
+    /// Growth factor of the throughput estimate per window below half the
+    /// target latency
+    double _probeFactor;
+    /// Estimated throughput of the link [B/s]
+    double _throughput;
+    /// Latest mean latency reported by the subscribers [s]
+    double _latency;
+    /// Coarsest level keeping each return of the last measured scan
+    std::vector<uint8_t> _pointLevels;
+    /// Number of points of the last measured scan per level
+    std::vector<size_t> _numPoints;
+    /// Size of the last measured scan per level [B]
+    std::vector<size_t> _sizes;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // BANDWIDTH_CONTROLLER_H
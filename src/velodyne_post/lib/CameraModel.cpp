@@ -0,0 +1,96 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "CameraModel.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  CameraModel::CameraModel(const std::string& name, const std::string&
+      frameId, size_t width, size_t height, double fx, double fy, double cx,
+      double cy, const double translation[3], const double rotation[4],
+      double azimuthMargin, double minDistance) :
+      _name(name),
+      _frameId(frameId),
+      _width(width),
+      _height(height),
+      _fx(fx),
+      _fy(fy),
+      _cx(cx),
+      _cy(cy),
+      _azimuthStart(0),
+      _azimuthSpan(36000) {
+    const double norm = std::sqrt(rotation[0] * rotation[0] + rotation[1] *
+      rotation[1] + rotation[2] * rotation[2] + rotation[3] * rotation[3]);
+    const double x = rotation[0] / norm;
+    const double y = rotation[1] / norm;
+    const double z = rotation[2] / norm;
+    const double w = rotation[3] / norm;
+    _rotation[0] = 1 - 2 * (y * y + z * z);
+    _rotation[1] = 2 * (x * y - z * w);
+    _rotation[2] = 2 * (x * z + y * w);
+    _rotation[3] = 2 * (x * y + z * w);
+    _rotation[4] = 1 - 2 * (x * x + z * z);
+    _rotation[5] = 2 * (y * z - x * w);
+    _rotation[6] = 2 * (x * z - y * w);
+    _rotation[7] = 2 * (y * z + x * w);
+    _rotation[8] = 1 - 2 * (x * x + y * y);
+    for (size_t i = 0; i < 3; ++i)
+      _translation[i] = translation[i];
+    // azimuths of the optical axis and of the image corners in the Velodyne
+    // frame, obtained by rotating the camera rays back
+    double rays[5][3] = {{0, 0, 1}};
+    for (size_t i = 0; i < 4; ++i) {
+      rays[i + 1][0] = ((i & 1 ? width : 0) - cx) / fx;
+      rays[i + 1][1] = ((i & 2 ? height : 0) - cy) / fy;
+      rays[i + 1][2] = 1;
+    }
+    double azimuths[5];
+    for (size_t i = 0; i < 5; ++i) {
+      const double* ray = rays[i];
+      azimuths[i] = std::atan2(
+        _rotation[1] * ray[0] + _rotation[4] * ray[1] + _rotation[7] * ray[2],
+        _rotation[0] * ray[0] + _rotation[3] * ray[1] + _rotation[6] * ray[2]);
+    }
+    double halfSpan = 0.0;
+    for (size_t i = 1; i < 5; ++i)
+      halfSpan = std::max(halfSpan, std::fabs(std::remainder(azimuths[i] -
+        azimuths[0], 2 * M_PI)));
+    // the rays start at the camera centre, at |t| from the Velodyne axis,
+    // which shifts the azimuth of a return at distance d by up to
+    // asin(|t| / d)
+    const double offset = std::sqrt(translation[0] * translation[0] +
+      translation[1] * translation[1] + translation[2] * translation[2]);
+    halfSpan += azimuthMargin + (minDistance > offset ?
+      std::asin(offset / minDistance) : M_PI_2);
+    if (halfSpan < M_PI) {
+      // the Velodyne rotates clockwise, raw azimuths are negated
+      const double start = std::fmod(-(azimuths[0] + halfSpan) * 18000.0 /
+        M_PI, 36000.0);
+      _azimuthStart = std::fmod(start + 36000.0, 36000.0);
+      _azimuthSpan = std::ceil(2 * halfSpan * 18000.0 / M_PI);
+    }
+  }
+
+}
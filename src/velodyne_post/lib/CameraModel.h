@@ -0,0 +1,142 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file CameraModel.h
+    \brief This file defines the CameraModel class which projects points of
+           the Velodyne frame into a calibrated pinhole camera.
+  */
+
+#ifndef CAMERA_MODEL_H
+#define CAMERA_MODEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace velodyne {
+
+  /** The class CameraModel projects points of the Velodyne frame into a
+      calibrated pinhole camera. It also precomputes the raw azimuth interval
+      of the Velodyne that covers the horizontal field of view of the camera,
+      such that blocks can be culled before their returns are converted. The
+      interval is widened by the parallax of the camera centre, which is off
+      the Velodyne axis, for returns down to the min distance.
+      \brief Calibrated pinhole camera
+    */
+  class CameraModel {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor, the rotation is a quaternion (x, y, z, w) and, with the
+    /// translation, maps Velodyne frame points into the camera frame, the
+    /// azimuth interval covers the returns beyond the min distance [m]
+    CameraModel(const std::string& name, const std::string& frameId,
+      size_t width, size_t height, double fx, double fy, double cx, double cy,
+      const double translation[3], const double rotation[4],
+      double azimuthMargin, double minDistance);
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the name
+    const std::string& getName() const {
+      return _name;
+    }
+    /// Returns the frame identifier
+    const std::string& getFrameId() const {
+      return _frameId;
+    }
+    /// Returns the image width
+    size_t getWidth() const {
+      return _width;
+    }
+    /// Returns the image height
+    size_t getHeight() const {
+      return _height;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Returns true if a block at a raw azimuth may be seen by the camera
+    bool isVisible(uint16_t rotationalInfo) const {
+      return (rotationalInfo + 36000 - _azimuthStart) % 36000 <= _azimuthSpan;
+    }
+    /// Projects a point, returns false if it falls outside the image
+    bool project(float x, float y, float z, size_t& u, size_t& v,
+        float& depth) const {
+      const float xc = _rotation[0] * x + _rotation[1] * y +
+        _rotation[2] * z + _translation[0];
+      const float yc = _rotation[3] * x + _rotation[4] * y +
+        _rotation[5] * z + _translation[1];
+      depth = _rotation[6] * x + _rotation[7] * y + _rotation[8] * z +
+        _translation[2];
+      if (depth <= 0)
+        return false;
+      const float uf = _fx * xc / depth + _cx;
+      const float vf = _fy * yc / depth + _cy;
+      if (uf < 0 || vf < 0 || uf >= _width || vf >= _height)
+        return false;
+      u = uf;
+      v = vf;
+      return true;
+    }
+    /** @}
+      */
+
+  protected:
+    /** \name Protected members
+      @{
+      */
+    /// Name
+    std::string _name;
+    /// Frame identifier
+    std::string _frameId;
+    /// Image width
+    size_t _width;
+    /// Image height
+    size_t _height;
+    /// Focal length along x
+    float _fx;
+    /// Focal length along y
+    float _fy;
+    /// Principal point along x
+    float _cx;
+    /// Principal point along y
+    float _cy;
+    /// Row-major rotation from the Velodyne to the camera frame
+    float _rotation[9];
+    /// Translation from the Velodyne to the camera frame
+    float _translation[3];
+    /// Start of the visible raw azimuth interval [0.01 deg]
+    uint32_t _azimuthStart;
+    /// Span of the visible raw azimuth interval [0.01 deg]
+    uint32_t _azimuthSpan;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // CAMERA_MODEL_H
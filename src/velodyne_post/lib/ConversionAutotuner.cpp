@@ -0,0 +1,225 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "ConversionAutotuner.h"
+
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "ScanBuffer.h"
+#include "TaskScheduler.h"
+#include "DepthImageProjector.h"
+#include "PointColorizer.h"
+#include "LaserStatistics.h"
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  ConversionAutotuner::ConversionAutotuner(const ScanConverter& converter,
+      size_t numDataPackets, bool sectorConversion) :
+      _converter(converter),
+      _dataPackets(numDataPackets),
+      _sectorConversion(sectorConversion) {
+    // these stages write to shared state and disable the sectors anyway
+    _converter.setDepthProjectors(
+      std::vector<std::shared_ptr<DepthImageProjector> >());
+    _converter.setColorizers(std::vector<std::shared_ptr<PointColorizer> >());
+    _converter.setStatistics(std::shared_ptr<LaserStatistics>());
+    // a full revolution with the ranges of a cluttered urban scene
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distance(0, 35000);
+    std::uniform_int_distribution<int> intensity(0, 255);
+    const size_t numBanks = _converter.getNumLasers() /
+      DataPacket::DataChunk::mLasersPerPacket;
+    const size_t numBlocks = numDataPackets * DataPacket::mDataChunkNbr;
+    for (size_t i = 0; i < numDataPackets; ++i) {
+      _dataPackets[i].setTimestamp(i * 1000000);
+      for (size_t j = 0; j < DataPacket::mDataChunkNbr; ++j) {
+        const size_t block = i * DataPacket::mDataChunkNbr + j;
+        DataPacket::DataChunk dataChunk;
+        dataChunk.mHeaderInfo = numBanks > 1 && (block & 1) ?
+          ScanConverter::mLowerBank : ScanConverter::mUpperBank;
+        dataChunk.mRotationalInfo = (block / std::max<size_t>(numBanks, 1)) *
+          36000 * std::max<size_t>(numBanks, 1) / numBlocks;
+        for (size_t k = 0; k < DataPacket::DataChunk::mLasersPerPacket;
+            ++k) {
+          const int rawDistance = distance(generator);
+          dataChunk.mLaserData[k].mDistance = rawDistance < 2000 ? 0 :
+            rawDistance;
+          dataChunk.mLaserData[k].mIntensity = intensity(generator);
+        }
+        _dataPackets[i].setDataChunk(dataChunk, j);
+      }
+    }
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  ConversionAutotuner::Configuration ConversionAutotuner::tune(double budget)
+      const {
+    std::vector<size_t> threadCounts;
+    const size_t maxThreads = std::max(std::thread::hardware_concurrency(),
+      1u);
+    for (size_t numThreads = 1; numThreads < maxThreads; numThreads *= 2)
+      threadCounts.push_back(numThreads);
+    threadCounts.push_back(maxThreads);
+    std::vector<Configuration> candidates;
+    candidates.push_back(Configuration{0, 1, 0.0});
+    for (auto it = threadCounts.cbegin(); it != threadCounts.cend(); ++it)
+      for (size_t factor = 1; factor <= (_sectorConversion ? 4 : 1);
+          factor *= 2)
+        candidates.push_back(Configuration{*it, _sectorConversion ?
+          *it * factor : 1, 0.0});
+    const double duration = budget / candidates.size();
+    Configuration best = candidates.front();
+    for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+      it->mThroughput = measure(it->mNumThreads, it->mNumSectors, duration);
+      if (it->mThroughput > best.mThroughput)
+        best = *it;
+    }
+    return best;
+  }
+
+  double ConversionAutotuner::measure(size_t numThreads, size_t numSectors,
+      double duration) const {
+    const size_t numPackets = _dataPackets.size();
+    numSectors = std::max<size_t>(std::min(numSectors, numPackets), 1);
+    std::vector<ScanBuffer> sectorScans(numSectors);
+    ScanBuffer scan;
+    std::shared_ptr<TaskScheduler> scheduler;
+    if (numThreads > 0)
+      scheduler = std::make_shared<TaskScheduler>(numThreads);
+    auto convertScan = [&] {
+      scan.clear();
+      if (!scheduler) {
+        for (size_t i = 0; i < numPackets; ++i)
+          _converter.convert(_dataPackets[i], scan);
+        return;
+      }
+      for (size_t i = 0; i < numSectors; ++i)
+        scheduler->submit(scheduler->createTask(
+          [this, &sectorScans, i, numSectors, numPackets] {
+            sectorScans[i].clear();
+            for (size_t j = i * numPackets / numSectors;
+                j < (i + 1) * numPackets / numSectors; ++j)
+              _converter.convert(_dataPackets[j], sectorScans[i]);
+          }));
+      scheduler->wait();
+      for (size_t i = 0; i < numSectors; ++i)
+        scan.append(sectorScans[i]);
+    };
+    // the first scan warms up the caches and the buffers
+    convertScan();
+    size_t numScans = 0;
+    const auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    do {
+      convertScan();
+      ++numScans;
+      elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < duration);
+    return numScans * numPackets * DataPacket::mDataChunkNbr *
+      DataPacket::DataChunk::mLasersPerPacket / elapsed;
+  }
+
+  std::string ConversionAutotuner::getCpuModel() {
+    std::string model;
+    std::ifstream cpuInfo("/proc/cpuinfo");
+    std::string line;
+    static const char* keys[] = {"model name", "Hardware", "CPU part"};
+    for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]) && model.empty();
+        ++k) {
+      cpuInfo.clear();
+      cpuInfo.seekg(0);
+      while (std::getline(cpuInfo, line))
+        if (line.compare(0, std::strlen(keys[k]), keys[k]) == 0) {
+          const size_t colon = line.find(':');
+          if (colon != std::string::npos && colon + 2 <= line.size())
+            model = line.substr(colon + 2);
+          break;
+        }
+    }
+    if (model.empty())
+      model = "unknown";
+    std::ostringstream identifier;
+    identifier << model << " x" << std::thread::hardware_concurrency();
+    return identifier.str();
+  }
+
+  std::string ConversionAutotuner::getCacheKey(const std::string& cpuModel,
+      const std::string& deviceName, size_t numDataPackets, bool
+      sectorConversion) {
+    std::ostringstream key;
+    key << cpuModel << " | " << deviceName << " | " << numDataPackets
+      << " packets" << (sectorConversion ? "" : " | no sectors");
+    return key.str();
+  }
+
+  bool ConversionAutotuner::loadCache(const std::string& fileName, const
+      std::string& key, Configuration& configuration) {
+    std::ifstream file(fileName);
+    std::string line;
+    while (std::getline(file, line)) {
+      const size_t separator = line.rfind('\t');
+      if (separator == std::string::npos ||
+          line.compare(0, separator, key) != 0 || separator != key.size())
+        continue;
+      std::istringstream values(line.substr(separator + 1));
+      Configuration cached;
+      char comma1, comma2;
+      if (values >> cached.mNumThreads >> comma1 >> cached.mNumSectors >>
+          comma2 >> cached.mThroughput && comma1 == ',' && comma2 == ',') {
+        configuration = cached;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool ConversionAutotuner::saveCache(const std::string& fileName, const
+      std::string& key, const Configuration& configuration) {
+    std::vector<std::string> lines;
+    {
+      std::ifstream file(fileName);
+      std::string line;
+      while (std::getline(file, line))
+        if (line.compare(0, key.size() + 1, key + '\t') != 0)
+          lines.push_back(line);
+    }
+    std::ostringstream line;
+    line << key << '\t' << configuration.mNumThreads << ','
+      << configuration.mNumSectors << ',' << configuration.mThroughput;
+    lines.push_back(line.str());
+    std::ofstream file(fileName);
+    for (auto it = lines.cbegin(); it != lines.cend(); ++it)
+      file << *it << std::endl;
+    return static_cast<bool>(file);
+  }
+
+}
@@ -0,0 +1,120 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file ConversionAutotuner.h
+    \brief This file defines the ConversionAutotuner class which selects the
+           fastest conversion configuration on the running CPU.
+  */
+
+#ifndef CONVERSION_AUTOTUNER_H
+#define CONVERSION_AUTOTUNER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <libvelodyne/sensor/DataPacket.h>
+
+#include "ScanConverter.h"
+
+namespace velodyne {
+
+  /** The class ConversionAutotuner converts synthetic scans with candidate
+      numbers of scheduler threads and scan sectors, and selects the
+      configuration with the highest throughput. The best configuration
+      depends on the CPU, the device, the number of packets per revolution
+      and whether the sectors may be used, it may thus be cached per
+      combination of these.
+      \brief Conversion configuration autotuner
+    */
+  class ConversionAutotuner {
+  public:
+    /** \name Types definitions
+      @{
+      */
+    /// Conversion configuration
+    struct Configuration {
+      /// Number of scheduler threads, 0 for the publishing thread
+      size_t mNumThreads;
+      /// Number of sectors converted in parallel
+      size_t mNumSectors;
+      /// Measured throughput [points/s]
+      double mThroughput;
+    };
+    /** @}
+      */
+
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor, without sector conversion only single-sector
+    /// configurations are benchmarked
+    ConversionAutotuner(const ScanConverter& converter, size_t
+      numDataPackets, bool sectorConversion = true);
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Benchmarks the candidates within a time budget [s] and returns the
+    /// fastest configuration
+    Configuration tune(double budget) const;
+    /// Returns an identifier of the CPU model and its number of threads
+    static std::string getCpuModel();
+    /// Returns the cache key of a CPU model, device, number of packets per
+    /// revolution and sector conversion
+    static std::string getCacheKey(const std::string& cpuModel, const
+      std::string& deviceName, size_t numDataPackets, bool
+      sectorConversion);
+    /// Loads the cached configuration of a key
+    static bool loadCache(const std::string& fileName, const std::string&
+      key, Configuration& configuration);
+    /// Saves the configuration of a key in the cache
+    static bool saveCache(const std::string& fileName, const std::string&
+      key, const Configuration& configuration);
+    /** @}
+      */
+
+  protected:
+    /** \name Protected methods
+      @{
+      */
+    /// Measures the throughput of a configuration for a duration [s]
+    double measure(size_t numThreads, size_t numSectors, double duration)
+      const;
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Converter without the stages writing to shared state
+    ScanConverter _converter;
+    /// Synthetic data packets of a scan
+    std::vector<DataPacket> _dataPackets;
+    /// Whether the sector conversion may be used
+    bool _sectorConversion;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // CONVERSION_AUTOTUNER_H
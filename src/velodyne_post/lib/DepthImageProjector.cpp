@@ -0,0 +1,44 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "DepthImageProjector.h"
+
+#include <algorithm>
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  DepthImageProjector::DepthImageProjector(const CameraModel& camera) :
+      _camera(camera),
+      _depths(camera.getWidth() * camera.getHeight(), 0.0f),
+      _numProjected(0) {
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  void DepthImageProjector::reset() {
+    std::fill(_depths.begin(), _depths.end(), 0.0f);
+    _numProjected = 0;
+  }
+
+}
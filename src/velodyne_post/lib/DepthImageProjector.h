@@ -0,0 +1,104 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file DepthImageProjector.h
+    \brief This file defines the DepthImageProjector class which projects
+           returns into a sparse camera depth image.
+  */
+
+#ifndef DEPTH_IMAGE_PROJECTOR_H
+#define DEPTH_IMAGE_PROJECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "CameraModel.h"
+
+namespace velodyne {
+
+  /** The class DepthImageProjector accumulates the returns of a scan into a
+      sparse depth image of a calibrated camera. Pixels without return are
+      zero, pixels hit by several returns keep the closest one.
+      \brief Sparse depth image projector
+    */
+  class DepthImageProjector {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    DepthImageProjector(const CameraModel& camera);
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the camera
+    const CameraModel& getCamera() const {
+      return _camera;
+    }
+    /// Returns the depth image, row-major [m]
+    const std::vector<float>& getDepths() const {
+      return _depths;
+    }
+    /// Returns the number of projected returns since the last reset
+    size_t getNumProjected() const {
+      return _numProjected;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Clears the depth image
+    void reset();
+    /// Projects a return into the depth image
+    void insert(float x, float y, float z) {
+      size_t u, v;
+      float depth;
+      if (!_camera.project(x, y, z, u, v, depth))
+        return;
+      float& pixel = _depths[v * _camera.getWidth() + u];
+      if (pixel == 0 || depth < pixel)
+        pixel = depth;
+      ++_numProjected;
+    }
+    /** @}
+      */
+
+  protected:
+    /** \name Protected members
+      @{
+      */
+    /// Camera
+    CameraModel _camera;
+    /// Depth image, row-major [m]
+    std::vector<float> _depths;
+    /// Number of projected returns since the last reset
+    size_t _numProjected;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // DEPTH_IMAGE_PROJECTOR_H
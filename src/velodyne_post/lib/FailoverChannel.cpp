@@ -0,0 +1,209 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+#include "FailoverChannel.h"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Statics                                                                    */
+/******************************************************************************/
+
+  const uint64_t FailoverChannel::mMagic;
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  FailoverChannel::FailoverChannel(const std::string& name, size_t
+      numPackets, int64_t heartbeatTimeout) :
+      _data(0),
+      _size(sizeof(Header) + numPackets * sizeof(Slot)),
+      _numSlots(numPackets),
+      _heartbeatTimeout(heartbeatTimeout),
+      _pid(getpid()),
+      _primary(false) {
+    if (!numPackets)
+      throw std::runtime_error("FailoverChannel: empty ring");
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+      throw std::runtime_error("FailoverChannel: cannot open " + name +
+        ": " + std::strerror(errno));
+    // the first process sizes the segment, which is zero-filled
+    struct stat status;
+    bool sized = fstat(fd, &status) == 0 && (status.st_size ==
+      static_cast<off_t>(_size) || (status.st_size == 0 &&
+      ftruncate(fd, _size) == 0));
+    if (sized) {
+      void* data = mmap(0, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (data != MAP_FAILED)
+        _data = data;
+    }
+    const int error = errno;
+    close(fd);
+    if (!sized)
+      throw std::runtime_error("FailoverChannel: " + name +
+        " has another size, with another number of packets per revolution");
+    if (!_data)
+      throw std::runtime_error("FailoverChannel: cannot map " + name + ": " +
+        std::strerror(error));
+    _header = static_cast<Header*>(_data);
+    _slots = reinterpret_cast<Slot*>(static_cast<char*>(_data) +
+      sizeof(Header));
+    uint64_t numSlots = 0;
+    uint64_t magic = 0;
+    if ((!_header->mNumSlots.compare_exchange_strong(numSlots, _numSlots) &&
+        numSlots != _numSlots) ||
+        (!_header->mMagic.compare_exchange_strong(magic, mMagic) &&
+        magic != mMagic)) {
+      munmap(_data, _size);
+      throw std::runtime_error("FailoverChannel: bad segment " + name);
+    }
+  }
+
+  FailoverChannel::~FailoverChannel() {
+    release();
+    munmap(_data, _size);
+  }
+
+/******************************************************************************/
+/* Accessors                                                                  */
+/******************************************************************************/
+
+  int FailoverChannel::getPrimaryPid() const {
+    return _header->mPrimaryPid;
+  }
+
+  uint64_t FailoverChannel::getNumTakeovers() const {
+    return _header->mNumTakeovers;
+  }
+
+  int64_t FailoverChannel::getPublished() const {
+    return _header->mPublished;
+  }
+
+  void FailoverChannel::setPublished(int64_t timestamp) {
+    _header->mPublished = timestamp;
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  int64_t FailoverChannel::getTime() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000LL + time.tv_nsec;
+  }
+
+  bool FailoverChannel::isAlive(int pid) {
+    return kill(pid, 0) == 0 || errno == EPERM;
+  }
+
+  bool FailoverChannel::beat() {
+    _primary = _header->mPrimaryPid == _pid;
+    if (_primary)
+      _header->mHeartbeat = getTime();
+    return _primary;
+  }
+
+  bool FailoverChannel::acquire() {
+    if (beat())
+      return true;
+    int32_t pid = _header->mPrimaryPid;
+    const int64_t time = getTime();
+    const int64_t heartbeat = _header->mHeartbeat;
+    if (pid && isAlive(pid) && time - heartbeat < _heartbeatTimeout)
+      return false;
+    // the heartbeat is refreshed before the pid is published, such that the
+    // other standbys do not see a stale heartbeat of the new primary
+    _header->mHeartbeat = time;
+    if (!_header->mPrimaryPid.compare_exchange_strong(pid, _pid))
+      return false;
+    if (pid)
+      ++_header->mNumTakeovers;
+    // the ring and the published revolution of a primary silent for longer
+    // than two heartbeat timeouts do not continue the current revolution
+    if (time - heartbeat >= 2 * _heartbeatTimeout) {
+      _header->mPublished = 0;
+      _header->mNumWritten = 0;
+    }
+    _primary = true;
+    return true;
+  }
+
+  void FailoverChannel::release() {
+    int32_t pid = _pid;
+    _header->mPrimaryPid.compare_exchange_strong(pid, 0);
+    _primary = false;
+  }
+
+  void FailoverChannel::write(const DataPacket& dataPacket) {
+    const uint64_t numWritten = _header->mNumWritten;
+    Slot& slot = _slots[numWritten % _numSlots];
+    // odd while written, also after a primary died in the middle of a write
+    const uint64_t sequence = slot.mSequence | 1;
+    slot.mSequence.store(sequence, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.mTimestamp = dataPacket.getTimestamp();
+    slot.mSpinCount = dataPacket.getSpinCount();
+    slot.mReserved = dataPacket.getReserved();
+    for (size_t i = 0; i < DataPacket::mDataChunkNbr; ++i)
+      slot.mDataChunks[i] = dataPacket.getDataChunk(i);
+    slot.mSequence.store(sequence + 1, std::memory_order_release);
+    _header->mNumWritten = numWritten + 1;
+  }
+
+  void FailoverChannel::read(int64_t timestamp, std::vector<DataPacket>&
+      dataPackets) const {
+    dataPackets.clear();
+    const uint64_t numWritten = _header->mNumWritten;
+    const uint64_t first = numWritten > _numSlots ? numWritten - _numSlots :
+      0;
+    for (uint64_t i = first; i < numWritten; ++i) {
+      const Slot& slot = _slots[i % _numSlots];
+      DataPacket dataPacket;
+      const uint64_t sequence = slot.mSequence.load(std::memory_order_acquire);
+      dataPacket.setTimestamp(slot.mTimestamp);
+      dataPacket.setSpinCount(slot.mSpinCount);
+      dataPacket.setReserved(slot.mReserved);
+      for (size_t j = 0; j < DataPacket::mDataChunkNbr; ++j)
+        dataPacket.setDataChunk(slot.mDataChunks[j], j);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      // skips the slots being overwritten by a live primary
+      if ((sequence & 1) ||
+          slot.mSequence.load(std::memory_order_relaxed) != sequence)
+        continue;
+      if (dataPacket.getTimestamp() > timestamp)
+        dataPackets.push_back(dataPacket);
+    }
+  }
+
+}
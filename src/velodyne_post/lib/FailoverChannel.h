@@ -0,0 +1,187 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+/** \file FailoverChannel.h
+    \brief This file defines the FailoverChannel class which shares the state
+           of a primary node with its hot standbys through shared memory.
+  */
+
+#ifndef FAILOVER_CHANNEL_H
+#define FAILOVER_CHANNEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <libvelodyne/sensor/DataPacket.h>
+
+namespace velodyne {
+
+  /** The class FailoverChannel shares the state of a primary node with its
+      hot standbys through a POSIX shared memory segment. The primary is the
+      process whose pid is in the segment, it refreshes a heartbeat, mirrors
+      every packet of its revolutions into a ring and records the last packet
+      of each published revolution. A standby becomes primary once the
+      former primary has exited or its heartbeat is stale, and rebuilds the
+      in-progress revolution from the ring, unless the former primary has
+      been silent for longer than two heartbeat timeouts. The segment only
+      holds lock-free atomics and plain data, the ring slots are guarded by
+      sequence locks, such that the primary never waits for a standby.
+      \brief Shared memory failover channel
+    */
+  class FailoverChannel {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor with the name of the segment, the number of packets of
+    /// the ring and the age of a stale heartbeat [ns]
+    FailoverChannel(const std::string& name, size_t numPackets, int64_t
+      heartbeatTimeout);
+    /// Copy constructor
+    FailoverChannel(const FailoverChannel& other) = delete;
+    /// Copy assignment operator
+    FailoverChannel& operator = (const FailoverChannel& other) = delete;
+    /// Destructor, hands the primary role over
+    ~FailoverChannel();
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns true if this process is the primary, as of the last acquire
+    bool isPrimary() const {
+      return _primary;
+    }
+    /// Returns the pid of the primary, null if none
+    int getPrimaryPid() const;
+    /// Returns the number of takeovers on the segment
+    uint64_t getNumTakeovers() const;
+    /// Returns the timestamp of the last packet of the last published
+    /// revolution, null if none
+    int64_t getPublished() const;
+    /// Sets the timestamp of the last packet of the last published revolution
+    void setPublished(int64_t timestamp);
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Becomes or stays the primary if the current primary has exited or its
+    /// heartbeat is stale, returns true if this process is the primary and
+    /// refreshes its heartbeat
+    bool acquire();
+    /// Refreshes the heartbeat if this process is the primary, returns true
+    /// if it still is
+    bool beat();
+    /// Hands the primary role over to the next standby
+    void release();
+    /// Mirrors a packet of the primary into the ring
+    void write(const DataPacket& dataPacket);
+    /// Reads the packets of the ring newer than a timestamp, in order
+    void read(int64_t timestamp, std::vector<DataPacket>& dataPackets) const;
+    /** @}
+      */
+
+    /** \name Public members
+      @{
+      */
+    /// Magic number of a segment
+    static const uint64_t mMagic = 0x0100005245564f46;
+    /** @}
+      */
+
+  protected:
+    /** \name Protected types
+      @{
+      */
+    /// Segment header
+    struct Header {
+      /// Magic number, set by the first process
+      std::atomic<uint64_t> mMagic;
+      /// Number of packets of the ring
+      std::atomic<uint64_t> mNumSlots;
+      /// Pid of the primary, null if none
+      std::atomic<int32_t> mPrimaryPid;
+      /// Last heartbeat of the primary, monotonic clock [ns]
+      std::atomic<int64_t> mHeartbeat;
+      /// Number of takeovers
+      std::atomic<uint64_t> mNumTakeovers;
+      /// Timestamp of the last packet of the last published revolution
+      std::atomic<int64_t> mPublished;
+      /// Number of packets written to the ring
+      std::atomic<uint64_t> mNumWritten;
+    };
+    /// Ring slot
+    struct Slot {
+      /// Sequence lock, odd while the slot is written
+      std::atomic<uint64_t> mSequence;
+      /// Timestamp of the packet
+      int64_t mTimestamp;
+      /// Spin count of the packet
+      uint32_t mSpinCount;
+      /// Reserved bytes of the packet
+      uint32_t mReserved;
+      /// Firing blocks of the packet
+      DataPacket::DataChunk mDataChunks[DataPacket::mDataChunkNbr];
+    };
+    /** @}
+      */
+
+    /** \name Protected methods
+      @{
+      */
+    /// Returns the monotonic time [ns]
+    static int64_t getTime();
+    /// Returns true if a process exists
+    static bool isAlive(int pid);
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Mapped segment
+    void* _data;
+    /// Size of the segment [B]
+    size_t _size;
+    /// Segment header
+    Header* _header;
+    /// Ring slots
+    Slot* _slots;
+    /// Number of ring slots
+    size_t _numSlots;
+    /// Age of a stale heartbeat [ns]
+    int64_t _heartbeatTimeout;
+    /// Pid of this process
+    int _pid;
+    /// Whether this process is the primary
+    bool _primary;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // FAILOVER_CHANNEL_H
@@ -0,0 +1,39 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "IntensityExtractor.h"
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  IntensityExtractor::IntensityExtractor(const std::vector<double>&
+      laserThresholds, double defaultThreshold, bool normalizeByDistance,
+      double referenceDistance, size_t numLasers) :
+      _thresholds(numLasers, defaultThreshold),
+      _normalizeByDistance(normalizeByDistance) {
+    for (size_t i = 0; i < laserThresholds.size() && i < numLasers; ++i)
+      _thresholds[i] = laserThresholds[i];
+    if (_normalizeByDistance)
+      for (auto it = _thresholds.begin(); it != _thresholds.end(); ++it)
+        *it *= referenceDistance * referenceDistance;
+  }
+
+}
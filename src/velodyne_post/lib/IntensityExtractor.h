@@ -0,0 +1,78 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file IntensityExtractor.h
+    \brief This file defines the IntensityExtractor class which selects the
+           high-intensity returns.
+  */
+
+#ifndef INTENSITY_EXTRACTOR_H
+#define INTENSITY_EXTRACTOR_H
+
+#include <cstddef>
+#include <vector>
+
+namespace velodyne {
+
+  /** The class IntensityExtractor selects the returns above a per-laser
+      intensity threshold, e.g., retroreflectors and lane markings. The
+      intensity can optionally be normalized by the squared distance with
+      respect to a reference distance, in order to compensate for the
+      attenuation of the received power.
+      \brief High-intensity returns selector
+    */
+  class IntensityExtractor {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    IntensityExtractor(const std::vector<double>& laserThresholds,
+      double defaultThreshold, bool normalizeByDistance,
+      double referenceDistance, size_t numLasers);
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Returns true if a return is above the threshold of its laser
+    bool select(size_t laserIdx, double intensity, double distance) const {
+      return (_normalizeByDistance ? intensity * distance * distance :
+        intensity) >= _thresholds[laserIdx];
+    }
+    /** @}
+      */
+
+  protected:
+    /** \name Protected members
+      @{
+      */
+    /// Per-laser thresholds, scaled by the squared reference distance if
+    /// normalized
+    std::vector<double> _thresholds;
+    /// Normalizes the intensity by distance
+    bool _normalizeByDistance;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // INTENSITY_EXTRACTOR_H
@@ -0,0 +1,63 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "LaserStatistics.h"
+
+#include <algorithm>
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  LaserStatistics::LaserStatistics(size_t numLasers) :
+      _numValid(numLasers, 0),
+      _numZero(numLasers, 0),
+      _numOutOfRange(numLasers, 0),
+      _intensitySum(numLasers, 0),
+      _rangeSum(numLasers, 0.0) {
+  }
+
+/******************************************************************************/
+/* Accessors                                                                  */
+/******************************************************************************/
+
+  double LaserStatistics::getMeanIntensity(size_t laserIdx) const {
+    return _numValid[laserIdx] ?
+      static_cast<double>(_intensitySum[laserIdx]) / _numValid[laserIdx] : 0.0;
+  }
+
+  double LaserStatistics::getMeanRange(size_t laserIdx) const {
+    return _numValid[laserIdx] ? _rangeSum[laserIdx] / _numValid[laserIdx] :
+      0.0;
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  void LaserStatistics::reset() {
+    std::fill(_numValid.begin(), _numValid.end(), 0);
+    std::fill(_numZero.begin(), _numZero.end(), 0);
+    std::fill(_numOutOfRange.begin(), _numOutOfRange.end(), 0);
+    std::fill(_intensitySum.begin(), _intensitySum.end(), 0);
+    std::fill(_rangeSum.begin(), _rangeSum.end(), 0.0);
+  }
+
+}
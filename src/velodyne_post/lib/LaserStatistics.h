@@ -0,0 +1,118 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file LaserStatistics.h
+    \brief This file defines the LaserStatistics class which accumulates
+           per-laser return statistics.
+  */
+
+#ifndef LASER_STATISTICS_H
+#define LASER_STATISTICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace velodyne {
+
+  /** The class LaserStatistics accumulates per-laser return counters and
+      sums. It is fed by the converter while it visits the returns, such that
+      degraded lasers or dirty windows can be detected without analyzing the
+      point cloud.
+      \brief Per-laser return statistics
+    */
+  class LaserStatistics {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    LaserStatistics(size_t numLasers);
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the number of lasers
+    size_t getNumLasers() const {
+      return _numValid.size();
+    }
+    /// Returns the number of returns within range of a laser
+    uint32_t getNumValid(size_t laserIdx) const {
+      return _numValid[laserIdx];
+    }
+    /// Returns the number of returns without echo of a laser
+    uint32_t getNumZero(size_t laserIdx) const {
+      return _numZero[laserIdx];
+    }
+    /// Returns the number of returns out of range of a laser
+    uint32_t getNumOutOfRange(size_t laserIdx) const {
+      return _numOutOfRange[laserIdx];
+    }
+    /// Returns the mean intensity of the valid returns of a laser
+    double getMeanIntensity(size_t laserIdx) const;
+    /// Returns the mean range of the valid returns of a laser [m]
+    double getMeanRange(size_t laserIdx) const;
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Counts a return without echo
+    void addZero(size_t laserIdx) {
+      ++_numZero[laserIdx];
+    }
+    /// Counts a return out of range
+    void addOutOfRange(size_t laserIdx) {
+      ++_numOutOfRange[laserIdx];
+    }
+    /// Counts a return within range
+    void addValid(size_t laserIdx, uint8_t intensity, double range) {
+      ++_numValid[laserIdx];
+      _intensitySum[laserIdx] += intensity;
+      _rangeSum[laserIdx] += range;
+    }
+    /// Resets the statistics
+    void reset();
+    /** @}
+      */
+
+  protected:
+    /** \name Protected members
+      @{
+      */
+    /// Number of returns within range
+    std::vector<uint32_t> _numValid;
+    /// Number of returns without echo
+    std::vector<uint32_t> _numZero;
+    /// Number of returns out of range
+    std::vector<uint32_t> _numOutOfRange;
+    /// Sum of the intensities of the valid returns
+    std::vector<uint64_t> _intensitySum;
+    /// Sum of the ranges of the valid returns [m]
+    std::vector<double> _rangeSum;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // LASER_STATISTICS_H
@@ -0,0 +1,166 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+#include "LodEncoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "ScanBuffer.h"
+
+namespace velodyne {
+
+  namespace {
+
+    /// Rounds towards minus infinity without a library call
+    inline int64_t floor(float value) {
+      const int64_t truncated = static_cast<int64_t>(value);
+      return truncated - (value < truncated);
+    }
+
+    /// Rounds to the nearest int16, saturating
+    inline int16_t quantize(float value) {
+      value = std::max(-32768.0f, std::min(32767.0f, value));
+      return static_cast<int16_t>(value + (value < 0.0f ? -0.5f : 0.5f));
+    }
+
+  }
+
+/******************************************************************************/
+/* Statics                                                                    */
+/******************************************************************************/
+
+  const char LodEncoder::mMagic[4] = {'V', 'L', 'O', 'D'};
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  LodEncoder::LodEncoder(double voxelSize, size_t numLevels, double
+      resolution) :
+      _voxelSize(voxelSize),
+      _numLevels(std::min<size_t>(std::max<size_t>(numLevels, 1), 255)),
+      _resolution(resolution),
+      _voxelShift(60) {
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  uint64_t LodEncoder::getVoxelKey(float x, float y, float z, float
+      inverseVoxelSize) {
+    // 21 bits per axis, centered on the sensor
+    const uint64_t mask = (1 << 21) - 1;
+    const int64_t offset = 1 << 20;
+    return ((floor(x * inverseVoxelSize) + offset) & mask) |
+      ((floor(y * inverseVoxelSize) + offset) & mask) << 21 |
+      ((floor(z * inverseVoxelSize) + offset) & mask) << 42;
+  }
+
+  bool LodEncoder::insertVoxel(uint64_t key) {
+    const size_t mask = _voxels.size() - 1;
+    // Fibonacci hashing, the high bits of the product are the best mixed
+    for (size_t i = (key * 0x9e3779b97f4a7c15ull) >> _voxelShift;;
+        i = (i + 1) & mask) {
+      if (_voxels[i] == key + 1)
+        return false;
+      if (!_voxels[i]) {
+        _voxels[i] = key + 1;
+        return true;
+      }
+    }
+  }
+
+  void LodEncoder::encode(const ScanBuffer& scan, uint32_t scanId,
+      std::vector<std::string>& frames) {
+    const size_t numPoints = scan.size();
+    size_t tableSize = 16;
+    _voxelShift = 60;
+    while (tableSize < 2 * numPoints) {
+      tableSize <<= 1;
+      --_voxelShift;
+    }
+    // the last level takes the points left by the voxel levels
+    const uint8_t lastLevel = _numLevels - 1;
+    _levels.assign(numPoints, lastLevel);
+    std::vector<size_t> numLevelPoints(_numLevels, 0);
+    for (uint8_t l = 0; l < lastLevel; ++l) {
+      _voxels.assign(tableSize, 0);
+      const float inverseVoxelSize = std::ldexp(1.0, l) / _voxelSize;
+      for (size_t i = 0; i < numPoints; ++i)
+        if (_levels[i] < l)
+          insertVoxel(getVoxelKey(scan.mX[i], scan.mY[i], scan.mZ[i],
+            inverseVoxelSize));
+      // consecutive returns of a ring mostly fall in the same voxel, which
+      // is then known to be occupied without probing the table
+      uint64_t lastKeys[64];
+      std::fill(lastKeys, lastKeys + 64, ~static_cast<uint64_t>(0));
+      for (size_t i = 0; i < numPoints; ++i) {
+        if (_levels[i] != lastLevel)
+          continue;
+        const uint64_t key = getVoxelKey(scan.mX[i], scan.mY[i], scan.mZ[i],
+          inverseVoxelSize);
+        uint64_t& lastKey = lastKeys[scan.mRing[i] & 63];
+        if (key == lastKey)
+          continue;
+        lastKey = key;
+        if (insertVoxel(key))
+          _levels[i] = l;
+      }
+    }
+    for (size_t i = 0; i < numPoints; ++i)
+      ++numLevelPoints[_levels[i]];
+    frames.resize(_numLevels);
+    std::vector<char*> cursors(_numLevels);
+    for (uint8_t l = 0; l < _numLevels; ++l) {
+      std::string& frame = frames[l];
+      frame.resize(mHeaderSize + numLevelPoints[l] * mPointSize);
+      char* header = &frame[0];
+      const unsigned char info[4] = {mVersion, l,
+        static_cast<unsigned char>(_numLevels), 0};
+      const uint32_t numFramePoints = numLevelPoints[l];
+      const float voxelSize = l < lastLevel ? std::ldexp(_voxelSize, -l) :
+        0.0f;
+      const float resolution = _resolution;
+      std::memcpy(header, mMagic, 4);
+      std::memcpy(header + 4, info, 4);
+      std::memcpy(header + 8, &scanId, 4);
+      std::memcpy(header + 12, &scan.mStartTime, 8);
+      std::memcpy(header + 20, &numFramePoints, 4);
+      std::memcpy(header + 24, &voxelSize, 4);
+      std::memcpy(header + 28, &resolution, 4);
+      cursors[l] = header + mHeaderSize;
+    }
+    const float inverseResolution = 1.0 / _resolution;
+    for (size_t i = 0; i < numPoints; ++i) {
+      const int16_t position[3] = {quantize(scan.mX[i] * inverseResolution),
+        quantize(scan.mY[i] * inverseResolution),
+        quantize(scan.mZ[i] * inverseResolution)};
+      const uint8_t intensity = std::max(0.0f, std::min(255.0f,
+        scan.mIntensity[i]));
+      char*& cursor = cursors[_levels[i]];
+      std::memcpy(cursor, position, sizeof(position));
+      cursor[6] = intensity;
+      cursor += mPointSize;
+    }
+  }
+
+}
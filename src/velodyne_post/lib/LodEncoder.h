@@ -0,0 +1,135 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+/** \file LodEncoder.h
+    \brief This file defines the LodEncoder class which encodes scans into
+           progressive levels of detail.
+  */
+
+#ifndef LOD_ENCODER_H
+#define LOD_ENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace velodyne {
+
+  struct ScanBuffer;
+
+  /** The class LodEncoder splits a scan into progressive levels of detail.
+      Level l keeps one point per voxel of size v / 2^l among the voxels not
+      occupied by the coarser levels, the last level holds the remaining
+      points, such that the levels received so far always form a subset of
+      the scan. Each level is encoded as a frame with a 32-byte header (magic
+      number VLOD, version, level, number of levels, a reserved byte, scan id
+      [uint32], scan start time [int64, ns], number of points [uint32], voxel
+      size [float32, m, 0 for the last level] and position resolution
+      [float32, m]), followed by 7 bytes per point: the position quantized to
+      the resolution as three int16 and the intensity as an uint8. Multi-byte
+      fields are in the byte order of the host.
+      \brief Level-of-detail scan encoder
+    */
+  class LodEncoder {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    LodEncoder(double voxelSize, size_t numLevels, double resolution = 0.01);
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the voxel size of the coarsest level [m]
+    double getVoxelSize() const {
+      return _voxelSize;
+    }
+    /// Returns the number of levels
+    size_t getNumLevels() const {
+      return _numLevels;
+    }
+    /// Returns the position resolution [m]
+    double getResolution() const {
+      return _resolution;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Encodes a scan into one frame per level, coarsest first
+    void encode(const ScanBuffer& scan, uint32_t scanId,
+      std::vector<std::string>& frames);
+    /** @}
+      */
+
+    /** \name Public members
+      @{
+      */
+    /// Magic number of a frame
+    static const char mMagic[4];
+    /// Format version
+    static const unsigned char mVersion = 1;
+    /// Size of a frame header [B]
+    static const size_t mHeaderSize = 32;
+    /// Size of an encoded point [B]
+    static const size_t mPointSize = 7;
+    /** @}
+      */
+
+  protected:
+    /** \name Protected methods
+      @{
+      */
+    /// Inserts a voxel key, returns false if it was already present
+    bool insertVoxel(uint64_t key);
+    /// Returns the key of the voxel of a point
+    static uint64_t getVoxelKey(float x, float y, float z, float
+      inverseVoxelSize);
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Voxel size of the coarsest level [m]
+    double _voxelSize;
+    /// Number of levels
+    size_t _numLevels;
+    /// Position resolution [m]
+    double _resolution;
+    /// Open-addressing table of the occupied voxels, keys offset by one
+    std::vector<uint64_t> _voxels;
+    /// Shift of the voxel hash to the size of the table
+    unsigned int _voxelShift;
+    /// Level of each point of the scan
+    std::vector<uint8_t> _levels;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // LOD_ENCODER_H
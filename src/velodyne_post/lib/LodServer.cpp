@@ -0,0 +1,268 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+#include "LodServer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  LodServer::LodServer(const std::string& address, uint16_t port, const
+      LodEncoder& encoder, size_t maxClients) :
+      _encoder(encoder),
+      _maxClients(maxClients),
+      _socket(-1),
+      _address(address),
+      _port(port),
+      _scanId(0),
+      _numClients(0),
+      _numSentBytes(0),
+      _numSkippedFrames(0),
+      _stop(false) {
+    sockaddr_in socketAddress;
+    std::memset(&socketAddress, 0, sizeof(socketAddress));
+    socketAddress.sin_family = AF_INET;
+    socketAddress.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &socketAddress.sin_addr) != 1)
+      throw std::runtime_error("LodServer: invalid IPv4 address " + address);
+    _socket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_socket < 0)
+      throw std::runtime_error(std::string("LodServer: socket: ") +
+        std::strerror(errno));
+    const int reuse = 1;
+    setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    socklen_t addressSize = sizeof(socketAddress);
+    if (bind(_socket, reinterpret_cast<sockaddr*>(&socketAddress),
+        sizeof(socketAddress)) < 0 || listen(_socket, 16) < 0 ||
+        getsockname(_socket, reinterpret_cast<sockaddr*>(&socketAddress),
+        &addressSize) < 0 || pipe2(_wakeup, O_NONBLOCK | O_CLOEXEC) < 0) {
+      const std::string error = std::strerror(errno);
+      close(_socket);
+      throw std::runtime_error("LodServer: cannot listen on " + address +
+        ":" + std::to_string(port) + ": " + error);
+    }
+    _port = ntohs(socketAddress.sin_port);
+    _thread = std::thread(&LodServer::run, this);
+  }
+
+  LodServer::~LodServer() {
+    _stop = true;
+    const char byte = 0;
+    if (write(_wakeup[1], &byte, 1) < 0) {
+      // the pipe is full, the server thread wakes up anyway
+    }
+    _thread.join();
+    for (auto it = _clients.cbegin(); it != _clients.cend(); ++it)
+      close((*it)->mSocket);
+    close(_wakeup[0]);
+    close(_wakeup[1]);
+    close(_socket);
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  void LodServer::publish(const ScanBuffer& scan) {
+    _encoder.encode(scan, _scanId++, _frames);
+    std::vector<FramePtr> frames;
+    for (auto it = _frames.begin(); it != _frames.end(); ++it)
+      frames.push_back(std::make_shared<const std::string>(std::move(*it)));
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      // the clients skip a scan the server thread did not dispatch yet
+      _latest.swap(frames);
+    }
+    const char byte = 0;
+    if (write(_wakeup[1], &byte, 1) < 0) {
+      // the pipe is full, the server thread is already woken up
+    }
+  }
+
+  void LodServer::run() {
+    std::vector<pollfd> descriptors;
+    while (!_stop) {
+      dispatch();
+      const Clock::time_point now = Clock::now();
+      int timeout = -1;
+      descriptors.clear();
+      descriptors.push_back({_wakeup[0], POLLIN, 0});
+      descriptors.push_back({_socket, POLLIN, 0});
+      for (auto it = _clients.begin(); it != _clients.end(); ++it) {
+        Client& client = **it;
+        short events = POLLIN;
+        if (!client.mFrames.empty()) {
+          refill(client, now);
+          if (client.mRate <= 0.0 || client.mTokens >= 1.0)
+            events |= POLLOUT;
+          else
+            timeout = std::min<int>(timeout < 0 ? 1000 : timeout,
+              std::ceil((1.0 - client.mTokens) / client.mRate * 1e3));
+        }
+        descriptors.push_back({client.mSocket, events, 0});
+      }
+      if (poll(descriptors.data(), descriptors.size(), timeout) < 0) {
+        if (errno == EINTR)
+          continue;
+        break;
+      }
+      if (descriptors[0].revents & POLLIN) {
+        char buffer[64];
+        while (read(_wakeup[0], buffer, sizeof(buffer)) > 0);
+      }
+      const Clock::time_point sendTime = Clock::now();
+      std::vector<bool> connected(_clients.size(), true);
+      for (size_t i = 0; i < _clients.size(); ++i) {
+        const short events = descriptors[i + 2].revents;
+        if (events & (POLLIN | POLLHUP))
+          connected[i] = receive(*_clients[i]);
+        if (connected[i] && (events & POLLOUT))
+          connected[i] = send(*_clients[i], sendTime);
+        if (events & (POLLERR | POLLNVAL))
+          connected[i] = false;
+      }
+      for (size_t i = _clients.size(); i-- > 0;)
+        if (!connected[i]) {
+          close(_clients[i]->mSocket);
+          _clients.erase(_clients.begin() + i);
+        }
+      if (descriptors[1].revents & POLLIN)
+        accept();
+      _numClients = _clients.size();
+    }
+  }
+
+  void LodServer::accept() {
+    const int socket = accept4(_socket, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (socket < 0)
+      return;
+    if (_clients.size() >= _maxClients) {
+      close(socket);
+      return;
+    }
+    std::unique_ptr<Client> client(new Client());
+    client->mSocket = socket;
+    client->mOffset = 0;
+    client->mRate = 0.0;
+    client->mTokens = 0.0;
+    client->mTime = Clock::now();
+    client->mNumLevels = 0;
+    _clients.push_back(std::move(client));
+  }
+
+  void LodServer::dispatch() {
+    std::vector<FramePtr> frames;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      frames.swap(_latest);
+    }
+    if (frames.empty())
+      return;
+    for (auto it = _clients.begin(); it != _clients.end(); ++it) {
+      Client& client = **it;
+      // a partially sent frame is completed to keep the stream in sync
+      const size_t numKept = client.mOffset > 0 ? 1 : 0;
+      if (client.mFrames.size() > numKept) {
+        _numSkippedFrames += client.mFrames.size() - numKept;
+        client.mFrames.resize(numKept);
+      }
+      const size_t numLevels = client.mNumLevels ?
+        std::min(client.mNumLevels, frames.size()) : frames.size();
+      client.mFrames.insert(client.mFrames.end(), frames.begin(),
+        frames.begin() + numLevels);
+    }
+  }
+
+  bool LodServer::receive(Client& client) {
+    char buffer[256];
+    const ssize_t size = recv(client.mSocket, buffer, sizeof(buffer),
+      MSG_DONTWAIT);
+    if (size == 0)
+      return false;
+    if (size < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    client.mCommand.append(buffer, size);
+    for (size_t end = client.mCommand.find('\n'); end != std::string::npos;
+        end = client.mCommand.find('\n')) {
+      const std::string command = client.mCommand.substr(0, end);
+      client.mCommand.erase(0, end + 1);
+      if (command.compare(0, 5, "rate ") == 0) {
+        client.mRate = std::max(0.0, std::atof(command.c_str() + 5));
+        client.mTokens = 0.0;
+        client.mTime = Clock::now();
+      }
+      else if (command.compare(0, 7, "levels ") == 0)
+        client.mNumLevels = std::max(0, std::atoi(command.c_str() + 7));
+    }
+    // a client sending garbage without newlines is dropped
+    return client.mCommand.size() < sizeof(buffer);
+  }
+
+  bool LodServer::send(Client& client, Clock::time_point now) {
+    refill(client, now);
+    while (!client.mFrames.empty()) {
+      const std::string& frame = *client.mFrames.front();
+      size_t size = frame.size() - client.mOffset;
+      if (client.mRate > 0.0)
+        size = std::min<size_t>(size, client.mTokens);
+      if (!size)
+        return true;
+      const ssize_t sent = ::send(client.mSocket, frame.data() +
+        client.mOffset, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (sent < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+      _numSentBytes += sent;
+      client.mTokens -= sent;
+      client.mOffset += sent;
+      if (client.mOffset == frame.size()) {
+        client.mFrames.pop_front();
+        client.mOffset = 0;
+      }
+    }
+    return true;
+  }
+
+  void LodServer::refill(Client& client, Clock::time_point now) {
+    if (client.mRate > 0.0) {
+      // bursts are bounded to 100 ms of bandwidth
+      const double elapsed =
+        std::chrono::duration<double>(now - client.mTime).count();
+      client.mTokens = std::min(client.mTokens + client.mRate * elapsed,
+        std::max(client.mRate * 0.1, 1500.0));
+    }
+    client.mTime = now;
+  }
+
+}
@@ -0,0 +1,197 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+/** \file LodServer.h
+    \brief This file defines the LodServer class which streams scans in
+           levels of detail to TCP clients.
+  */
+
+#ifndef LOD_SERVER_H
+#define LOD_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LodEncoder.h"
+
+namespace velodyne {
+
+  struct ScanBuffer;
+
+  /** The class LodServer streams scans to TCP clients, each scan as the
+      frames of its levels of detail, coarsest first. The sockets are served
+      by a thread of the server and never block the publisher: a client that
+      has not started receiving the frames of a scan when the next one is
+      published skips them. A client may send text commands terminated by a
+      newline: "rate <bytes/s>" caps its bandwidth (0 for no cap) and
+      "levels <n>" limits the number of levels it receives (0 for all).
+      \brief Level-of-detail scan streaming server
+    */
+  class LodServer {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor, listens on a port of an IPv4 address (0 for any port,
+    /// "0.0.0.0" for all interfaces)
+    LodServer(const std::string& address, uint16_t port, const LodEncoder&
+      encoder, size_t maxClients);
+    /// Copy constructor
+    LodServer(const LodServer& other) = delete;
+    /// Copy assignment operator
+    LodServer& operator = (const LodServer& other) = delete;
+    /// Destructor, disconnects the clients
+    ~LodServer();
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the address the server listens on
+    const std::string& getAddress() const {
+      return _address;
+    }
+    /// Returns the port the server listens on
+    uint16_t getPort() const {
+      return _port;
+    }
+    /// Returns the number of connected clients
+    size_t getNumClients() const {
+      return _numClients;
+    }
+    /// Returns the number of bytes sent to the clients
+    uint64_t getNumSentBytes() const {
+      return _numSentBytes;
+    }
+    /// Returns the number of frames skipped by slow clients
+    uint64_t getNumSkippedFrames() const {
+      return _numSkippedFrames;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Encodes a scan and hands it over to the clients, must not be called
+    /// concurrently
+    void publish(const ScanBuffer& scan);
+    /** @}
+      */
+
+  protected:
+    /** \name Protected types
+      @{
+      */
+    /// Clock of the bandwidth caps
+    typedef std::chrono::steady_clock Clock;
+    /// Frame shared by the clients
+    typedef std::shared_ptr<const std::string> FramePtr;
+    /// Connected client
+    struct Client {
+      /// Socket
+      int mSocket;
+      /// Frames to send, the first one possibly partially sent
+      std::deque<FramePtr> mFrames;
+      /// Bytes of the first frame already sent
+      size_t mOffset;
+      /// Bandwidth cap [B/s], 0 for no cap
+      double mRate;
+      /// Bytes that may be sent under the cap
+      double mTokens;
+      /// Time of the last token update
+      Clock::time_point mTime;
+      /// Number of levels sent, 0 for all
+      size_t mNumLevels;
+      /// Partial command received
+      std::string mCommand;
+    };
+    /** @}
+      */
+
+    /** \name Protected methods
+      @{
+      */
+    /// Main loop of the server thread
+    void run();
+    /// Accepts a pending connection
+    void accept();
+    /// Queues the frames of the latest scan to the clients
+    void dispatch();
+    /// Reads the commands of a client, returns false if it disconnected
+    bool receive(Client& client);
+    /// Sends the pending frames of a client, returns false on error
+    bool send(Client& client, Clock::time_point now);
+    /// Refills the tokens of a client
+    static void refill(Client& client, Clock::time_point now);
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Encoder of the scans
+    LodEncoder _encoder;
+    /// Max number of clients
+    size_t _maxClients;
+    /// Listening socket
+    int _socket;
+    /// Pipe waking up the server thread
+    int _wakeup[2];
+    /// Address the server listens on
+    std::string _address;
+    /// Port the server listens on
+    uint16_t _port;
+    /// Encoded frames, reused across scans
+    std::vector<std::string> _frames;
+    /// Id of the next scan
+    uint32_t _scanId;
+    /// Mutex protecting the latest scan
+    std::mutex _mutex;
+    /// Frames of the latest scan, not yet dispatched
+    std::vector<FramePtr> _latest;
+    /// Clients, only accessed by the server thread
+    std::vector<std::unique_ptr<Client> > _clients;
+    /// Number of connected clients
+    std::atomic<size_t> _numClients;
+    /// Number of bytes sent to the clients
+    std::atomic<uint64_t> _numSentBytes;
+    /// Number of frames skipped by slow clients
+    std::atomic<uint64_t> _numSkippedFrames;
+    /// Stop flag
+    std::atomic<bool> _stop;
+    /// Server thread
+    std::thread _thread;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // LOD_SERVER_H
@@ -0,0 +1,156 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+#include "MeshGenerator.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "ScanBuffer.h"
+
+namespace velodyne {
+
+  namespace {
+
+    const uint32_t none = ScanGrid::mNone;
+
+  }
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  MeshGenerator::MeshGenerator(const std::vector<double>& elevations, const
+      std::vector<double>& firingFractions, double maxRangeRatio, double
+      maxIncidenceAngle, double maxAzimuthGap) :
+      _grid(elevations, firingFractions),
+      _maxRangeRatio(maxRangeRatio),
+      _cosMaxIncidenceAngle(std::cos(maxIncidenceAngle)),
+      _maxAzimuthGap(std::round(maxAzimuthGap * 18000.0 / M_PI)),
+      _numRejected(0) {
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  uint32_t MeshGenerator::getVertex(uint32_t pointIdx) {
+    uint32_t& vertexIdx = _vertexIndices[pointIdx];
+    if (vertexIdx == none) {
+      vertexIdx = _vertices.size();
+      _vertices.push_back(pointIdx);
+    }
+    return vertexIdx;
+  }
+
+  void MeshGenerator::addTriangle(const ScanBuffer& scan, uint32_t i0,
+      uint32_t i1, uint32_t i2) {
+    const float minRange = std::min(std::min(scan.mRange[i0],
+      scan.mRange[i1]), scan.mRange[i2]);
+    const float maxRange = std::max(std::max(scan.mRange[i0],
+      scan.mRange[i1]), scan.mRange[i2]);
+    if (maxRange > _maxRangeRatio * minRange) {
+      ++_numRejected;
+      return;
+    }
+    const float ux = scan.mX[i1] - scan.mX[i0];
+    const float uy = scan.mY[i1] - scan.mY[i0];
+    const float uz = scan.mZ[i1] - scan.mZ[i0];
+    const float vx = scan.mX[i2] - scan.mX[i0];
+    const float vy = scan.mY[i2] - scan.mY[i0];
+    const float vz = scan.mZ[i2] - scan.mZ[i0];
+    const float nx = uy * vz - uz * vy;
+    const float ny = uz * vx - ux * vz;
+    const float nz = ux * vy - uy * vx;
+    // the beam through the centroid, scaled by three
+    const float bx = scan.mX[i0] + scan.mX[i1] + scan.mX[i2];
+    const float by = scan.mY[i0] + scan.mY[i1] + scan.mY[i2];
+    const float bz = scan.mZ[i0] + scan.mZ[i1] + scan.mZ[i2];
+    const float dot = nx * bx + ny * by + nz * bz;
+    const float normalNorm2 = nx * nx + ny * ny + nz * nz;
+    const float beamNorm2 = bx * bx + by * by + bz * bz;
+    if (normalNorm2 == 0 || dot * dot < _cosMaxIncidenceAngle *
+        _cosMaxIncidenceAngle * normalNorm2 * beamNorm2) {
+      ++_numRejected;
+      return;
+    }
+    _triangles.push_back(getVertex(i0));
+    if (dot > 0)
+      std::swap(i1, i2);
+    _triangles.push_back(getVertex(i1));
+    _triangles.push_back(getVertex(i2));
+  }
+
+  void MeshGenerator::generate(const ScanBuffer& scan) {
+    _grid.fill(scan);
+    _vertexIndices.assign(scan.size(), none);
+    _vertices.clear();
+    _triangles.clear();
+    _numRejected = 0;
+    const size_t numColumns = _grid.getNumColumns();
+    const size_t numRows = _grid.getNumRows();
+    for (size_t i = 0; i < numColumns && numColumns > 2; ++i) {
+      // the last column closes the revolution if it meets the first one
+      const size_t next = i + 1 < numColumns ? i + 1 : 0;
+      const uint16_t gap = (_grid.getAzimuth(next) + 36000 -
+        _grid.getAzimuth(i)) % 36000;
+      if (gap == 0 || gap > _maxAzimuthGap)
+        continue;
+      const uint32_t* left = _grid.getColumn(i);
+      const uint32_t* right = _grid.getColumn(next);
+      for (size_t row = 0; row + 1 < numRows; ++row) {
+        const uint32_t a = left[row];
+        const uint32_t b = right[row];
+        const uint32_t c = left[row + 1];
+        const uint32_t d = right[row + 1];
+        const size_t numCorners = (a != none) + (b != none) + (c != none) +
+          (d != none);
+        if (numCorners < 3)
+          continue;
+        if (numCorners == 3) {
+          if (a == none)
+            addTriangle(scan, b, d, c);
+          else if (b == none)
+            addTriangle(scan, a, d, c);
+          else if (c == none)
+            addTriangle(scan, a, b, d);
+          else
+            addTriangle(scan, a, b, c);
+          continue;
+        }
+        const float adx = scan.mX[d] - scan.mX[a];
+        const float ady = scan.mY[d] - scan.mY[a];
+        const float adz = scan.mZ[d] - scan.mZ[a];
+        const float bcx = scan.mX[c] - scan.mX[b];
+        const float bcy = scan.mY[c] - scan.mY[b];
+        const float bcz = scan.mZ[c] - scan.mZ[b];
+        if (adx * adx + ady * ady + adz * adz <=
+            bcx * bcx + bcy * bcy + bcz * bcz) {
+          addTriangle(scan, a, b, d);
+          addTriangle(scan, a, d, c);
+        }
+        else {
+          addTriangle(scan, a, b, c);
+          addTriangle(scan, b, d, c);
+        }
+      }
+    }
+  }
+
+}
@@ -0,0 +1,128 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+/** \file MeshGenerator.h
+    \brief This file defines the MeshGenerator class which triangulates a
+           scan on its ring by azimuth grid.
+  */
+
+#ifndef MESH_GENERATOR_H
+#define MESH_GENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ScanGrid.h"
+
+namespace velodyne {
+
+  struct ScanBuffer;
+
+  /** The class MeshGenerator triangulates a scan without searching for
+      neighbours. The returns are laid out on their ring by azimuth grid and
+      each grid cell is split into two triangles along its shorter diagonal.
+      A triangle is rejected at a depth discontinuity, i.e., when the ratio
+      of its longest to its shortest range is too large, or when its normal
+      is nearly perpendicular to the beam. Grid construction and
+      triangulation are single linear passes.
+      \brief Organized scan triangulation
+    */
+  class MeshGenerator {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor with the elevation of each laser and the fraction of a
+    /// firing step after which it fires
+    MeshGenerator(const std::vector<double>& elevations, const
+      std::vector<double>& firingFractions, double maxRangeRatio, double
+      maxIncidenceAngle, double maxAzimuthGap);
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the scan indices of the vertices of the last mesh
+    const std::vector<uint32_t>& getVertices() const {
+      return _vertices;
+    }
+    /// Returns the vertex indices of the last mesh, three per triangle
+    const std::vector<uint32_t>& getTriangles() const {
+      return _triangles;
+    }
+    /// Returns the number of columns of the last grid
+    size_t getNumColumns() const {
+      return _grid.getNumColumns();
+    }
+    /// Returns the number of triangles rejected in the last mesh
+    size_t getNumRejected() const {
+      return _numRejected;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Triangulates a scan, the triangles face the sensor
+    void generate(const ScanBuffer& scan);
+    /** @}
+      */
+
+  protected:
+    /** \name Protected methods
+      @{
+      */
+    /// Adds a triangle of scan indices if it passes the thresholds
+    void addTriangle(const ScanBuffer& scan, uint32_t i0, uint32_t i1,
+      uint32_t i2);
+    /// Returns the vertex index of a scan index, adding the vertex if needed
+    uint32_t getVertex(uint32_t pointIdx);
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Grid of the scan
+    ScanGrid _grid;
+    /// Max ratio between the longest and the shortest range of a triangle
+    float _maxRangeRatio;
+    /// Cosine of the max angle between the beam and the triangle normal
+    float _cosMaxIncidenceAngle;
+    /// Max azimuth gap between neighbour columns [0.01 deg]
+    uint16_t _maxAzimuthGap;
+    /// Vertex index of each return of the scan
+    std::vector<uint32_t> _vertexIndices;
+    /// Scan indices of the vertices
+    std::vector<uint32_t> _vertices;
+    /// Vertex indices of the triangles
+    std::vector<uint32_t> _triangles;
+    /// Number of triangles rejected in the last mesh
+    size_t _numRejected;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // MESH_GENERATOR_H
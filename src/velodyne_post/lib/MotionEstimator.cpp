@@ -0,0 +1,456 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+#include "MotionEstimator.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "ScanBuffer.h"
+
+namespace velodyne {
+
+  namespace {
+
+    /// Number of azimuth bins of the features
+    const size_t numBins = 360;
+    /// Max ratio between the ranges of a feature and its neighbours
+    const float maxRangeRatio = 1.1f;
+    /// Max curvature along the ring, relative to the neighbour distance
+    const float maxCurvature = 0.1f;
+    /// Min cosine between the normal and the beam of a feature
+    const float minCosIncidence = 0.1f;
+
+    uint16_t getBin(double x, double y) {
+      const size_t bin = (std::atan2(y, x) + M_PI) * (numBins / (2.0 * M_PI));
+      return std::min(bin, numBins - 1);
+    }
+
+    void cross(const double a[3], const double b[3], double c[3]) {
+      c[0] = a[1] * b[2] - a[2] * b[1];
+      c[1] = a[2] * b[0] - a[0] * b[2];
+      c[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    void toRotation(const double v[3], double r[9]) {
+      // Rodrigues' formula, with its expansion for small angles
+      const double angle2 = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+      const double angle = std::sqrt(angle2);
+      const double a = angle < 1e-6 ? 1.0 - angle2 / 6.0 :
+        std::sin(angle) / angle;
+      const double b = angle < 1e-6 ? 0.5 - angle2 / 24.0 :
+        (1.0 - std::cos(angle)) / angle2;
+      r[0] = 1.0 - b * (v[1] * v[1] + v[2] * v[2]);
+      r[1] = -a * v[2] + b * v[0] * v[1];
+      r[2] = a * v[1] + b * v[0] * v[2];
+      r[3] = a * v[2] + b * v[0] * v[1];
+      r[4] = 1.0 - b * (v[0] * v[0] + v[2] * v[2]);
+      r[5] = -a * v[0] + b * v[1] * v[2];
+      r[6] = -a * v[1] + b * v[0] * v[2];
+      r[7] = a * v[0] + b * v[1] * v[2];
+      r[8] = 1.0 - b * (v[0] * v[0] + v[1] * v[1]);
+    }
+
+    void fromRotation(const double r[9], double v[3]) {
+      const double c = std::max(-1.0, std::min(1.0,
+        0.5 * (r[0] + r[4] + r[8] - 1.0)));
+      const double angle = std::acos(c);
+      const double a = angle < 1e-6 ? 0.5 + angle * angle / 12.0 :
+        0.5 * angle / std::sin(angle);
+      v[0] = a * (r[7] - r[5]);
+      v[1] = a * (r[2] - r[6]);
+      v[2] = a * (r[3] - r[1]);
+    }
+
+    void multiply(const double a[9], const double b[9], double c[9]) {
+      for (size_t i = 0; i < 3; ++i)
+        for (size_t j = 0; j < 3; ++j)
+          c[3 * i + j] = a[3 * i] * b[j] + a[3 * i + 1] * b[3 + j] +
+            a[3 * i + 2] * b[6 + j];
+    }
+
+    bool solve(double h[36], const double g[6], double x[6]) {
+      // Cholesky decomposition of the normal equations in place
+      for (size_t j = 0; j < 6; ++j) {
+        double d = h[6 * j + j];
+        for (size_t k = 0; k < j; ++k)
+          d -= h[6 * j + k] * h[6 * j + k];
+        if (d <= 0)
+          return false;
+        h[6 * j + j] = std::sqrt(d);
+        for (size_t i = j + 1; i < 6; ++i) {
+          double s = h[6 * i + j];
+          for (size_t k = 0; k < j; ++k)
+            s -= h[6 * i + k] * h[6 * j + k];
+          h[6 * i + j] = s / h[6 * j + j];
+        }
+      }
+      double y[6];
+      for (size_t i = 0; i < 6; ++i) {
+        double s = -g[i];
+        for (size_t k = 0; k < i; ++k)
+          s -= h[6 * i + k] * y[k];
+        y[i] = s / h[6 * i + i];
+      }
+      for (size_t i = 6; i-- > 0;) {
+        double s = y[i];
+        for (size_t k = i + 1; k < 6; ++k)
+          s -= h[6 * k + i] * x[k];
+        x[i] = s / h[6 * i + i];
+      }
+      return true;
+    }
+
+  }
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  MotionEstimator::MotionEstimator(const std::vector<double>& elevations,
+      const std::vector<double>& firingFractions, size_t columnStride, size_t maxIterations, double
+      maxCorrespondenceDistance, double huberThreshold, size_t
+      minCorrespondences, int64_t maxScanGap, const Callback& callback) :
+      _grid(elevations, firingFractions),
+      _columnStride(std::max(columnStride, static_cast<size_t>(1))),
+      _maxIterations(maxIterations),
+      _maxCorrespondenceDistance(maxCorrespondenceDistance),
+      _huberThreshold(huberThreshold),
+      _minCorrespondences(std::max(minCorrespondences,
+        static_cast<size_t>(6))),
+      _maxScanGap(maxScanGap),
+      _callback(callback),
+      _hasPending(false),
+      _motion(),
+      _hasMotion(false),
+      _numRegistered(0),
+      _numFailed(0),
+      _numDropped(0),
+      _stop(false) {
+    _thread = std::thread(&MotionEstimator::run, this);
+  }
+
+  MotionEstimator::~MotionEstimator() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _condition.notify_one();
+    _thread.join();
+  }
+
+/******************************************************************************/
+/* Accessors                                                                  */
+/******************************************************************************/
+
+  bool MotionEstimator::getMotion(Motion& motion) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    motion = _motion;
+    return _hasMotion;
+  }
+
+  uint64_t MotionEstimator::getNumRegistered() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _numRegistered;
+  }
+
+  uint64_t MotionEstimator::getNumFailed() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _numFailed;
+  }
+
+  uint64_t MotionEstimator::getNumDropped() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _numDropped;
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  void MotionEstimator::deskew(ScanBuffer& scan, float referenceTime) const {
+    Motion motion;
+    if (!getMotion(motion))
+      return;
+    // second-order rotation over the offset to the reference time
+    const size_t numPoints = scan.size();
+    for (size_t i = 0; i < numPoints; ++i) {
+      const double dt = scan.mTime[i] - referenceTime;
+      const double angle[3] = {motion.mAngular[0] * dt,
+        motion.mAngular[1] * dt, motion.mAngular[2] * dt};
+      const double point[3] = {scan.mX[i], scan.mY[i], scan.mZ[i]};
+      double a[3], b[3];
+      cross(angle, point, a);
+      cross(angle, a, b);
+      scan.mX[i] += a[0] + 0.5 * b[0] + motion.mLinear[0] * dt;
+      scan.mY[i] += a[1] + 0.5 * b[1] + motion.mLinear[1] * dt;
+      scan.mZ[i] += a[2] + 0.5 * b[2] + motion.mLinear[2] * dt;
+    }
+  }
+
+  void MotionEstimator::addScan(const ScanBuffer& scan, int64_t time) {
+    extract(scan, _extracted);
+    _extracted.mTime = time;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_hasPending)
+        ++_numDropped;
+      std::swap(_pending, _extracted);
+      _hasPending = true;
+    }
+    _condition.notify_one();
+  }
+
+  void MotionEstimator::extract(const ScanBuffer& scan, Features& features) {
+    _grid.fill(scan);
+    features.mFeatures.clear();
+    const size_t numColumns = _grid.getNumColumns();
+    const size_t numRows = _grid.getNumRows();
+    for (size_t column = 1; column + 1 < numColumns;
+        column += _columnStride) {
+      const uint32_t* left = _grid.getColumn(column - 1);
+      const uint32_t* center = _grid.getColumn(column);
+      const uint32_t* right = _grid.getColumn(column + 1);
+      for (size_t row = 1; row + 1 < numRows; ++row) {
+        const uint32_t indices[5] = {center[row], left[row], right[row],
+          center[row - 1], center[row + 1]};
+        bool valid = true;
+        for (size_t k = 0; k < 5; ++k)
+          valid = valid && indices[k] != ScanGrid::mNone;
+        if (!valid)
+          continue;
+        float minRange = scan.mRange[indices[0]];
+        float maxRange = minRange;
+        for (size_t k = 1; k < 5; ++k) {
+          minRange = std::min(minRange, scan.mRange[indices[k]]);
+          maxRange = std::max(maxRange, scan.mRange[indices[k]]);
+        }
+        if (maxRange > maxRangeRatio * minRange)
+          continue;
+        const uint32_t i = indices[0];
+        const uint32_t l = indices[1];
+        const uint32_t r = indices[2];
+        const uint32_t d = indices[3];
+        const uint32_t u = indices[4];
+        // the return lies on the segment of its ring neighbours
+        const double along[3] = {scan.mX[r] - scan.mX[l],
+          scan.mY[r] - scan.mY[l], scan.mZ[r] - scan.mZ[l]};
+        const double curvature[3] = {
+          scan.mX[l] + scan.mX[r] - 2.0f * scan.mX[i],
+          scan.mY[l] + scan.mY[r] - 2.0f * scan.mY[i],
+          scan.mZ[l] + scan.mZ[r] - 2.0f * scan.mZ[i]};
+        const double alongNorm2 = along[0] * along[0] + along[1] * along[1] +
+          along[2] * along[2];
+        if (curvature[0] * curvature[0] + curvature[1] * curvature[1] +
+            curvature[2] * curvature[2] > maxCurvature * maxCurvature *
+            alongNorm2)
+          continue;
+        const double across[3] = {scan.mX[u] - scan.mX[d],
+          scan.mY[u] - scan.mY[d], scan.mZ[u] - scan.mZ[d]};
+        double normal[3];
+        cross(along, across, normal);
+        const double normalNorm = std::sqrt(normal[0] * normal[0] +
+          normal[1] * normal[1] + normal[2] * normal[2]);
+        const double point[3] = {scan.mX[i], scan.mY[i], scan.mZ[i]};
+        const double pointNorm = std::sqrt(point[0] * point[0] +
+          point[1] * point[1] + point[2] * point[2]);
+        // the normals of grazing planes are unreliable
+        if (normalNorm == 0 || std::fabs(normal[0] * point[0] +
+            normal[1] * point[1] + normal[2] * point[2]) <
+            minCosIncidence * normalNorm * pointNorm)
+          continue;
+        Feature feature;
+        for (size_t k = 0; k < 3; ++k) {
+          feature.mPoint[k] = point[k];
+          feature.mNormal[k] = normal[k] / normalNorm;
+        }
+        feature.mElevation = std::atan2(point[2], std::sqrt(point[0] *
+          point[0] + point[1] * point[1]));
+        feature.mBin = getBin(point[0], point[1]);
+        features.mFeatures.push_back(feature);
+      }
+    }
+    std::sort(features.mFeatures.begin(), features.mFeatures.end(),
+      [](const Feature& a, const Feature& b) {
+        return a.mBin < b.mBin || (a.mBin == b.mBin &&
+          a.mElevation < b.mElevation);});
+    features.mBinStarts.assign(numBins + 1, 0);
+    for (auto it = features.mFeatures.cbegin();
+        it != features.mFeatures.cend(); ++it)
+      ++features.mBinStarts[it->mBin + 1];
+    for (size_t i = 0; i < numBins; ++i)
+      features.mBinStarts[i + 1] += features.mBinStarts[i];
+  }
+
+  const MotionEstimator::Feature* MotionEstimator::match(const Features&
+      features, const double point[3]) const {
+    const uint16_t bin = getBin(point[0], point[1]);
+    const float elevation = std::atan2(point[2], std::sqrt(point[0] *
+      point[0] + point[1] * point[1]));
+    const Feature* begin = features.mFeatures.data() +
+      features.mBinStarts[bin];
+    const Feature* end = features.mFeatures.data() +
+      features.mBinStarts[bin + 1];
+    const Feature* it = std::lower_bound(begin, end, elevation,
+      [](const Feature& feature, float value) {
+        return feature.mElevation < value;});
+    // the closest of the features around the elevation in the bin
+    const Feature* closest = 0;
+    double minDistance2 = _maxCorrespondenceDistance *
+      _maxCorrespondenceDistance;
+    for (const Feature* candidate = std::max(begin, it - 2);
+        candidate < std::min(end, it + 2); ++candidate) {
+      const double dx = candidate->mPoint[0] - point[0];
+      const double dy = candidate->mPoint[1] - point[1];
+      const double dz = candidate->mPoint[2] - point[2];
+      const double distance2 = dx * dx + dy * dy + dz * dz;
+      if (distance2 < minDistance2) {
+        minDistance2 = distance2;
+        closest = candidate;
+      }
+    }
+    return closest;
+  }
+
+  bool MotionEstimator::registerFeatures(const Features& previous, const
+      Features& current, Motion& motion) const {
+    // the transform maps the current scan into the previous one, it starts
+    // from the previous velocity, which only this thread writes
+    const double dt = (current.mTime - previous.mTime) * 1e-9;
+    double rotation[9];
+    double translation[3] = {0, 0, 0};
+    double angle[3] = {0, 0, 0};
+    if (_hasMotion)
+      for (size_t k = 0; k < 3; ++k) {
+        angle[k] = _motion.mAngular[k] * dt;
+        translation[k] = _motion.mLinear[k] * dt;
+      }
+    toRotation(angle, rotation);
+    motion.mTime = current.mTime;
+    motion.mNumIterations = 0;
+    for (size_t iteration = 0; iteration < _maxIterations; ++iteration) {
+      double h[36] = {0};
+      double g[6] = {0};
+      size_t numCorrespondences = 0;
+      double squaredError = 0;
+      for (auto it = current.mFeatures.cbegin();
+          it != current.mFeatures.cend(); ++it) {
+        double point[3];
+        for (size_t k = 0; k < 3; ++k)
+          point[k] = rotation[3 * k] * it->mPoint[0] + rotation[3 * k + 1] *
+            it->mPoint[1] + rotation[3 * k + 2] * it->mPoint[2] +
+            translation[k];
+        const Feature* target = match(previous, point);
+        if (!target)
+          continue;
+        const double normal[3] = {target->mNormal[0], target->mNormal[1],
+          target->mNormal[2]};
+        const double residual = normal[0] * (point[0] - target->mPoint[0]) +
+          normal[1] * (point[1] - target->mPoint[1]) +
+          normal[2] * (point[2] - target->mPoint[2]);
+        double jacobian[6];
+        cross(point, normal, jacobian);
+        jacobian[3] = normal[0];
+        jacobian[4] = normal[1];
+        jacobian[5] = normal[2];
+        const double weight = std::fabs(residual) <= _huberThreshold ? 1.0 :
+          _huberThreshold / std::fabs(residual);
+        for (size_t i = 0; i < 6; ++i) {
+          for (size_t j = 0; j <= i; ++j)
+            h[6 * i + j] += weight * jacobian[i] * jacobian[j];
+          g[i] += weight * jacobian[i] * residual;
+        }
+        ++numCorrespondences;
+        squaredError += residual * residual;
+      }
+      motion.mNumCorrespondences = numCorrespondences;
+      if (numCorrespondences < _minCorrespondences)
+        return false;
+      motion.mRmsError = std::sqrt(squaredError / numCorrespondences);
+      // a slight damping keeps the degenerate directions, e.g., along a
+      // corridor, at the prior
+      for (size_t i = 0; i < 6; ++i) {
+        h[6 * i + i] += 1e-6 * h[6 * i + i] + 1e-9;
+        for (size_t j = 0; j < i; ++j)
+          h[6 * j + i] = h[6 * i + j];
+      }
+      double increment[6];
+      if (!solve(h, g, increment))
+        return false;
+      double deltaRotation[9], updatedRotation[9];
+      toRotation(increment, deltaRotation);
+      multiply(deltaRotation, rotation, updatedRotation);
+      std::copy(updatedRotation, updatedRotation + 9, rotation);
+      double updatedTranslation[3];
+      for (size_t k = 0; k < 3; ++k)
+        updatedTranslation[k] = deltaRotation[3 * k] * translation[0] +
+          deltaRotation[3 * k + 1] * translation[1] +
+          deltaRotation[3 * k + 2] * translation[2] + increment[3 + k];
+      std::copy(updatedTranslation, updatedTranslation + 3, translation);
+      motion.mNumIterations = iteration + 1;
+      if (increment[0] * increment[0] + increment[1] * increment[1] +
+          increment[2] * increment[2] < 1e-10 &&
+          increment[3] * increment[3] + increment[4] * increment[4] +
+          increment[5] * increment[5] < 1e-8)
+        break;
+    }
+    // first-order velocity of the transform over the scan period
+    fromRotation(rotation, angle);
+    for (size_t k = 0; k < 3; ++k) {
+      motion.mAngular[k] = angle[k] / dt;
+      motion.mLinear[k] = translation[k] / dt;
+    }
+    return true;
+  }
+
+  void MotionEstimator::run() {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this] {return _stop || _hasPending;});
+        if (_stop)
+          return;
+        std::swap(_current, _pending);
+        _hasPending = false;
+      }
+      const int64_t gap = _current.mTime - _previous.mTime;
+      const bool registrable = !_previous.mFeatures.empty() && gap > 0 &&
+        gap <= _maxScanGap;
+      Motion motion;
+      const bool registered = registrable &&
+        registerFeatures(_previous, _current, motion);
+      {
+        // the velocity is dropped after a gap or a failure, such that the
+        // scans are not deskewed with a stale one
+        std::lock_guard<std::mutex> lock(_mutex);
+        _hasMotion = registered;
+        if (registered) {
+          _motion = motion;
+          ++_numRegistered;
+        }
+        else
+          _numFailed += registrable;
+      }
+      if (registered && _callback)
+        _callback(motion);
+      std::swap(_previous, _current);
+    }
+  }
+
+}
@@ -0,0 +1,226 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+/** \file MotionEstimator.h
+    \brief This file defines the MotionEstimator class which estimates the
+           motion of the sensor by scan-to-scan registration.
+  */
+
+#ifndef MOTION_ESTIMATOR_H
+#define MOTION_ESTIMATOR_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ScanGrid.h"
+
+namespace velodyne {
+
+  struct ScanBuffer;
+
+  /** The class MotionEstimator estimates the velocity of the sensor without
+      odometry, by registering each scan onto the previous one. The features
+      of a scan are taken from its ring by azimuth grid, every few columns:
+      the returns whose ring and column neighbours lie on a plane, with the
+      normal from their cross product. The features of the current scan are
+      registered onto the planes of the previous scan by point-to-plane
+      Gauss-Newton iterations with a Huber loss, starting from the previous
+      velocity. The correspondences are found by projection: the features of
+      a scan are binned by azimuth and sorted by elevation, and a transformed
+      feature is matched to the closest of the neighbours of its elevation
+      in its bin, such that no search tree is built.
+      The registration runs on a thread of the estimator. A scan handed over
+      while the thread is busy replaces the pending one. The velocity is
+      assumed constant over a scan, which deskews the next scans.
+      \brief Scan-to-scan ego-motion estimator
+    */
+  class MotionEstimator {
+  public:
+    /** \name Types definitions
+      @{
+      */
+    /// Velocity of the sensor in its own frame
+    struct Motion {
+      /// Reference time of the scan the velocity was estimated at [ns]
+      int64_t mTime;
+      /// Linear velocity [m/s]
+      double mLinear[3];
+      /// Angular velocity [rad/s]
+      double mAngular[3];
+      /// Number of correspondences at the last iteration
+      size_t mNumCorrespondences;
+      /// Number of iterations
+      size_t mNumIterations;
+      /// Root mean square point-to-plane distance at the last iteration [m]
+      double mRmsError;
+    };
+    /// Callback for the estimated velocities, called on the estimator thread
+    typedef std::function<void(const Motion&)> Callback;
+    /** @}
+      */
+
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor with the elevation of each laser and the fraction of a
+    /// firing step after which it fires
+    MotionEstimator(const std::vector<double>& elevations,
+      const std::vector<double>& firingFractions, size_t columnStride, size_t maxIterations,
+      double maxCorrespondenceDistance, double huberThreshold,
+      size_t minCorrespondences, int64_t maxScanGap,
+      const Callback& callback = Callback());
+    /// Copy constructor
+    MotionEstimator(const MotionEstimator& other) = delete;
+    /// Copy assignment operator
+    MotionEstimator& operator = (const MotionEstimator& other) = delete;
+    /// Destructor, completes the current registration
+    ~MotionEstimator();
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the latest velocity, false if there is none
+    bool getMotion(Motion& motion) const;
+    /// Returns the number of registered scans
+    uint64_t getNumRegistered() const;
+    /// Returns the number of failed registrations
+    uint64_t getNumFailed() const;
+    /// Returns the number of scans replaced while the thread was busy
+    uint64_t getNumDropped() const;
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Deskews a scan in place to a reference time relative to its start
+    /// time with the latest velocity [s]
+    void deskew(ScanBuffer& scan, float referenceTime) const;
+    /// Extracts the features of a scan at a reference time and hands them
+    /// over to the estimator thread, must not be called concurrently [ns]
+    void addScan(const ScanBuffer& scan, int64_t time);
+    /** @}
+      */
+
+  protected:
+    /** \name Protected types
+      @{
+      */
+    /// Planar feature
+    struct Feature {
+      /// Point [m]
+      float mPoint[3];
+      /// Unit normal
+      float mNormal[3];
+      /// Elevation of the point [rad]
+      float mElevation;
+      /// Azimuth bin of the point
+      uint16_t mBin;
+    };
+    /// Features of a scan, binned by azimuth and sorted by elevation
+    struct Features {
+      /// Reference time [ns]
+      int64_t mTime;
+      /// Features
+      std::vector<Feature> mFeatures;
+      /// Index of the first feature of each bin, and the end of the last
+      std::vector<uint32_t> mBinStarts;
+    };
+    /** @}
+      */
+
+    /** \name Protected methods
+      @{
+      */
+    /// Main loop of the estimator thread
+    void run();
+    /// Extracts the features of a scan
+    void extract(const ScanBuffer& scan, Features& features);
+    /// Registers the current features onto the previous ones, returns false
+    /// on failure
+    bool registerFeatures(const Features& previous, const Features& current,
+      Motion& motion) const;
+    /// Returns the feature of a scan closest to a point, 0 if none
+    const Feature* match(const Features& features, const double point[3])
+      const;
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Grid of the scans
+    ScanGrid _grid;
+    /// Grid columns between feature columns
+    size_t _columnStride;
+    /// Max number of iterations
+    size_t _maxIterations;
+    /// Max distance between corresponding features [m]
+    double _maxCorrespondenceDistance;
+    /// Point-to-plane distance beyond which the loss is linear [m]
+    double _huberThreshold;
+    /// Min number of correspondences for a registration
+    size_t _minCorrespondences;
+    /// Max time between registered scans [ns]
+    int64_t _maxScanGap;
+    /// Velocity callback
+    Callback _callback;
+    /// Features being extracted
+    Features _extracted;
+    /// Features pending for the estimator thread
+    Features _pending;
+    /// Pending features are available
+    bool _hasPending;
+    /// Features of the previous scan, only accessed by the estimator thread
+    Features _previous;
+    /// Features of the current scan, only accessed by the estimator thread
+    Features _current;
+    /// Latest velocity
+    Motion _motion;
+    /// Latest velocity is valid
+    bool _hasMotion;
+    /// Number of registered scans
+    uint64_t _numRegistered;
+    /// Number of failed registrations
+    uint64_t _numFailed;
+    /// Number of scans replaced while the thread was busy
+    uint64_t _numDropped;
+    /// Mutex protecting the pending features and the velocity
+    mutable std::mutex _mutex;
+    /// Signals pending features or the stop
+    std::condition_variable _condition;
+    /// Stop flag
+    bool _stop;
+    /// Estimator thread
+    std::thread _thread;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // MOTION_ESTIMATOR_H
@@ -0,0 +1,173 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+#include "NumaTopology.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  NumaTopology::NumaTopology() :
+      _available(false) {
+    std::ifstream onlineFile("/sys/devices/system/node/online");
+    std::string onlineList;
+    if (std::getline(onlineFile, onlineList)) {
+      const std::vector<int> nodes = parseCpuList(onlineList);
+      for (auto it = nodes.cbegin(); it != nodes.cend(); ++it) {
+        std::ifstream cpuFile("/sys/devices/system/node/node" +
+          std::to_string(*it) + "/cpulist");
+        std::string cpuList;
+        if (!std::getline(cpuFile, cpuList))
+          continue;
+        if (_cpus.size() <= static_cast<size_t>(*it))
+          _cpus.resize(*it + 1);
+        _cpus[*it] = parseCpuList(cpuList);
+        _available = true;
+      }
+    }
+    if (!_available) {
+      _cpus.assign(1, std::vector<int>());
+#ifdef __linux__
+      const long numCpus = sysconf(_SC_NPROCESSORS_CONF);
+      for (long i = 0; i < numCpus; ++i)
+        _cpus[0].push_back(i);
+#endif
+    }
+    for (size_t i = 0; i < _cpus.size(); ++i)
+      for (auto it = _cpus[i].cbegin(); it != _cpus[i].cend(); ++it) {
+        if (_nodes.size() <= static_cast<size_t>(*it))
+          _nodes.resize(*it + 1, -1);
+        _nodes[*it] = i;
+      }
+  }
+
+/******************************************************************************/
+/* Accessors                                                                  */
+/******************************************************************************/
+
+  int NumaTopology::getCurrentNode() const {
+#ifdef __linux__
+    const int cpu = sched_getcpu();
+    if (cpu >= 0 && static_cast<size_t>(cpu) < _nodes.size())
+      return _nodes[cpu];
+#endif
+    return -1;
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  bool NumaTopology::bindThread(size_t node) const {
+    if (!_available || node >= _cpus.size() || _cpus[node].empty())
+      return false;
+#ifdef __linux__
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (auto it = _cpus[node].cbegin(); it != _cpus[node].cend(); ++it)
+      CPU_SET(*it, &cpuSet);
+    // a null pid designates the calling thread
+    return sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == 0;
+#else
+    return false;
+#endif
+  }
+
+  bool NumaTopology::readCounters(size_t node, Counters& counters) const {
+    std::ifstream file("/sys/devices/system/node/node" +
+      std::to_string(node) + "/numastat");
+    if (!file)
+      return false;
+    counters = Counters();
+    std::string name;
+    uint64_t value;
+    while (file >> name >> value)
+      if (name == "local_node")
+        counters.mLocal = value;
+      else if (name == "other_node")
+        counters.mOther = value;
+      else if (name == "numa_miss")
+        counters.mMiss = value;
+      else if (name == "numa_foreign")
+        counters.mForeign = value;
+    return true;
+  }
+
+  std::vector<uint64_t> NumaTopology::readProcessPages() const {
+    std::vector<uint64_t> pages(_cpus.size(), 0);
+    std::ifstream file("/proc/self/numa_maps");
+    std::string token;
+    // each mapping lists its resident pages per node as N<node>=<pages>
+    while (file >> token) {
+      if (token.size() < 4 || token[0] != 'N')
+        continue;
+      const size_t separator = token.find('=');
+      if (separator == std::string::npos)
+        continue;
+      const size_t node = std::strtoul(token.c_str() + 1, 0, 10);
+      if (node < pages.size())
+        pages[node] += std::strtoull(token.c_str() + separator + 1, 0, 10);
+    }
+    return pages;
+  }
+
+  void NumaTopology::touch(void* data, size_t size) {
+#ifdef __linux__
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+#else
+    const size_t pageSize = 4096;
+#endif
+    // writing back the current value leaves the content unchanged
+    volatile char* bytes = static_cast<volatile char*>(data);
+    for (size_t i = 0; i < size; i += pageSize)
+      bytes[i] = bytes[i];
+    // the last page is missed by the stride if the buffer is not aligned
+    if (size)
+      bytes[size - 1] = bytes[size - 1];
+  }
+
+  std::vector<int> NumaTopology::parseCpuList(const std::string& cpuList) {
+    std::vector<int> cpus;
+    std::istringstream stream(cpuList);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+      if (range.empty())
+        continue;
+      const size_t dash = range.find('-');
+      const int first = std::atoi(range.c_str());
+      const int last = dash == std::string::npos ? first :
+        std::atoi(range.c_str() + dash + 1);
+      for (int cpu = first; cpu <= last; ++cpu)
+        cpus.push_back(cpu);
+    }
+    return cpus;
+  }
+
+}
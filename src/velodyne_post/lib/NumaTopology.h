@@ -0,0 +1,132 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+/** \file NumaTopology.h
+    \brief This file defines the NumaTopology class which places threads and
+           memory on the NUMA nodes of the machine.
+  */
+
+#ifndef NUMA_TOPOLOGY_H
+#define NUMA_TOPOLOGY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace velodyne {
+
+  /** The class NumaTopology reads the NUMA nodes and their CPUs from sysfs
+      and binds threads to the CPUs of a node. Linux allocates a page on the
+      node of the thread which first touches it, such that buffers written
+      once by a bound thread stay local to its node. The allocation counters
+      of the nodes and the placement of the pages of the process are read
+      from sysfs and procfs for diagnostics. If the topology is not available,
+      the machine is seen as a single node and binding is a no-op.
+      \brief NUMA topology of the machine
+    */
+  class NumaTopology {
+  public:
+    /** \name Types definitions
+      @{
+      */
+    /// Allocation counters of a node, system-wide
+    struct Counters {
+      /// Pages allocated on the node by its own CPUs
+      uint64_t mLocal;
+      /// Pages allocated on the node by CPUs of other nodes
+      uint64_t mOther;
+      /// Pages allocated on the node while preferring another node
+      uint64_t mMiss;
+      /// Pages allocated on another node while preferring this node
+      uint64_t mForeign;
+    };
+    /** @}
+      */
+
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    NumaTopology();
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns true if the topology was read from sysfs
+    bool isAvailable() const {
+      return _available;
+    }
+    /// Returns the number of nodes, i.e., the highest node index plus one
+    size_t getNumNodes() const {
+      return _cpus.size();
+    }
+    /// Returns the CPUs of a node, empty if the node does not exist
+    const std::vector<int>& getCpus(size_t node) const {
+      return _cpus[node];
+    }
+    /// Returns the node of the CPU running the calling thread, or -1
+    int getCurrentNode() const;
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Binds the calling thread to the CPUs of a node, returns false on
+    /// failure
+    bool bindThread(size_t node) const;
+    /// Reads the allocation counters of a node, returns false on failure
+    bool readCounters(size_t node, Counters& counters) const;
+    /// Returns the number of pages of the process resident on each node
+    std::vector<uint64_t> readProcessPages() const;
+    /// Writes to every page of a buffer such that it is allocated on the node
+    /// of the calling thread
+    static void touch(void* data, size_t size);
+    /** @}
+      */
+
+  protected:
+    /** \name Protected methods
+      @{
+      */
+    /// Parses a CPU list such as 0-7,16-23
+    static std::vector<int> parseCpuList(const std::string& cpuList);
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// CPUs of each node
+    std::vector<std::vector<int> > _cpus;
+    /// Node of each CPU, or -1
+    std::vector<int> _nodes;
+    /// Availability of the topology
+    bool _available;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // NUMA_TOPOLOGY_H
@@ -0,0 +1,264 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+#include "OfflineConverter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <libvelodyne/sensor/DataPacket.h>
+
+#include "ScanBuffer.h"
+#include "ScanLogReader.h"
+#include "ScanLogWriter.h"
+#include "ScanExporter.h"
+#include "DepthImageProjector.h"
+#include "PointColorizer.h"
+#include "LaserStatistics.h"
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Statics                                                                    */
+/******************************************************************************/
+
+  const char OfflineConverter::mMagic[8] = {'V', 'P', 'P', 'T', 'S', 0, 0, 1};
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  OfflineConverter::OfflineConverter(const ScanConverter& converter) :
+      _converter(converter) {
+    // these stages write to shared state which is not part of the output
+    _converter.setDepthProjectors(
+      std::vector<std::shared_ptr<DepthImageProjector> >());
+    _converter.setColorizers(std::vector<std::shared_ptr<PointColorizer> >());
+    _converter.setStatistics(std::shared_ptr<LaserStatistics>());
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  std::vector<OfflineConverter::Shard> OfflineConverter::plan(const
+      std::string& logFileName, size_t numShards) {
+    ScanLogReader reader(logFileName);
+    std::vector<uint64_t> offsets;
+    for (uint64_t offset = reader.getOffset(); reader.skip();
+        offset = reader.getOffset())
+      offsets.push_back(offset);
+    numShards = std::max<size_t>(std::min(numShards, offsets.size()), 1);
+    std::vector<Shard> shards(numShards);
+    shards.front().mStartTime = std::numeric_limits<int64_t>::min();
+    shards.front().mOffset = sizeof(ScanLogWriter::mMagic);
+    shards.back().mEndTime = std::numeric_limits<int64_t>::max();
+    std::vector<DataPacket> dataPackets;
+    for (size_t k = 1; k < numShards; ++k) {
+      // the shard starts with the first packet of its first record and is
+      // read from the previous record
+      const size_t record = k * offsets.size() / numShards;
+      reader.setOffset(offsets[record]);
+      dataPackets.clear();
+      while (reader.read(dataPackets) && dataPackets.empty());
+      shards[k].mStartTime = dataPackets.empty() ?
+        std::numeric_limits<int64_t>::max() :
+        dataPackets.front().getTimestamp();
+      shards[k].mOffset = offsets[record - 1];
+      shards[k - 1].mEndTime = shards[k].mStartTime;
+    }
+    return shards;
+  }
+
+  void OfflineConverter::savePlan(const std::string& fileName, const
+      std::vector<Shard>& shards) {
+    std::ofstream file(fileName, std::ios::trunc);
+    for (auto it = shards.cbegin(); it != shards.cend(); ++it)
+      file << it->mStartTime << " " << it->mEndTime << " " << it->mOffset
+        << std::endl;
+    if (!file)
+      throw std::runtime_error("OfflineConverter: cannot write " + fileName);
+  }
+
+  std::vector<OfflineConverter::Shard> OfflineConverter::loadPlan(const
+      std::string& fileName) {
+    std::ifstream file(fileName);
+    if (!file)
+      throw std::runtime_error("OfflineConverter: cannot open " + fileName);
+    std::vector<Shard> shards;
+    Shard shard;
+    while (file >> shard.mStartTime >> shard.mEndTime >> shard.mOffset)
+      shards.push_back(shard);
+    if (!file.eof())
+      throw std::runtime_error("OfflineConverter: bad plan in " + fileName);
+    return shards;
+  }
+
+  size_t OfflineConverter::convert(const std::string& logFileName, const
+      Shard& shard, const std::string& outputFileName) const {
+    ScanLogReader reader(logFileName);
+    reader.setOffset(shard.mOffset);
+    std::ofstream file(outputFileName, std::ios::binary | std::ios::trunc);
+    if (!file)
+      throw std::runtime_error("OfflineConverter: cannot open " +
+        outputFileName);
+    file.write(mMagic, sizeof(mMagic));
+    std::vector<DataPacket> dataPackets;
+    ScanBuffer scan;
+    size_t numRevolutions = 0;
+    bool owned = false;
+    bool hasPrevious = false;
+    uint16_t previousAzimuth = 0;
+    while (reader.read(dataPackets))
+      for (auto it = dataPackets.cbegin(); it != dataPackets.cend(); ++it) {
+        const uint16_t azimuth = it->getDataChunk(0).mRotationalInfo;
+        if (!hasPrevious || azimuth < previousAzimuth) {
+          if (owned) {
+            write(file, scan);
+            ++numRevolutions;
+          }
+          if (it->getTimestamp() >= shard.mEndTime)
+            return numRevolutions;
+          owned = it->getTimestamp() >= shard.mStartTime;
+          scan.clear();
+          scan.mStartTime = it->getTimestamp();
+        }
+        hasPrevious = true;
+        previousAzimuth = azimuth;
+        if (owned)
+          _converter.convert(*it, scan);
+      }
+    if (owned) {
+      write(file, scan);
+      ++numRevolutions;
+    }
+    return numRevolutions;
+  }
+
+  void OfflineConverter::merge(const std::vector<std::string>&
+      shardFileNames, const std::string& outputFileName) {
+    std::ofstream file(outputFileName, std::ios::binary | std::ios::trunc);
+    if (!file)
+      throw std::runtime_error("OfflineConverter: cannot open " +
+        outputFileName);
+    file.write(mMagic, sizeof(mMagic));
+    for (auto it = shardFileNames.cbegin(); it != shardFileNames.cend();
+        ++it) {
+      std::ifstream shardFile(*it, std::ios::binary);
+      char magic[sizeof(mMagic)];
+      shardFile.read(magic, sizeof(magic));
+      if (!shardFile || std::memcmp(magic, mMagic, sizeof(magic)))
+        throw std::runtime_error("OfflineConverter: bad magic number in " +
+          *it);
+      // an empty shard leaves the stream in a failed state
+      if (shardFile.peek() != std::ifstream::traits_type::eof())
+        file << shardFile.rdbuf();
+    }
+    if (!file)
+      throw std::runtime_error("OfflineConverter: write failed");
+  }
+
+  size_t OfflineConverter::exportPoints(const std::string& fileName,
+      ScanExporter& exporter) {
+    std::ifstream file(fileName, std::ios::binary);
+    char magic[sizeof(mMagic)];
+    file.read(magic, sizeof(magic));
+    if (!file || std::memcmp(magic, mMagic, sizeof(magic)))
+      throw std::runtime_error("OfflineConverter: bad magic number in " +
+        fileName);
+    ScanBuffer scan;
+    size_t numRevolutions = 0;
+    for (; read(file, scan); ++numRevolutions)
+      exporter.write(scan);
+    exporter.close();
+    return numRevolutions;
+  }
+
+  void OfflineConverter::write(std::ofstream& file, const ScanBuffer& scan) {
+    const uint32_t numPoints = scan.size();
+    const uint32_t size = sizeof(scan.mStartTime) + sizeof(numPoints) +
+      numPoints * (6 * sizeof(float) + 2 * sizeof(uint16_t) +
+      sizeof(uint32_t));
+    const char header[] = {static_cast<char>(size),
+      static_cast<char>(size >> 8), static_cast<char>(size >> 16),
+      static_cast<char>(size >> 24)};
+    file.write(header, sizeof(header));
+    file.write(reinterpret_cast<const char*>(&scan.mStartTime),
+      sizeof(scan.mStartTime));
+    file.write(reinterpret_cast<const char*>(&numPoints), sizeof(numPoints));
+    file.write(reinterpret_cast<const char*>(scan.mX.data()),
+      numPoints * sizeof(float));
+    file.write(reinterpret_cast<const char*>(scan.mY.data()),
+      numPoints * sizeof(float));
+    file.write(reinterpret_cast<const char*>(scan.mZ.data()),
+      numPoints * sizeof(float));
+    file.write(reinterpret_cast<const char*>(scan.mIntensity.data()),
+      numPoints * sizeof(float));
+    file.write(reinterpret_cast<const char*>(scan.mRange.data()),
+      numPoints * sizeof(float));
+    file.write(reinterpret_cast<const char*>(scan.mRing.data()),
+      numPoints * sizeof(uint16_t));
+    file.write(reinterpret_cast<const char*>(scan.mAzimuth.data()),
+      numPoints * sizeof(uint16_t));
+    file.write(reinterpret_cast<const char*>(scan.mTime.data()),
+      numPoints * sizeof(float));
+    file.write(reinterpret_cast<const char*>(scan.mRgb.data()),
+      numPoints * sizeof(uint32_t));
+    if (!file)
+      throw std::runtime_error("OfflineConverter: write failed");
+  }
+
+  bool OfflineConverter::read(std::ifstream& file, ScanBuffer& scan) {
+    unsigned char header[4];
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (file.gcount() == 0 && file.eof())
+      return false;
+    uint32_t numPoints = 0;
+    file.read(reinterpret_cast<char*>(&scan.mStartTime),
+      sizeof(scan.mStartTime));
+    file.read(reinterpret_cast<char*>(&numPoints), sizeof(numPoints));
+    if (!file)
+      throw std::runtime_error("OfflineConverter: truncated record");
+    scan.resize(numPoints);
+    file.read(reinterpret_cast<char*>(scan.mX.data()),
+      numPoints * sizeof(float));
+    file.read(reinterpret_cast<char*>(scan.mY.data()),
+      numPoints * sizeof(float));
+    file.read(reinterpret_cast<char*>(scan.mZ.data()),
+      numPoints * sizeof(float));
+    file.read(reinterpret_cast<char*>(scan.mIntensity.data()),
+      numPoints * sizeof(float));
+    file.read(reinterpret_cast<char*>(scan.mRange.data()),
+      numPoints * sizeof(float));
+    file.read(reinterpret_cast<char*>(scan.mRing.data()),
+      numPoints * sizeof(uint16_t));
+    file.read(reinterpret_cast<char*>(scan.mAzimuth.data()),
+      numPoints * sizeof(uint16_t));
+    file.read(reinterpret_cast<char*>(scan.mTime.data()),
+      numPoints * sizeof(float));
+    file.read(reinterpret_cast<char*>(scan.mRgb.data()),
+      numPoints * sizeof(uint32_t));
+    if (!file)
+      throw std::runtime_error("OfflineConverter: truncated record");
+    return true;
+  }
+
+}
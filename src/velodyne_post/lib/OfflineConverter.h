@@ -0,0 +1,137 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+/** \file OfflineConverter.h
+    \brief This file defines the OfflineConverter class which converts scan
+           logs by shards in independent processes.
+  */
+
+#ifndef OFFLINE_CONVERTER_H
+#define OFFLINE_CONVERTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "ScanConverter.h"
+
+namespace velodyne {
+
+  struct ScanBuffer;
+  class ScanExporter;
+
+  /** The class OfflineConverter converts a scan log into a point log, one
+      record per revolution of the sensor. A revolution starts at the first
+      packet of the log and at every packet whose azimuth wraps around. The
+      log is split into shards by time range, a shard owning the revolutions
+      starting in its range. A shard is read from the record preceding its
+      range, which gives the azimuth before its first packet, and past its
+      range until its last revolution is complete, such that the revolutions
+      of the shards are exactly those of a single conversion. The outputs of
+      the shards are thus merged by concatenation.
+      The point log starts with a magic number and is followed by one record
+      per revolution, each record holding the size of its payload as a 32-bit
+      little-endian integer, the start time of the revolution [ns] as a 64-bit
+      integer, the number of points as a 32-bit integer and the columns of the
+      scan buffer one after the other, in the byte order of the host.
+      \brief Sharded offline scan log converter
+    */
+  class OfflineConverter {
+  public:
+    /** \name Types definitions
+      @{
+      */
+    /// Shard of a scan log
+    struct Shard {
+      /// Start of the time range, included [ns]
+      int64_t mStartTime;
+      /// End of the time range, excluded [ns]
+      int64_t mEndTime;
+      /// Offset of the first record to read in the log [B]
+      uint64_t mOffset;
+    };
+    /** @}
+      */
+
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    OfflineConverter(const ScanConverter& converter);
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Splits a scan log into shards of about the same number of records
+    static std::vector<Shard> plan(const std::string& logFileName,
+      size_t numShards);
+    /// Saves shards to a plan file
+    static void savePlan(const std::string& fileName, const
+      std::vector<Shard>& shards);
+    /// Loads shards from a plan file
+    static std::vector<Shard> loadPlan(const std::string& fileName);
+    /// Converts the revolutions of a shard into a point log, returns the
+    /// number of revolutions
+    size_t convert(const std::string& logFileName, const Shard& shard,
+      const std::string& outputFileName) const;
+    /// Merges the point logs of consecutive shards
+    static void merge(const std::vector<std::string>& shardFileNames,
+      const std::string& outputFileName);
+    /// Exports the revolutions of a point log, returns their number
+    static size_t exportPoints(const std::string& fileName, ScanExporter&
+      exporter);
+    /** @}
+      */
+
+    /** \name Public members
+      @{
+      */
+    /// Magic number of a point log
+    static const char mMagic[8];
+    /** @}
+      */
+
+  protected:
+    /** \name Protected methods
+      @{
+      */
+    /// Writes the record of a revolution to a point log
+    static void write(std::ofstream& file, const ScanBuffer& scan);
+    /// Reads the next record of a point log, returns false at the end
+    static bool read(std::ifstream& file, ScanBuffer& scan);
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Converter of the revolutions
+    ScanConverter _converter;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // OFFLINE_CONVERTER_H
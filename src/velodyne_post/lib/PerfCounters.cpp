@@ -0,0 +1,129 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "PerfCounters.h"
+
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  PerfCounters::PerfCounters() :
+      _groupFd(-1),
+      _numOpened(0),
+      _numPoints(0) {
+    for (size_t i = 0; i < numCounters; ++i) {
+      _fds[i] = -1;
+      _indices[i] = -1;
+    }
+    reset();
+#ifdef __linux__
+    const uint64_t configs[numCounters] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (size_t i = 0; i < numCounters; ++i) {
+      struct perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = configs[i];
+      attr.disabled = _groupFd < 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      // counters of the calling thread on any CPU
+      const int fd = syscall(__NR_perf_event_open, &attr, 0, -1, _groupFd, 0);
+      if (fd < 0)
+        continue;
+      _fds[i] = fd;
+      _indices[i] = _numOpened++;
+      if (_groupFd < 0)
+        _groupFd = fd;
+    }
+    if (_groupFd >= 0)
+      ioctl(_groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+  }
+
+  PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (size_t i = 0; i < numCounters; ++i)
+      if (_fds[i] >= 0)
+        close(_fds[i]);
+#endif
+  }
+
+/******************************************************************************/
+/* Accessors                                                                  */
+/******************************************************************************/
+
+  const char* PerfCounters::getStageName(Stage stage) {
+    static const char* names[numStages] = {"decompress", "decode", "convert",
+      "serialize"};
+    return names[stage];
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  void PerfCounters::read(Sample& sample) const {
+    std::memset(&sample, 0, sizeof(sample));
+#ifdef __linux__
+    if (_groupFd < 0)
+      return;
+    uint64_t buffer[1 + numCounters];
+    const ssize_t size = ::read(_groupFd, buffer, sizeof(buffer));
+    if (size < static_cast<ssize_t>((1 + _numOpened) * sizeof(uint64_t)))
+      return;
+    for (size_t i = 0; i < numCounters; ++i)
+      if (_indices[i] >= 0)
+        sample.mValues[i] = buffer[1 + _indices[i]];
+#endif
+  }
+
+  void PerfCounters::accumulate(Stage stage, const Sample& start) {
+    if (_groupFd < 0)
+      return;
+    Sample end;
+    read(end);
+    Totals& totals = _totals[stage];
+    for (size_t i = 0; i < numCounters; ++i)
+      totals.mValues[i] += end.mValues[i] - start.mValues[i];
+    ++totals.mNumSamples;
+  }
+
+  void PerfCounters::reset() {
+    std::memset(_totals, 0, sizeof(_totals));
+    _numPoints = 0;
+  }
+
+}
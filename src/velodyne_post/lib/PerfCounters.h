@@ -0,0 +1,188 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file PerfCounters.h
+    \brief This file defines the PerfCounters class which samples hardware
+           performance counters around the pipeline stages.
+  */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace velodyne {
+
+  /** The class PerfCounters opens hardware performance counters for the
+      calling thread through perf_event_open and accumulates them per pipeline
+      stage. If the counters are not available, e.g., because of the kernel
+      configuration or permissions, sampling is a no-op.
+      \brief Per-stage hardware performance counters
+    */
+  class PerfCounters {
+  public:
+    /** \name Types definitions
+      @{
+      */
+    /// Hardware counters
+    enum Counter {
+      /// CPU cycles
+      cycles,
+      /// Retired instructions
+      instructions,
+      /// Last-level cache misses
+      cacheMisses,
+      /// Mispredicted branches
+      branchMisses,
+      /// Number of counters
+      numCounters
+    };
+    /// Pipeline stages
+    enum Stage {
+      /// Snappy decompression
+      decompress,
+      /// Data packet decoding
+      decode,
+      /// Conversion and filtering
+      convert,
+      /// ROS message serialization
+      serialize,
+      /// Number of stages
+      numStages
+    };
+    /// Sample of the counters
+    struct Sample {
+      /// Counter values
+      uint64_t mValues[numCounters];
+    };
+    /// Accumulated counters of a stage
+    struct Totals {
+      /// Accumulated counter values
+      uint64_t mValues[numCounters];
+      /// Number of samples
+      uint64_t mNumSamples;
+    };
+    /// Samples the counters over the lifetime of the object
+    class Scope {
+    public:
+      /// Constructor, counters may be null
+      Scope(PerfCounters* counters, Stage stage) :
+          _counters(counters),
+          _stage(stage) {
+        if (_counters)
+          _counters->read(_start);
+      }
+      /// Destructor
+      ~Scope() {
+        if (_counters)
+          _counters->accumulate(_stage, _start);
+      }
+      /// Copy constructor
+      Scope(const Scope& other) = delete;
+      /// Copy assignment operator
+      Scope& operator = (const Scope& other) = delete;
+    private:
+      /// Counters
+      PerfCounters* _counters;
+      /// Stage
+      Stage _stage;
+      /// Counters at construction
+      Sample _start;
+    };
+    /** @}
+      */
+
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor, opens the counters for the calling thread
+    PerfCounters();
+    /// Copy constructor
+    PerfCounters(const PerfCounters& other) = delete;
+    /// Copy assignment operator
+    PerfCounters& operator = (const PerfCounters& other) = delete;
+    /// Destructor
+    ~PerfCounters();
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns true if at least one counter is available
+    bool isAvailable() const {
+      return _groupFd >= 0;
+    }
+    /// Returns true if a given counter is available
+    bool isAvailable(Counter counter) const {
+      return _indices[counter] >= 0;
+    }
+    /// Returns the name of a stage
+    static const char* getStageName(Stage stage);
+    /// Returns the accumulated counters of a stage
+    const Totals& getTotals(Stage stage) const {
+      return _totals[stage];
+    }
+    /// Returns the number of processed returns
+    uint64_t getNumPoints() const {
+      return _numPoints;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Reads the counters
+    void read(Sample& sample) const;
+    /// Accumulates the counters since a sample to a stage
+    void accumulate(Stage stage, const Sample& start);
+    /// Adds processed returns
+    void addPoints(size_t numPoints) {
+      _numPoints += numPoints;
+    }
+    /// Resets the accumulated counters
+    void reset();
+    /** @}
+      */
+
+  protected:
+    /** \name Protected members
+      @{
+      */
+    /// File descriptor of the group leader
+    int _groupFd;
+    /// File descriptors of the counters
+    int _fds[numCounters];
+    /// Index of the counters in a group read
+    int _indices[numCounters];
+    /// Number of opened counters
+    size_t _numOpened;
+    /// Accumulated counters per stage
+    Totals _totals[numStages];
+    /// Number of processed returns
+    uint64_t _numPoints;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // PERF_COUNTERS_H
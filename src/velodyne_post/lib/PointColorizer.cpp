@@ -0,0 +1,88 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "PointColorizer.h"
+
+#include <cstdlib>
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  PointColorizer::PointColorizer(const CameraModel& camera, size_t
+      numImages, int64_t maxTimeOffset) :
+      _camera(camera),
+      _images(numImages > 0 ? numImages : 1),
+      _timestamps(_images.size(), 0),
+      _numImages(0),
+      _nextImage(0),
+      _maxTimeOffset(maxTimeOffset),
+      _selectedImage(0) {
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  bool PointColorizer::addImage(int64_t timestamp, const uint8_t* data,
+      size_t dataSize, size_t width, size_t height, size_t step, Encoding
+      encoding) {
+    if (width != _camera.getWidth() || height != _camera.getHeight())
+      return false;
+    const size_t bytesPerPixel = encoding == mono8 ? 1 : 3;
+    if (step < width * bytesPerPixel || dataSize < height * step)
+      return false;
+    std::vector<uint32_t>& image = _images[_nextImage];
+    // the selected image may be overwritten, the next packet reselects
+    image.resize(width * height);
+    for (size_t v = 0; v < height; ++v) {
+      const uint8_t* row = data + v * step;
+      uint32_t* pixels = image.data() + v * width;
+      if (encoding == mono8)
+        for (size_t u = 0; u < width; ++u)
+          pixels[u] = row[u] * 0x010101u;
+      else if (encoding == rgb8)
+        for (size_t u = 0; u < width; ++u, row += 3)
+          pixels[u] = row[0] << 16 | row[1] << 8 | row[2];
+      else
+        for (size_t u = 0; u < width; ++u, row += 3)
+          pixels[u] = row[2] << 16 | row[1] << 8 | row[0];
+    }
+    _timestamps[_nextImage] = timestamp;
+    _nextImage = (_nextImage + 1) % _images.size();
+    if (_numImages < _images.size())
+      ++_numImages;
+    return true;
+  }
+
+  bool PointColorizer::selectImage(int64_t timestamp) {
+    _selectedImage = 0;
+    int64_t bestOffset = _maxTimeOffset;
+    for (size_t i = 0; i < _numImages; ++i) {
+      const int64_t offset = std::llabs(_timestamps[i] - timestamp);
+      if (offset <= bestOffset) {
+        bestOffset = offset;
+        _selectedImage = &_images[i];
+      }
+    }
+    return _selectedImage;
+  }
+
+}
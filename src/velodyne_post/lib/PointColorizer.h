@@ -0,0 +1,135 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file PointColorizer.h
+    \brief This file defines the PointColorizer class which colors returns
+           from time-synchronized camera images.
+  */
+
+#ifndef POINT_COLORIZER_H
+#define POINT_COLORIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "CameraModel.h"
+
+namespace velodyne {
+
+  /** The class PointColorizer keeps the latest images of a calibrated camera
+      and colors returns from the image closest in time to their packet. Since
+      a scan sweeps the camera field of view over several milliseconds, the
+      image is selected per packet rather than per scan.
+      \brief Point colorizer from camera images
+    */
+  class PointColorizer {
+  public:
+    /** \name Types definitions
+      @{
+      */
+    /// Supported image encodings
+    enum Encoding {
+      /// 8-bit red, green, blue
+      rgb8,
+      /// 8-bit blue, green, red
+      bgr8,
+      /// 8-bit grayscale
+      mono8
+    };
+    /** @}
+      */
+
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    PointColorizer(const CameraModel& camera, size_t numImages = 4,
+      int64_t maxTimeOffset = 50000000);
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the camera
+    const CameraModel& getCamera() const {
+      return _camera;
+    }
+    /// Returns the number of buffered images
+    size_t getNumImages() const {
+      return _numImages;
+    }
+    /// Returns the maximum time offset between a packet and an image [ns]
+    int64_t getMaxTimeOffset() const {
+      return _maxTimeOffset;
+    }
+    /// Returns true if an image is selected for the current packet
+    bool hasSelectedImage() const {
+      return _selectedImage;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Adds an image of dataSize bytes, returns false if its size does not
+    /// match the camera or if its step or data are too short for its size
+    bool addImage(int64_t timestamp, const uint8_t* data, size_t dataSize,
+      size_t width, size_t height, size_t step, Encoding encoding);
+    /// Selects the image closest to a packet timestamp [ns]
+    bool selectImage(int64_t timestamp);
+    /// Colors a return with the selected image, returns false if not seen
+    bool colorize(float x, float y, float z, uint32_t& rgb) const {
+      size_t u, v;
+      float depth;
+      if (!_camera.project(x, y, z, u, v, depth))
+        return false;
+      rgb = (*_selectedImage)[v * _camera.getWidth() + u];
+      return true;
+    }
+    /** @}
+      */
+
+  protected:
+    /** \name Protected members
+      @{
+      */
+    /// Camera
+    CameraModel _camera;
+    /// Ring of images packed as 0x00RRGGBB, row-major
+    std::vector<std::vector<uint32_t> > _images;
+    /// Timestamps of the images [ns]
+    std::vector<int64_t> _timestamps;
+    /// Number of buffered images
+    size_t _numImages;
+    /// Index of the next image to be overwritten
+    size_t _nextImage;
+    /// Maximum time offset between a packet and an image [ns]
+    int64_t _maxTimeOffset;
+    /// Image selected for the current packet
+    const std::vector<uint32_t>* _selectedImage;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // POINT_COLORIZER_H
@@ -0,0 +1,50 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "RangeDownsampler.h"
+
+#include <algorithm>
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  RangeDownsampler::RangeDownsampler(double referenceDistance, double
+      minKeepProbability, const std::vector<double>& laserWeights) :
+      _referenceDistance(referenceDistance),
+      _invSquaredReferenceDistance(1.0 / (referenceDistance *
+        referenceDistance)),
+      _minKeepProbability(std::min(std::max(minKeepProbability, 0.0), 1.0)),
+      _laserWeights(laserWeights) {
+  }
+
+/******************************************************************************/
+/* Accessors                                                                  */
+/******************************************************************************/
+
+  double RangeDownsampler::getKeepProbability(size_t laserIdx, double distance)
+      const {
+    double probability = distance * distance * _invSquaredReferenceDistance;
+    if (laserIdx < _laserWeights.size())
+      probability *= _laserWeights[laserIdx];
+    return std::min(std::max(probability, _minKeepProbability), 1.0);
+  }
+
+}
@@ -0,0 +1,110 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file RangeDownsampler.h
+    \brief This file defines the RangeDownsampler class which thins out close
+           returns while keeping the far ones.
+  */
+
+#ifndef RANGE_DOWNSAMPLER_H
+#define RANGE_DOWNSAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace velodyne {
+
+  /** The class RangeDownsampler decides which returns to keep as a function
+      of their range and laser. Since the point density falls with the square
+      of the distance, the keep probability of a return at distance d for laser
+      l is w_l * (d / d_ref)^2, clamped to [p_min, 1]. The decision is taken by
+      comparing the probability against a hash of the laser index and raw
+      azimuth, such that it is deterministic and reproducible across runs.
+      \brief Range-adaptive downsampler
+    */
+  class RangeDownsampler {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    RangeDownsampler(double referenceDistance, double minKeepProbability,
+      const std::vector<double>& laserWeights = std::vector<double>());
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the reference distance, beyond d_ref / sqrt(w_l) all the
+    /// returns of laser l are kept
+    double getReferenceDistance() const {
+      return _referenceDistance;
+    }
+    /// Returns the minimum keep probability
+    double getMinKeepProbability() const {
+      return _minKeepProbability;
+    }
+    /// Returns the keep probability of a return
+    double getKeepProbability(size_t laserIdx, double distance) const;
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Returns true if a return has to be kept
+    bool keep(size_t laserIdx, uint16_t azimuth, double distance) const {
+      return hash(laserIdx, azimuth) <
+        getKeepProbability(laserIdx, distance) * 4294967296.0;
+    }
+    /// Hashes a laser index and raw azimuth to a uniform 32-bit value
+    static uint32_t hash(size_t laserIdx, uint16_t azimuth) {
+      uint32_t h = (static_cast<uint32_t>(laserIdx) << 16) | azimuth;
+      h ^= h >> 16;
+      h *= 0x85ebca6b;
+      h ^= h >> 13;
+      h *= 0xc2b2ae35;
+      h ^= h >> 16;
+      return h;
+    }
+    /** @}
+      */
+
+  protected:
+    /** \name Protected members
+      @{
+      */
+    /// Reference distance, all returns of laser l beyond d_ref / sqrt(w_l)
+    /// are kept
+    double _referenceDistance;
+    /// Inverse of the squared reference distance
+    double _invSquaredReferenceDistance;
+    /// Minimum keep probability
+    double _minKeepProbability;
+    /// Per-laser weights on the keep probability
+    std::vector<double> _laserWeights;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // RANGE_DOWNSAMPLER_H
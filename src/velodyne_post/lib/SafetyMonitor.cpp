@@ -0,0 +1,300 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+#include "SafetyMonitor.h"
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include <libvelodyne/sensor/DataPacket.h>
+
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  SafetyMonitor::SafetyMonitor(const ScanConverter& converter, const
+      std::vector<Field>& fields, double minDistance, double maxDistance,
+      double azimuthResolution, size_t minReturns, int64_t clearDelay) :
+      _converter(converter),
+      _fields(fields),
+      _numLasers(converter.getNumLasers()),
+      _binWidth(std::max(1.0, std::round(azimuthResolution * 18000.0 /
+        M_PI))),
+      _minReturns(std::max(minReturns, static_cast<size_t>(1))),
+      _clearDelay(clearDelay),
+      _numReturns(fields.size(), 0),
+      _violationTimes(fields.size(), 0),
+      _numViolations(fields.size(), 0),
+      _violatedFields(0) {
+    if (_fields.size() > mMaxNumFields)
+      throw std::runtime_error("SafetyMonitor: too many fields");
+    for (auto it = _fields.cbegin(); it != _fields.cend(); ++it)
+      if (it->mX.size() < 3 || it->mX.size() != it->mY.size() ||
+          it->mMinZ > it->mMaxZ)
+        throw std::runtime_error("SafetyMonitor: invalid field " +
+          it->mName);
+    const size_t numBins = (36000 + _binWidth - 1) / _binWidth;
+    const size_t numFields = _fields.size();
+    _limits.resize(numBins * _numLasers * numFields);
+    std::vector<std::vector<double> > criticalRotations(_numLasers *
+      numFields);
+    for (size_t laser = 0; laser < _numLasers; ++laser)
+      for (size_t field = 0; field < numFields; ++field)
+        getCriticalRotations(_fields[field], converter.getCorrection(laser),
+          criticalRotations[laser * numFields + field]);
+    const double binWidth = _binWidth * ScanConverter::mRotationResolution;
+    std::vector<double> rotations;
+    std::vector<double> crossings;
+    for (size_t bin = 0; bin < numBins; ++bin)
+      for (size_t laser = 0; laser < _numLasers; ++laser) {
+        const ScanConverter::LaserCorrection& correction =
+          converter.getCorrection(laser);
+        for (size_t field = 0; field < numFields; ++field) {
+          // the hull over the start, the middle and the end of the bin, and
+          // over the rotations in the bin where the distances may be extreme,
+          // on both sides since the near distance may jump at a vertex
+          const double start = bin * binWidth;
+          rotations.assign({start, start + 0.5 * binWidth,
+            start + binWidth});
+          const std::vector<double>& critical =
+            criticalRotations[laser * numFields + field];
+          for (auto it = critical.cbegin(); it != critical.cend(); ++it) {
+            const double offset = std::fmod(*it - start + 4.0 * M_PI,
+              2.0 * M_PI);
+            if (offset > binWidth)
+              continue;
+            rotations.push_back(start + offset);
+            rotations.push_back(start + std::max(offset - mCriticalEpsilon,
+              0.0));
+            rotations.push_back(start + std::min(offset + mCriticalEpsilon,
+              binWidth));
+          }
+          double near = std::numeric_limits<double>::infinity();
+          double far = -near;
+          for (auto it = rotations.cbegin(); it != rotations.cend(); ++it) {
+            double sampleNear, sampleFar;
+            if (!intersect(_fields[field], correction, *it, crossings,
+                sampleNear, sampleFar))
+              continue;
+            near = std::min(near, std::max(sampleNear, minDistance));
+            far = std::max(far, std::min(sampleFar, maxDistance));
+          }
+          Limits& limits = _limits[(bin * _numLasers + laser) * numFields +
+            field];
+          limits.mNear = std::numeric_limits<uint16_t>::max();
+          limits.mFar = 0;
+          if (near > far)
+            continue;
+          // padded by one unit against the rounding of the samples
+          const double rawNear = std::floor((near -
+            correction.mDistCorrection) / ScanConverter::mDistanceResolution)
+            - 1.0;
+          const double rawFar = std::ceil((far - correction.mDistCorrection)
+            / ScanConverter::mDistanceResolution) + 1.0;
+          if (rawFar < 1.0 || rawNear > std::numeric_limits<uint16_t>::max())
+            continue;
+          limits.mNear = std::max(rawNear, 1.0);
+          limits.mFar = std::min(rawFar,
+            static_cast<double>(std::numeric_limits<uint16_t>::max()));
+        }
+      }
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  bool SafetyMonitor::isInside(const Field& field, double x, double y) {
+    bool inside = false;
+    const size_t numVertices = field.mX.size();
+    for (size_t i = 0, j = numVertices - 1; i < numVertices; j = i++)
+      if ((field.mY[i] > y) != (field.mY[j] > y) && x < field.mX[i] +
+          (field.mX[j] - field.mX[i]) * (y - field.mY[i]) /
+          (field.mY[j] - field.mY[i]))
+        inside = !inside;
+    return inside;
+  }
+
+  void SafetyMonitor::getCriticalRotations(const Field& field, const
+      ScanConverter::LaserCorrection& correction, std::vector<double>&
+      rotations) {
+    // in the xy-plane, the beam at angle a = rotation - rotation correction
+    // runs along u = (cos(a), -sin(a)) at the offset h along
+    // n = (sin(a), cos(a)), h being the horizontal offset correction
+    const double h = correction.mHorizOffsetCorrection;
+    const double rotCorrection = std::atan2(correction.mSinRotCorrection,
+      correction.mCosRotCorrection);
+    rotations.clear();
+    const size_t numVertices = field.mX.size();
+    for (size_t i = 0; i < numVertices; ++i) {
+      // the beam through a vertex (r cos(b), r sin(b)) has a + b = asin(h/r)
+      const double r = std::hypot(field.mX[i], field.mY[i]);
+      if (r > std::fabs(h))
+        rotations.push_back(std::asin(h / r) - std::atan2(field.mY[i],
+          field.mX[i]) + rotCorrection);
+      // the distance to the line of an edge (cos(c), sin(c)) . p = q is
+      // (q - h sin(a + c)) / cos(a + c), extreme at sin(a + c) = h / q
+      const size_t j = (i + 1) % numVertices;
+      double cx = field.mY[j] - field.mY[i];
+      double cy = field.mX[i] - field.mX[j];
+      const double length = std::hypot(cx, cy);
+      if (length == 0)
+        continue;
+      double q = (cx * field.mX[i] + cy * field.mY[i]) / length;
+      if (q < 0) {
+        cx = -cx;
+        cy = -cy;
+        q = -q;
+      }
+      if (q > std::fabs(h))
+        rotations.push_back(std::asin(h / q) - std::atan2(cy, cx) +
+          rotCorrection);
+    }
+  }
+
+  bool SafetyMonitor::intersect(const Field& field, const
+      ScanConverter::LaserCorrection& correction, double rotation,
+      std::vector<double>& crossings, double& near, double& far) {
+    const double sinRotAngle = std::sin(rotation) *
+      correction.mCosRotCorrection - std::cos(rotation) *
+      correction.mSinRotCorrection;
+    const double cosRotAngle = std::cos(rotation) *
+      correction.mCosRotCorrection + std::sin(rotation) *
+      correction.mSinRotCorrection;
+    // the conversion is affine in the distance
+    const double origin[3] = {
+      -correction.mVertOffsetCorrection * correction.mSinVertCorrection *
+        cosRotAngle + correction.mHorizOffsetCorrection * sinRotAngle,
+      correction.mVertOffsetCorrection * correction.mSinVertCorrection *
+        sinRotAngle + correction.mHorizOffsetCorrection * cosRotAngle,
+      correction.mVertOffsetCorrection * correction.mCosVertCorrection};
+    const double direction[3] = {
+      correction.mCosVertCorrection * cosRotAngle,
+      -correction.mCosVertCorrection * sinRotAngle,
+      correction.mSinVertCorrection};
+    return intersect(field, origin, direction, crossings, near, far);
+  }
+
+  bool SafetyMonitor::intersect(const Field& field, const double origin[3],
+      const double direction[3], std::vector<double>& crossings,
+      double& near, double& far) {
+    // the beam crosses the polygon edges and the height limits at the
+    // boundaries of its intervals inside the field, each piece between two
+    // crossings is tested at its middle
+    crossings.clear();
+    if (direction[2] != 0) {
+      if (std::isfinite(field.mMinZ))
+        crossings.push_back((field.mMinZ - origin[2]) / direction[2]);
+      if (std::isfinite(field.mMaxZ))
+        crossings.push_back((field.mMaxZ - origin[2]) / direction[2]);
+    }
+    else if (origin[2] < field.mMinZ || origin[2] > field.mMaxZ)
+      return false;
+    const size_t numVertices = field.mX.size();
+    for (size_t i = 0; i < numVertices; ++i) {
+      const size_t j = (i + 1) % numVertices;
+      const double ex = field.mX[j] - field.mX[i];
+      const double ey = field.mY[j] - field.mY[i];
+      const double denominator = direction[0] * ey - direction[1] * ex;
+      if (denominator == 0)
+        continue;
+      const double wx = field.mX[i] - origin[0];
+      const double wy = field.mY[i] - origin[1];
+      const double t = (wx * direction[1] - wy * direction[0]) / denominator;
+      if (t >= 0 && t <= 1)
+        crossings.push_back((wx * ey - wy * ex) / denominator);
+    }
+    std::sort(crossings.begin(), crossings.end());
+    near = std::numeric_limits<double>::infinity();
+    far = -near;
+    for (size_t i = 0; i + 1 < crossings.size(); ++i) {
+      const double distance = 0.5 * (crossings[i] + crossings[i + 1]);
+      const double z = origin[2] + distance * direction[2];
+      if (z < field.mMinZ || z > field.mMaxZ || !isInside(field,
+          origin[0] + distance * direction[0],
+          origin[1] + distance * direction[1]))
+        continue;
+      near = std::min(near, crossings[i]);
+      far = crossings[i + 1];
+    }
+    return near <= far;
+  }
+
+  void SafetyMonitor::check(const DataPacket& dataPacket) {
+    const size_t numFields = _fields.size();
+    std::fill(_numReturns.begin(), _numReturns.end(), 0);
+    // in dual-return mode, the blocks of a pair share their azimuth step
+    const size_t step = _converter.getReturnMode() ==
+      ScanConverter::ReturnMode::dual ? 2 : 1;
+    for (size_t i = 0; i < DataPacket::mDataChunkNbr; ++i) {
+      const DataPacket::DataChunk& dataChunk = dataPacket.getDataChunk(i);
+      const size_t first = i - i % step;
+      uint16_t azimuthStep = 0;
+      if (first + step < DataPacket::mDataChunkNbr)
+        azimuthStep = ScanConverter::getAzimuthStep(
+          dataPacket.getDataChunk(first).mRotationalInfo,
+          dataPacket.getDataChunk(first + step).mRotationalInfo);
+      else if (first >= step)
+        azimuthStep = ScanConverter::getAzimuthStep(
+          dataPacket.getDataChunk(first - step).mRotationalInfo,
+          dataPacket.getDataChunk(first).mRotationalInfo);
+      for (size_t j = 0; j < DataPacket::DataChunk::mLasersPerPacket; ++j) {
+        const uint16_t rawDistance = dataChunk.mLaserData[j].mDistance;
+        const size_t laser = _converter.getLaserIndex(dataChunk.mHeaderInfo,
+          j);
+        if (rawDistance == 0 || laser >= _numLasers)
+          continue;
+        const uint16_t azimuth = _converter.getReturnAzimuth(
+          dataChunk.mRotationalInfo, azimuthStep, j);
+        const Limits* limits = &_limits[(azimuth / _binWidth * _numLasers +
+          laser) * numFields];
+        for (size_t field = 0; field < numFields; ++field)
+          _numReturns[field] += rawDistance >= limits[field].mNear &&
+            rawDistance <= limits[field].mFar;
+      }
+    }
+  }
+
+  bool SafetyMonitor::update(const DataPacket& dataPacket) {
+    check(dataPacket);
+    const int64_t time = dataPacket.getTimestamp();
+    uint32_t violatedFields = 0;
+    for (size_t field = 0; field < _fields.size(); ++field) {
+      const uint32_t mask = static_cast<uint32_t>(1) << field;
+      if (_numReturns[field] >= _minReturns) {
+        if (!(_violatedFields & mask))
+          ++_numViolations[field];
+        _violationTimes[field] = time;
+        violatedFields |= mask;
+      }
+      else if ((_violatedFields & mask) &&
+          time - _violationTimes[field] < _clearDelay)
+        violatedFields |= mask;
+    }
+    const bool changed = violatedFields != _violatedFields;
+    _violatedFields = violatedFields;
+    return changed;
+  }
+
+}
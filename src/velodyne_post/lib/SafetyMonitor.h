@@ -0,0 +1,202 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+/** \file SafetyMonitor.h
+    \brief This file defines the SafetyMonitor class which checks the data
+           packets against protective fields.
+  */
+
+#ifndef SAFETY_MONITOR_H
+#define SAFETY_MONITOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ScanConverter.h"
+
+class DataPacket;
+
+namespace velodyne {
+
+  /** The class SafetyMonitor checks every data packet against protective
+      fields as it arrives, without waiting for the revolution. A field is a
+      polygon in the xy-plane of the sensor, extruded between two heights.
+      Since a return lies on the beam of its laser at its azimuth, the part of
+      the beam inside a field is an interval of distances, which is
+      precomputed in raw distance units for each azimuth bin, laser and field.
+      Checking a return therefore takes two integer comparisons per field and
+      no Cartesian conversion. A beam crossing a non-convex field several
+      times is checked against the hull of its intervals, i.e.,
+      conservatively, and so are the azimuths within a bin. Since the
+      interval of a field corner between two sampled azimuths may be nearer
+      than all the samples, a bin is also sampled at the beams through the
+      polygon vertices and at the beams where the distance to an edge is
+      extreme, and the limits are padded by one distance unit.
+      A field is violated as soon as a packet has enough returns inside, it
+      is cleared once no packet has had enough returns inside for a delay,
+      such that the whole field has been swept.
+      \brief Per-packet protective field monitor
+    */
+  class SafetyMonitor {
+  public:
+    /** \name Types definitions
+      @{
+      */
+    /// Protective field
+    struct Field {
+      /// Name
+      std::string mName;
+      /// X coordinates of the polygon vertices [m]
+      std::vector<double> mX;
+      /// Y coordinates of the polygon vertices [m]
+      std::vector<double> mY;
+      /// Min height [m]
+      double mMinZ;
+      /// Max height [m]
+      double mMaxZ;
+    };
+    /** @}
+      */
+
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    SafetyMonitor(const ScanConverter& converter,
+      const std::vector<Field>& fields, double minDistance,
+      double maxDistance, double azimuthResolution, size_t minReturns,
+      int64_t clearDelay);
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the fields
+    const std::vector<Field>& getFields() const {
+      return _fields;
+    }
+    /// Returns the mask of the violated fields
+    uint32_t getViolatedFields() const {
+      return _violatedFields;
+    }
+    /// Returns the number of returns inside each field in the last packet
+    const std::vector<uint16_t>& getNumReturns() const {
+      return _numReturns;
+    }
+    /// Returns the number of times each field has been violated
+    const std::vector<uint64_t>& getNumViolations() const {
+      return _numViolations;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Checks a data packet and updates the state of the fields, returns
+    /// true if the state changed
+    bool update(const DataPacket& dataPacket);
+    /** @}
+      */
+
+    /** \name Public members
+      @{
+      */
+    /// Max number of fields
+    static const size_t mMaxNumFields = 32;
+    /// Rotation offset of the samples around a critical rotation [rad]
+    static constexpr double mCriticalEpsilon = 1e-7;
+    /** @}
+      */
+
+  protected:
+    /** \name Protected types
+      @{
+      */
+    /// Raw distances of a beam inside a field, empty if near > far
+    struct Limits {
+      /// Nearest raw distance inside
+      uint16_t mNear;
+      /// Farthest raw distance inside
+      uint16_t mFar;
+    };
+    /** @}
+      */
+
+    /** \name Protected methods
+      @{
+      */
+    /// Counts the returns of a data packet inside each field
+    void check(const DataPacket& dataPacket);
+    /// Returns the rotations [rad] of a laser where the distances inside a
+    /// field may be extreme, i.e., through the polygon vertices and at the
+    /// extreme distances to the edges
+    static void getCriticalRotations(const Field& field, const
+      ScanConverter::LaserCorrection& correction, std::vector<double>&
+      rotations);
+    /// Returns the hull of the distances inside a field on the beam of a
+    /// laser at a rotation [rad] [m]
+    static bool intersect(const Field& field, const
+      ScanConverter::LaserCorrection& correction, double rotation,
+      std::vector<double>& crossings, double& near, double& far);
+    /// Returns the hull of the distances on a beam inside a field [m]
+    static bool intersect(const Field& field, const double origin[3],
+      const double direction[3], std::vector<double>& crossings,
+      double& near, double& far);
+    /// Returns true if a point is inside a polygon
+    static bool isInside(const Field& field, double x, double y);
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Converter of the device
+    const ScanConverter& _converter;
+    /// Fields
+    std::vector<Field> _fields;
+    /// Number of lasers
+    size_t _numLasers;
+    /// Width of an azimuth bin [0.01 deg]
+    uint16_t _binWidth;
+    /// Limits per azimuth bin, laser and field
+    std::vector<Limits> _limits;
+    /// Number of returns inside a field in one packet to violate it
+    size_t _minReturns;
+    /// Delay without violation before a field is cleared [ns]
+    int64_t _clearDelay;
+    /// Number of returns inside each field in the last packet
+    std::vector<uint16_t> _numReturns;
+    /// Time of the last violation of each field [ns]
+    std::vector<int64_t> _violationTimes;
+    /// Number of times each field has been violated
+    std::vector<uint64_t> _numViolations;
+    /// Mask of the violated fields
+    uint32_t _violatedFields;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // SAFETY_MONITOR_H
@@ -0,0 +1,173 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file ScanBuffer.h
+    \brief This file defines the ScanBuffer structure which holds a converted
+           Velodyne scan in structure-of-arrays form.
+  */
+
+#ifndef SCAN_BUFFER_H
+#define SCAN_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace velodyne {
+
+  /** The structure ScanBuffer holds the points of a converted Velodyne scan
+      in structure-of-arrays form. Points are stored in firing order, i.e.,
+      azimuth-major, such that the returns of a given laser appear with
+      increasing azimuth.
+      \brief Converted Velodyne scan
+    */
+  struct ScanBuffer {
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Default constructor
+    ScanBuffer() :
+        mStartTime(0) {
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Returns the number of points
+    size_t size() const {
+      return mX.size();
+    }
+    /// Reserves memory for a given number of points
+    void reserve(size_t numPoints) {
+      mX.reserve(numPoints);
+      mY.reserve(numPoints);
+      mZ.reserve(numPoints);
+      mIntensity.reserve(numPoints);
+      mRange.reserve(numPoints);
+      mRing.reserve(numPoints);
+      mAzimuth.reserve(numPoints);
+      mTime.reserve(numPoints);
+      mRgb.reserve(numPoints);
+    }
+    /// Resizes the buffer to a given number of points
+    void resize(size_t numPoints) {
+      mX.resize(numPoints);
+      mY.resize(numPoints);
+      mZ.resize(numPoints);
+      mIntensity.resize(numPoints);
+      mRange.resize(numPoints);
+      mRing.resize(numPoints);
+      mAzimuth.resize(numPoints);
+      mTime.resize(numPoints);
+      mRgb.resize(numPoints);
+    }
+    /// Removes all the points while keeping the memory
+    void clear() {
+      mX.clear();
+      mY.clear();
+      mZ.clear();
+      mIntensity.clear();
+      mRange.clear();
+      mRing.clear();
+      mAzimuth.clear();
+      mTime.clear();
+      mRgb.clear();
+    }
+    /// Appends a point
+    void push_back(float x, float y, float z, float intensity, float range,
+        uint16_t ring, uint16_t azimuth, float time = 0, uint32_t rgb = 0) {
+      mX.push_back(x);
+      mY.push_back(y);
+      mZ.push_back(z);
+      mIntensity.push_back(intensity);
+      mRange.push_back(range);
+      mRing.push_back(ring);
+      mAzimuth.push_back(azimuth);
+      mTime.push_back(time);
+      mRgb.push_back(rgb);
+    }
+    /// Sets a point at a given index
+    void set(size_t i, float x, float y, float z, float intensity,
+        float range, uint16_t ring, uint16_t azimuth, float time = 0,
+        uint32_t rgb = 0) {
+      mX[i] = x;
+      mY[i] = y;
+      mZ[i] = z;
+      mIntensity[i] = intensity;
+      mRange[i] = range;
+      mRing[i] = ring;
+      mAzimuth[i] = azimuth;
+      mTime[i] = time;
+      mRgb[i] = rgb;
+    }
+    /// Appends the points of another buffer
+    void append(const ScanBuffer& other) {
+      mX.insert(mX.end(), other.mX.begin(), other.mX.end());
+      mY.insert(mY.end(), other.mY.begin(), other.mY.end());
+      mZ.insert(mZ.end(), other.mZ.begin(), other.mZ.end());
+      mIntensity.insert(mIntensity.end(), other.mIntensity.begin(),
+        other.mIntensity.end());
+      mRange.insert(mRange.end(), other.mRange.begin(), other.mRange.end());
+      mRing.insert(mRing.end(), other.mRing.begin(), other.mRing.end());
+      mAzimuth.insert(mAzimuth.end(), other.mAzimuth.begin(),
+        other.mAzimuth.end());
+      mTime.insert(mTime.end(), other.mTime.begin(), other.mTime.end());
+      mRgb.insert(mRgb.end(), other.mRgb.begin(), other.mRgb.end());
+    }
+    /// Copies a point from another buffer at a given index
+    void set(size_t i, const ScanBuffer& other, size_t j) {
+      set(i, other.mX[j], other.mY[j], other.mZ[j], other.mIntensity[j],
+        other.mRange[j], other.mRing[j], other.mAzimuth[j], other.mTime[j],
+        other.mRgb[j]);
+    }
+    /** @}
+      */
+
+    /** \name Public members
+      @{
+      */
+    /// X coordinates [m]
+    std::vector<float> mX;
+    /// Y coordinates [m]
+    std::vector<float> mY;
+    /// Z coordinates [m]
+    std::vector<float> mZ;
+    /// Intensities
+    std::vector<float> mIntensity;
+    /// Corrected ranges [m]
+    std::vector<float> mRange;
+    /// Laser indices
+    std::vector<uint16_t> mRing;
+    /// Raw azimuths [0.01 deg]
+    std::vector<uint16_t> mAzimuth;
+    /// Times relative to mStartTime [s]
+    std::vector<float> mTime;
+    /// Colors packed as 0x00RRGGBB, zero if not colored
+    std::vector<uint32_t> mRgb;
+    /// Reference time of the points [ns]
+    int64_t mStartTime;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // SCAN_BUFFER_H
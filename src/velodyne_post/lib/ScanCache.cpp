@@ -0,0 +1,173 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "ScanCache.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <libvelodyne/sensor/DataPacket.h>
+
+#include "ScanBuffer.h"
+#include "ScanConverter.h"
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  ScanCache::ScanCache(size_t numScans) :
+      _scans(std::max(numScans, size_t(1))),
+      _next(0),
+      _numScans(0) {
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  void ScanCache::insert(const std::vector<DataPacket>& dataPackets) {
+    const size_t numLasers = DataPacket::DataChunk::mLasersPerPacket;
+    const size_t numBlocks = dataPackets.size() * DataPacket::mDataChunkNbr;
+    RawScan& rawScan = _scans[_next];
+    rawScan.mTimestamps.resize(numBlocks);
+    rawScan.mHeaderInfos.resize(numBlocks);
+    rawScan.mRotationalInfos.resize(numBlocks);
+    rawScan.mDistances.resize(numBlocks * numLasers);
+    rawScan.mIntensities.resize(numBlocks * numLasers);
+    size_t block = 0;
+    for (auto it = dataPackets.cbegin(); it != dataPackets.cend(); ++it)
+      for (size_t i = 0; i < DataPacket::mDataChunkNbr; ++i, ++block) {
+        const DataPacket::DataChunk& dataChunk = it->getDataChunk(i);
+        rawScan.mTimestamps[block] = it->getTimestamp();
+        rawScan.mHeaderInfos[block] = dataChunk.mHeaderInfo;
+        rawScan.mRotationalInfos[block] = dataChunk.mRotationalInfo;
+        for (size_t j = 0; j < numLasers; ++j) {
+          rawScan.mDistances[block * numLasers + j] =
+            dataChunk.mLaserData[j].mDistance;
+          rawScan.mIntensities[block * numLasers + j] =
+            dataChunk.mLaserData[j].mIntensity;
+        }
+      }
+    _next = (_next + 1) % _scans.size();
+    _numScans = std::min(_numScans + 1, _scans.size());
+  }
+
+  bool ScanCache::isInSector(double azimuth, double start, double span) {
+    if (span >= 2 * M_PI)
+      return true;
+    double offset = std::fmod(azimuth - start, 2 * M_PI);
+    if (offset < 0)
+      offset += 2 * M_PI;
+    return offset <= span;
+  }
+
+  size_t ScanCache::query(const Region& region, const ScanConverter&
+      converter, size_t numScans, ScanBuffer& scan) const {
+    const double margin = converter.getAzimuthMargin();
+    double sectorSpan = 2 * M_PI;
+    if (region.mHasSector) {
+      sectorSpan = std::fmod(region.mSectorEnd - region.mSectorStart,
+        2 * M_PI);
+      if (sectorSpan <= 0)
+        sectorSpan += 2 * M_PI;
+    }
+    // azimuth interval covering the box if it does not contain the sensor
+    double boxStart = 0.0;
+    double boxSpan = 2 * M_PI;
+    if (region.mHasBox && (region.mBoxMin[0] > 0 || region.mBoxMax[0] < 0 ||
+        region.mBoxMin[1] > 0 || region.mBoxMax[1] < 0)) {
+      const double center = std::atan2(
+        0.5 * (region.mBoxMin[1] + region.mBoxMax[1]),
+        0.5 * (region.mBoxMin[0] + region.mBoxMax[0]));
+      double halfSpan = 0.0;
+      for (size_t i = 0; i < 4; ++i) {
+        const double corner = std::atan2(
+          i & 1 ? region.mBoxMax[1] : region.mBoxMin[1],
+          i & 2 ? region.mBoxMax[0] : region.mBoxMin[0]);
+        halfSpan = std::max(halfSpan, std::fabs(std::remainder(corner - center,
+          2 * M_PI)));
+      }
+      boxStart = center - halfSpan;
+      boxSpan = 2 * halfSpan;
+    }
+    const size_t numLasers = DataPacket::DataChunk::mLasersPerPacket;
+    const size_t step =
+      converter.getReturnMode() == ScanConverter::ReturnMode::dual ? 2 : 1;
+    numScans = numScans ? std::min(numScans, _numScans) : _numScans;
+    size_t numBlocks = 0;
+    for (size_t k = 0; k < numScans; ++k) {
+      const RawScan& rawScan =
+        _scans[(_next + _scans.size() - 1 - k) % _scans.size()];
+      // in dual-return mode, the blocks of a pair are converted together
+      // such that the returns are selected as in the live scans
+      for (size_t i = 0; i + step <= rawScan.mTimestamps.size(); i += step) {
+        if (region.mHasTimeWindow && (rawScan.mTimestamps[i] <
+            region.mStartTime || rawScan.mTimestamps[i] > region.mEndTime))
+          continue;
+        // the sensor rotates clockwise
+        const double azimuth = -rawScan.mRotationalInfos[i] *
+          ScanConverter::mRotationResolution;
+        if (!isInSector(azimuth, region.mSectorStart - margin,
+            sectorSpan + 2 * margin) || !isInSector(azimuth,
+            boxStart - margin, boxSpan + 2 * margin))
+          continue;
+        const size_t first = scan.size();
+        if (first == 0)
+          scan.mStartTime = rawScan.mTimestamps[i];
+        // VLP returns are interpolated towards the next firing block of
+        // the same return, blocks are stored packet after packet
+        const size_t firing = i % DataPacket::mDataChunkNbr / step;
+        uint16_t azimuthStep = 0;
+        if (i + step < rawScan.mRotationalInfos.size())
+          azimuthStep = ScanConverter::getAzimuthStep(
+            rawScan.mRotationalInfos[i], rawScan.mRotationalInfos[i + step]);
+        else if (i >= step)
+          azimuthStep = ScanConverter::getAzimuthStep(
+            rawScan.mRotationalInfos[i - step], rawScan.mRotationalInfos[i]);
+        converter.convertBlock(rawScan.mTimestamps[i] +
+          std::llround(firing * converter.getBlockDuration() * 1e9),
+          rawScan.mHeaderInfos[i], rawScan.mRotationalInfos[i], azimuthStep,
+          &rawScan.mDistances[i * numLasers],
+          &rawScan.mIntensities[i * numLasers], scan, step == 2 ?
+          &rawScan.mDistances[(i + 1) * numLasers] : 0, step == 2 ?
+          &rawScan.mIntensities[(i + 1) * numLasers] : 0);
+        numBlocks += step;
+        size_t numPoints = first;
+        for (size_t j = first; j < scan.size(); ++j) {
+          const bool inBox = !region.mHasBox ||
+            (scan.mX[j] >= region.mBoxMin[0] &&
+            scan.mX[j] <= region.mBoxMax[0] &&
+            scan.mY[j] >= region.mBoxMin[1] &&
+            scan.mY[j] <= region.mBoxMax[1] &&
+            scan.mZ[j] >= region.mBoxMin[2] &&
+            scan.mZ[j] <= region.mBoxMax[2]);
+          const bool inSector = !region.mHasSector || isInSector(
+            std::atan2(scan.mY[j], scan.mX[j]), region.mSectorStart,
+            sectorSpan);
+          scan.set(numPoints, scan, j);
+          numPoints += inBox && inSector;
+        }
+        scan.resize(numPoints);
+      }
+    }
+    return numBlocks;
+  }
+
+}
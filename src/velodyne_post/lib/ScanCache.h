@@ -0,0 +1,141 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file ScanCache.h
+    \brief This file defines the ScanCache class which keeps the latest raw
+           scans for on-demand region queries.
+  */
+
+#ifndef SCAN_CACHE_H
+#define SCAN_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class DataPacket;
+
+namespace velodyne {
+
+  struct ScanBuffer;
+  class ScanConverter;
+
+  /** The class ScanCache keeps the latest raw scans in structure-of-arrays
+      form. Region queries only convert the blocks whose azimuth and time
+      overlap the region, and return the matching points at full resolution.
+      \brief Cache of the latest raw scans
+    */
+  class ScanCache {
+  public:
+    /** \name Types definitions
+      @{
+      */
+    /// Raw scan in structure-of-arrays form, one entry per block
+    struct RawScan {
+      /// Packet timestamps [ns]
+      std::vector<int64_t> mTimestamps;
+      /// Header infos
+      std::vector<uint16_t> mHeaderInfos;
+      /// Raw azimuths [0.01 deg]
+      std::vector<uint16_t> mRotationalInfos;
+      /// Raw distances, one row of lasers per block
+      std::vector<uint16_t> mDistances;
+      /// Raw intensities, one row of lasers per block
+      std::vector<uint8_t> mIntensities;
+    };
+    /// Query region, the constraints are combined
+    struct Region {
+      /// Box constraint is active
+      bool mHasBox;
+      /// Box lower corner in the sensor frame [m]
+      double mBoxMin[3];
+      /// Box upper corner in the sensor frame [m]
+      double mBoxMax[3];
+      /// Sector constraint is active
+      bool mHasSector;
+      /// Sector start, counterclockwise from the x-axis [rad]
+      double mSectorStart;
+      /// Sector end, counterclockwise from the x-axis [rad]
+      double mSectorEnd;
+      /// Time window constraint is active
+      bool mHasTimeWindow;
+      /// Time window start [ns]
+      int64_t mStartTime;
+      /// Time window end [ns]
+      int64_t mEndTime;
+    };
+    /** @}
+      */
+
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    ScanCache(size_t numScans);
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the number of cached scans
+    size_t getNumScans() const {
+      return _numScans;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Inserts a scan, replacing the oldest one if the cache is full
+    void insert(const std::vector<DataPacket>& dataPackets);
+    /// Appends the points of the latest scans within a region, returns the
+    /// number of converted blocks
+    size_t query(const Region& region, const ScanConverter& converter,
+      size_t numScans, ScanBuffer& scan) const;
+    /** @}
+      */
+
+  protected:
+    /** \name Protected methods
+      @{
+      */
+    /// Returns true if a sensor-frame azimuth is within an interval given by
+    /// its start and counterclockwise span
+    static bool isInSector(double azimuth, double start, double span);
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Ring of cached scans
+    std::vector<RawScan> _scans;
+    /// Index of the next scan to be replaced
+    size_t _next;
+    /// Number of cached scans
+    size_t _numScans;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // SCAN_CACHE_H
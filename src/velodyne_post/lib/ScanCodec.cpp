@@ -0,0 +1,354 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "ScanCodec.h"
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include <libvelodyne/sensor/DataPacket.h>
+
+namespace velodyne {
+
+  namespace {
+
+    /// Magic number of an encoded scan
+    const char magic[] = {'V', 'P', 'S', 'C'};
+    /// Number of streams of an encoded scan
+    const size_t numStreams = 5;
+    /// Stream storage modes
+    enum StreamMode {stored = 0, rans = 1};
+    /// Lower bound of the rANS state
+    const uint32_t ransLowerBound = 1u << 23;
+    /// Number of bits of the rANS frequencies
+    const uint32_t ransScaleBits = 12;
+    /// Sum of the rANS frequencies
+    const uint32_t ransScale = 1u << ransScaleBits;
+    /// Header info of the lower block
+    const uint16_t lowerBank = 0xddff;
+    /// Number of lasers in both blocks
+    const size_t numRings = 2 * DataPacket::DataChunk::mLasersPerPacket;
+
+    inline uint64_t zigzag(int64_t value) {
+      return (static_cast<uint64_t>(value) << 1) ^
+        static_cast<uint64_t>(value >> 63);
+    }
+
+    inline int64_t unzigzag(uint64_t value) {
+      return static_cast<int64_t>(value >> 1) ^
+        -static_cast<int64_t>(value & 1);
+    }
+
+    inline void writeVarint(std::string& stream, uint64_t value) {
+      while (value >= 0x80) {
+        stream.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+      }
+      stream.push_back(static_cast<char>(value));
+    }
+
+    /// Bounds-checked reader over a byte range
+    class Reader {
+    public:
+      Reader(const char* data, size_t size) :
+          _data(reinterpret_cast<const uint8_t*>(data)),
+          _size(size),
+          _pos(0) {
+      }
+      uint8_t readByte() {
+        if (_pos >= _size)
+          throw std::runtime_error("ScanCodec: truncated data");
+        return _data[_pos++];
+      }
+      uint64_t readVarint() {
+        uint64_t value = 0;
+        for (size_t shift = 0; shift < 64; shift += 7) {
+          const uint8_t byte = readByte();
+          value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+          if (!(byte & 0x80))
+            return value;
+        }
+        throw std::runtime_error("ScanCodec: malformed varint");
+      }
+      const char* readBytes(size_t size) {
+        if (size > _size - _pos)
+          throw std::runtime_error("ScanCodec: truncated data");
+        const char* bytes = reinterpret_cast<const char*>(_data + _pos);
+        _pos += size;
+        return bytes;
+      }
+    private:
+      const uint8_t* _data;
+      size_t _size;
+      size_t _pos;
+    };
+
+    void entropyEncode(const std::string& raw, std::string& data) {
+      writeVarint(data, raw.size());
+      std::string coded;
+      if (!raw.empty()) {
+        uint64_t counts[256] = {0};
+        for (auto it = raw.cbegin(); it != raw.cend(); ++it)
+          ++counts[static_cast<uint8_t>(*it)];
+        uint32_t frequencies[256] = {0};
+        uint32_t sum = 0;
+        size_t mostFrequent = 0;
+        for (size_t i = 0; i < 256; ++i) {
+          if (!counts[i])
+            continue;
+          frequencies[i] = counts[i] * ransScale / raw.size();
+          if (!frequencies[i])
+            frequencies[i] = 1;
+          sum += frequencies[i];
+          if (counts[i] > counts[mostFrequent])
+            mostFrequent = i;
+        }
+        if (sum < ransScale)
+          frequencies[mostFrequent] += ransScale - sum;
+        while (sum > ransScale) {
+          size_t largest = 0;
+          for (size_t i = 1; i < 256; ++i)
+            if (frequencies[i] > frequencies[largest])
+              largest = i;
+          const uint32_t decrement = std::min(frequencies[largest] - 1,
+            sum - ransScale);
+          frequencies[largest] -= decrement;
+          sum -= decrement;
+        }
+        uint32_t starts[256];
+        uint32_t start = 0;
+        size_t numSymbols = 0;
+        for (size_t i = 0; i < 256; ++i) {
+          starts[i] = start;
+          start += frequencies[i];
+          numSymbols += frequencies[i] > 0;
+        }
+        writeVarint(coded, numSymbols);
+        for (size_t i = 0; i < 256; ++i)
+          if (frequencies[i]) {
+            coded.push_back(static_cast<char>(i));
+            writeVarint(coded, frequencies[i]);
+          }
+        // the rANS encoder runs backwards such that the decoder runs forwards
+        std::vector<uint8_t> buffer(2 * raw.size() + 16);
+        uint8_t* end = buffer.data() + buffer.size();
+        uint8_t* ptr = end;
+        uint32_t state = ransLowerBound;
+        for (size_t i = raw.size(); i > 0; --i) {
+          const uint8_t symbol = raw[i - 1];
+          const uint32_t frequency = frequencies[symbol];
+          const uint32_t maxState = ((ransLowerBound >> ransScaleBits) << 8) *
+            frequency;
+          while (state >= maxState) {
+            *--ptr = state & 0xff;
+            state >>= 8;
+          }
+          state = ((state / frequency) << ransScaleBits) +
+            (state % frequency) + starts[symbol];
+        }
+        for (size_t i = 0; i < 4; ++i)
+          *--ptr = state >> (8 * i);
+        writeVarint(coded, end - ptr);
+        coded.append(reinterpret_cast<const char*>(ptr), end - ptr);
+      }
+      if (!raw.empty() && coded.size() < raw.size()) {
+        data.push_back(rans);
+        data.append(coded);
+      }
+      else {
+        data.push_back(stored);
+        data.append(raw);
+      }
+    }
+
+    void entropyDecode(Reader& reader, std::string& raw) {
+      const size_t size = reader.readVarint();
+      const uint8_t mode = reader.readByte();
+      if (mode == stored) {
+        raw.assign(reader.readBytes(size), size);
+        return;
+      }
+      if (mode != rans)
+        throw std::runtime_error("ScanCodec: unknown stream mode");
+      const size_t numSymbols = reader.readVarint();
+      uint32_t frequencies[256] = {0};
+      for (size_t i = 0; i < numSymbols; ++i) {
+        const uint8_t symbol = reader.readByte();
+        frequencies[symbol] = reader.readVarint();
+      }
+      uint32_t starts[256];
+      uint32_t start = 0;
+      uint8_t symbols[ransScale];
+      for (size_t i = 0; i < 256; ++i) {
+        if (frequencies[i] > ransScale - start)
+          throw std::runtime_error("ScanCodec: invalid frequencies");
+        starts[i] = start;
+        std::memset(symbols + start, i, frequencies[i]);
+        start += frequencies[i];
+      }
+      if (start != ransScale)
+        throw std::runtime_error("ScanCodec: invalid frequencies");
+      const size_t payloadSize = reader.readVarint();
+      Reader payload(reader.readBytes(payloadSize), payloadSize);
+      if (size / ransScale > 8 * payloadSize)
+        throw std::runtime_error("ScanCodec: invalid stream size");
+      uint32_t state = 0;
+      for (size_t i = 0; i < 4; ++i)
+        state = (state << 8) | payload.readByte();
+      raw.resize(size);
+      for (size_t i = 0; i < size; ++i) {
+        const uint32_t slot = state & (ransScale - 1);
+        const uint8_t symbol = symbols[slot];
+        raw[i] = symbol;
+        state = frequencies[symbol] * (state >> ransScaleBits) + slot -
+          starts[symbol];
+        while (state < ransLowerBound)
+          state = (state << 8) | payload.readByte();
+      }
+    }
+
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  void ScanCodec::encode(const std::vector<DataPacket>& dataPackets,
+      std::string& data) {
+    std::string streams[numStreams];
+    std::string& packetStream = streams[0];
+    std::string& headerStream = streams[1];
+    std::string& rotationStream = streams[2];
+    std::string& distanceStream = streams[3];
+    std::string& intensityStream = streams[4];
+    distanceStream.reserve(dataPackets.size() * DataPacket::mDataChunkNbr *
+      DataPacket::DataChunk::mLasersPerPacket * 2);
+    intensityStream.reserve(dataPackets.size() * DataPacket::mDataChunkNbr *
+      DataPacket::DataChunk::mLasersPerPacket);
+    int64_t lastTimestamp = 0;
+    int64_t lastTimestampDelta = 0;
+    uint16_t lastSpinCount = 0;
+    uint32_t lastReserved = 0;
+    uint16_t lastHeaders[DataPacket::mDataChunkNbr] = {0};
+    uint16_t lastRotations[2] = {0, 0};
+    uint16_t lastDistances[numRings] = {0};
+    uint8_t lastIntensities[numRings] = {0};
+    size_t chunkIdx = 0;
+    for (auto it = dataPackets.cbegin(); it != dataPackets.cend(); ++it) {
+      const int64_t timestampDelta = it->getTimestamp() - lastTimestamp;
+      writeVarint(packetStream, zigzag(timestampDelta - lastTimestampDelta));
+      lastTimestamp = it->getTimestamp();
+      lastTimestampDelta = timestampDelta;
+      writeVarint(packetStream, zigzag(static_cast<int16_t>(
+        it->getSpinCount() - lastSpinCount)));
+      lastSpinCount = it->getSpinCount();
+      writeVarint(packetStream, zigzag(static_cast<int32_t>(
+        it->getReserved() - lastReserved)));
+      lastReserved = it->getReserved();
+      for (size_t i = 0; i < DataPacket::mDataChunkNbr; ++i, ++chunkIdx) {
+        const DataPacket::DataChunk& dataChunk = it->getDataChunk(i);
+        writeVarint(headerStream, zigzag(static_cast<int16_t>(
+          dataChunk.mHeaderInfo - lastHeaders[i])));
+        lastHeaders[i] = dataChunk.mHeaderInfo;
+        uint16_t& lastRotation = lastRotations[chunkIdx % 2];
+        writeVarint(rotationStream, zigzag(static_cast<int16_t>(
+          dataChunk.mRotationalInfo - lastRotation)));
+        lastRotation = dataChunk.mRotationalInfo;
+        const size_t ringOffset = dataChunk.mHeaderInfo == lowerBank ?
+          DataPacket::DataChunk::mLasersPerPacket : 0;
+        for (size_t j = 0; j < DataPacket::DataChunk::mLasersPerPacket; ++j) {
+          const DataPacket::LaserData& laserData = dataChunk.mLaserData[j];
+          const size_t ring = ringOffset + j;
+          writeVarint(distanceStream, zigzag(static_cast<int16_t>(
+            laserData.mDistance - lastDistances[ring])));
+          lastDistances[ring] = laserData.mDistance;
+          const int8_t intensityDelta = static_cast<int8_t>(
+            laserData.mIntensity - lastIntensities[ring]);
+          intensityStream.push_back(static_cast<char>(zigzag(intensityDelta)));
+          lastIntensities[ring] = laserData.mIntensity;
+        }
+      }
+    }
+    data.clear();
+    data.append(magic, sizeof(magic));
+    data.push_back(mVersion);
+    writeVarint(data, dataPackets.size());
+    for (size_t i = 0; i < numStreams; ++i)
+      entropyEncode(streams[i], data);
+  }
+
+  void ScanCodec::decode(const char* data, size_t size,
+      std::vector<DataPacket>& dataPackets) {
+    Reader reader(data, size);
+    if (std::memcmp(reader.readBytes(sizeof(magic)), magic, sizeof(magic)))
+      throw std::runtime_error("ScanCodec: bad magic number");
+    if (reader.readByte() != mVersion)
+      throw std::runtime_error("ScanCodec: unsupported version");
+    const size_t numPackets = reader.readVarint();
+    std::string streams[numStreams];
+    for (size_t i = 0; i < numStreams; ++i)
+      entropyDecode(reader, streams[i]);
+    if (numPackets > streams[0].size())
+      throw std::runtime_error("ScanCodec: invalid number of packets");
+    Reader packetStream(streams[0].data(), streams[0].size());
+    Reader headerStream(streams[1].data(), streams[1].size());
+    Reader rotationStream(streams[2].data(), streams[2].size());
+    Reader distanceStream(streams[3].data(), streams[3].size());
+    Reader intensityStream(streams[4].data(), streams[4].size());
+    int64_t lastTimestamp = 0;
+    int64_t lastTimestampDelta = 0;
+    uint16_t lastSpinCount = 0;
+    uint32_t lastReserved = 0;
+    uint16_t lastHeaders[DataPacket::mDataChunkNbr] = {0};
+    uint16_t lastRotations[2] = {0, 0};
+    uint16_t lastDistances[numRings] = {0};
+    uint8_t lastIntensities[numRings] = {0};
+    size_t chunkIdx = 0;
+    dataPackets.resize(numPackets);
+    for (auto it = dataPackets.begin(); it != dataPackets.end(); ++it) {
+      lastTimestampDelta += unzigzag(packetStream.readVarint());
+      lastTimestamp += lastTimestampDelta;
+      it->setTimestamp(lastTimestamp);
+      lastSpinCount += unzigzag(packetStream.readVarint());
+      it->setSpinCount(lastSpinCount);
+      lastReserved += unzigzag(packetStream.readVarint());
+      it->setReserved(lastReserved);
+      for (size_t i = 0; i < DataPacket::mDataChunkNbr; ++i, ++chunkIdx) {
+        DataPacket::DataChunk dataChunk;
+        lastHeaders[i] += unzigzag(headerStream.readVarint());
+        dataChunk.mHeaderInfo = lastHeaders[i];
+        uint16_t& lastRotation = lastRotations[chunkIdx % 2];
+        lastRotation += unzigzag(rotationStream.readVarint());
+        dataChunk.mRotationalInfo = lastRotation;
+        const size_t ringOffset = dataChunk.mHeaderInfo == lowerBank ?
+          DataPacket::DataChunk::mLasersPerPacket : 0;
+        for (size_t j = 0; j < DataPacket::DataChunk::mLasersPerPacket; ++j) {
+          const size_t ring = ringOffset + j;
+          lastDistances[ring] += unzigzag(distanceStream.readVarint());
+          dataChunk.mLaserData[j].mDistance = lastDistances[ring];
+          lastIntensities[ring] += unzigzag(intensityStream.readByte());
+          dataChunk.mLaserData[j].mIntensity = lastIntensities[ring];
+        }
+        it->setDataChunk(dataChunk, i);
+      }
+    }
+  }
+
+}
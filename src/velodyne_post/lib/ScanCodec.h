@@ -0,0 +1,77 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file ScanCodec.h
+    \brief This file defines the ScanCodec class which losslessly compresses
+           the data packets of Velodyne scans.
+  */
+
+#ifndef SCAN_CODEC_H
+#define SCAN_CODEC_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class DataPacket;
+
+namespace velodyne {
+
+  /** The class ScanCodec losslessly compresses the data packets of a Velodyne
+      scan by exploiting its structure. The raw fields are split into
+      separate streams: packet headers, block headers, azimuths, distances and
+      intensities. Timestamps are delta-of-delta coded, azimuths are delta
+      coded against the previous block of the same bank, distances and
+      intensities are delta coded against the previous return of the same
+      laser. Each stream is then entropy coded with a static order-0 rANS
+      coder, or stored if this does not pay off. Decoding reconstructs the
+      data packets bit-exactly.
+      \brief Lossless Velodyne scan codec
+    */
+  class ScanCodec {
+  public:
+    /** \name Methods
+      @{
+      */
+    /// Encodes the data packets of a scan
+    static void encode(const std::vector<DataPacket>& dataPackets,
+      std::string& data);
+    /// Decodes the data packets of a scan
+    static void decode(const char* data, size_t size,
+      std::vector<DataPacket>& dataPackets);
+    /// Decodes the data packets of a scan
+    static void decode(const std::string& data,
+      std::vector<DataPacket>& dataPackets) {
+      decode(data.data(), data.size(), dataPackets);
+    }
+    /** @}
+      */
+
+    /** \name Public members
+      @{
+      */
+    /// Format version
+    static const unsigned char mVersion = 1;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // SCAN_CODEC_H
@@ -0,0 +1,446 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "ScanConverter.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <libvelodyne/sensor/DataPacket.h>
+#include <libvelodyne/sensor/Calibration.h>
+
+#include "ScanBuffer.h"
+#include "RangeDownsampler.h"
+#include "IntensityExtractor.h"
+#include "DepthImageProjector.h"
+#include "PointColorizer.h"
+#include "LaserStatistics.h"
+
+namespace velodyne {
+
+  struct ScanConverter::Outputs {
+    /// Scan output
+    ScanBuffer& mScan;
+    /// Number of points written to the scan output
+    size_t mNumPoints;
+    /// Intensity output
+    ScanBuffer* mIntensityScan;
+    /// Number of points written to the intensity output
+    size_t mNumIntensityPoints;
+    /// Range-adaptive downsampler of the scan output
+    const RangeDownsampler* mDownsampler;
+    /// Selector of the intensity output
+    const IntensityExtractor* mIntensityExtractor;
+    /// Mask of the depth projectors that may see the current block
+    uint32_t mCameraMask;
+    /// Mask of the colorizers that may see the current block
+    uint32_t mColorizerMask;
+    /// Per-laser statistics
+    LaserStatistics* mStatistics;
+    /// Time of the current packet relative to the scan start time [s]
+    float mTime;
+  };
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  ScanConverter::ScanConverter(const Calibration& calibration, double
+      minDistance, double maxDistance) :
+      _corrections(Calibration::mLasersNbr),
+      _minDistance(minDistance),
+      _maxDistance(maxDistance),
+      _returnMode(ReturnMode::single),
+      _returnSelection(ReturnSelection::strongest),
+      _intensityReturnSelection(ReturnSelection::strongest) {
+    setLayout(Layout::hdl);
+    for (size_t i = 0; i < _corrections.size(); ++i) {
+      LaserCorrection& correction = _corrections[i];
+      const double vertCorrection = calibration.getVertCorrection(i);
+      const double rotCorrection = calibration.getRotCorrection(i);
+      correction.mSinVertCorrection = std::sin(vertCorrection);
+      correction.mCosVertCorrection = std::cos(vertCorrection);
+      correction.mSinRotCorrection = std::sin(rotCorrection);
+      correction.mCosRotCorrection = std::cos(rotCorrection);
+      correction.mDistCorrection = calibration.getDistCorrection(i);
+      correction.mVertOffsetCorrection =
+        calibration.getVertOffsetCorrection(i);
+      correction.mHorizOffsetCorrection =
+        calibration.getHorizOffsetCorrection(i);
+    }
+  }
+
+/******************************************************************************/
+/* Accessors                                                                  */
+/******************************************************************************/
+
+  void ScanConverter::setDownsampler(const std::shared_ptr<RangeDownsampler>&
+      downsampler) {
+    _downsampler = downsampler;
+  }
+
+  void ScanConverter::setIntensityExtractor(const
+      std::shared_ptr<IntensityExtractor>& intensityExtractor) {
+    _intensityExtractor = intensityExtractor;
+  }
+
+  void ScanConverter::setDepthProjectors(const
+      std::vector<std::shared_ptr<DepthImageProjector> >& depthProjectors) {
+    _depthProjectors = depthProjectors;
+    if (_depthProjectors.size() > 32)
+      _depthProjectors.resize(32);
+  }
+
+  void ScanConverter::setColorizers(const
+      std::vector<std::shared_ptr<PointColorizer> >& colorizers) {
+    _colorizers = colorizers;
+    if (_colorizers.size() > 32)
+      _colorizers.resize(32);
+  }
+
+  void ScanConverter::setStatistics(const std::shared_ptr<LaserStatistics>&
+      statistics) {
+    _statistics = statistics;
+  }
+
+  double ScanConverter::getAzimuthMargin() const {
+    // the rotational correction plus a bound on the horizontal offset
+    // contribution beyond the minimum distance
+    double margin = 0.0;
+    for (auto it = _corrections.cbegin(); it != _corrections.cend(); ++it)
+      margin = std::max(margin, std::fabs(std::asin(it->mSinRotCorrection)));
+    return margin + 2.0 * M_PI / 180.0;
+  }
+
+  void ScanConverter::setReturnMode(ReturnMode returnMode) {
+    _returnMode = returnMode;
+  }
+
+  void ScanConverter::setReturnSelection(ReturnSelection returnSelection) {
+    _returnSelection = returnSelection;
+  }
+
+  void ScanConverter::setIntensityReturnSelection(ReturnSelection
+      returnSelection) {
+    _intensityReturnSelection = returnSelection;
+  }
+
+  void ScanConverter::setLayout(Layout layout) {
+    _layout = layout;
+    // HDL blocks are converted at the azimuth and time of their packet, VLP
+    // returns are spread over the block with the firing timing of the device
+    _blockDuration = 0.0f;
+    for (size_t j = 0; j < DataPacket::DataChunk::mLasersPerPacket; ++j) {
+      double firingTime = 0.0;
+      if (layout == Layout::vlp16) {
+        _blockDuration = 2.0 * mVlpSequenceDuration;
+        firingTime = (j / 16) * mVlpSequenceDuration +
+          (j % 16) * mVlpFiringPeriod;
+      }
+      else if (layout == Layout::vlp32c) {
+        _blockDuration = mVlpSequenceDuration;
+        firingTime = (j / 2) * mVlpFiringPeriod;
+      }
+      _firingTimes[j] = firingTime;
+      _azimuthFractions[j] = _blockDuration > 0.0f ?
+        std::lround(firingTime / _blockDuration * 65536.0) : 0;
+    }
+  }
+
+  size_t ScanConverter::getNumLasers() const {
+    switch (_layout) {
+      case Layout::vlp16:
+        return 16;
+      case Layout::vlp32c:
+        return 32;
+      default:
+        return _corrections.size();
+    }
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  void ScanConverter::convert(const DataPacket& dataPacket, ScanBuffer& scan,
+      ScanBuffer* intensityScan) const {
+    const size_t maxPoints = DataPacket::mDataChunkNbr *
+      DataPacket::DataChunk::mLasersPerPacket;
+    Outputs outputs = {scan, scan.size(), intensityScan, 0,
+      _downsampler.get(), intensityScan ? _intensityExtractor.get() : 0, 0, 0,
+      _statistics.get(),
+      (dataPacket.getTimestamp() - scan.mStartTime) * 1e-9f};
+    scan.resize(outputs.mNumPoints + maxPoints);
+    if (outputs.mIntensityExtractor) {
+      outputs.mNumIntensityPoints = intensityScan->size();
+      intensityScan->resize(outputs.mNumIntensityPoints + maxPoints);
+    }
+    // the sweep crosses a camera over several packets, each of them picks the
+    // image closest in time
+    for (auto it = _colorizers.cbegin(); it != _colorizers.cend(); ++it)
+      (*it)->selectImage(dataPacket.getTimestamp());
+    const unsigned int features =
+      (outputs.mDownsampler ? downsampling : 0) |
+      (outputs.mIntensityExtractor ? intensityExtraction : 0) |
+      (outputs.mStatistics ? statistics : 0) |
+      (_depthProjectors.empty() && _colorizers.empty() ? 0 : cameras);
+    const PacketKernel* kernels = _layout == Layout::vlp16 ?
+      getKernels<Layout::vlp16>() : _layout == Layout::vlp32c ?
+      getKernels<Layout::vlp32c>() : getKernels<Layout::hdl>();
+    (this->*kernels[features])(dataPacket, outputs);
+    scan.resize(outputs.mNumPoints);
+    if (outputs.mIntensityExtractor)
+      intensityScan->resize(outputs.mNumIntensityPoints);
+  }
+
+  void ScanConverter::convertBlock(int64_t timestamp, uint16_t headerInfo,
+      uint16_t rotationalInfo, uint16_t azimuthStep, const uint16_t*
+      distances, const uint8_t* intensities, ScanBuffer& scan, const
+      uint16_t* otherDistances, const uint8_t* otherIntensities) const {
+    Outputs outputs = {scan, scan.size(), 0, 0, 0, 0, 0, 0, 0,
+      (timestamp - scan.mStartTime) * 1e-9f};
+    const bool pair = otherDistances && otherIntensities;
+    scan.resize(outputs.mNumPoints + (pair ? 2 : 1) *
+      DataPacket::DataChunk::mLasersPerPacket);
+    DataPacket::DataChunk dataChunk;
+    DataPacket::DataChunk otherChunk;
+    dataChunk.mHeaderInfo = headerInfo;
+    dataChunk.mRotationalInfo = rotationalInfo;
+    otherChunk.mHeaderInfo = headerInfo;
+    otherChunk.mRotationalInfo = rotationalInfo;
+    for (size_t j = 0; j < DataPacket::DataChunk::mLasersPerPacket; ++j) {
+      dataChunk.mLaserData[j].mDistance = distances[j];
+      dataChunk.mLaserData[j].mIntensity = intensities[j];
+      if (pair) {
+        otherChunk.mLaserData[j].mDistance = otherDistances[j];
+        otherChunk.mLaserData[j].mIntensity = otherIntensities[j];
+      }
+    }
+    const DataPacket::DataChunk* other = pair ? &otherChunk : 0;
+    switch (_layout) {
+      case Layout::vlp16:
+        convertChunk<Layout::vlp16, 0>(dataChunk, other, azimuthStep,
+          outputs.mTime, outputs);
+        break;
+      case Layout::vlp32c:
+        convertChunk<Layout::vlp32c, 0>(dataChunk, other, azimuthStep,
+          outputs.mTime, outputs);
+        break;
+      default:
+        convertChunk<Layout::hdl, 0>(dataChunk, other, azimuthStep,
+          outputs.mTime, outputs);
+    }
+    scan.resize(outputs.mNumPoints);
+  }
+
+  uint32_t ScanConverter::getCameraMask(uint16_t rotationalInfo) const {
+    uint32_t cameraMask = 0;
+    for (size_t i = 0; i < _depthProjectors.size(); ++i)
+      cameraMask |= static_cast<uint32_t>(
+        _depthProjectors[i]->getCamera().isVisible(rotationalInfo)) << i;
+    return cameraMask;
+  }
+
+  uint32_t ScanConverter::getColorizerMask(uint16_t rotationalInfo) const {
+    uint32_t colorizerMask = 0;
+    for (size_t i = 0; i < _colorizers.size(); ++i)
+      colorizerMask |= static_cast<uint32_t>(
+        _colorizers[i]->hasSelectedImage() &&
+        _colorizers[i]->getCamera().isVisible(rotationalInfo)) << i;
+    return colorizerMask;
+  }
+
+  template <ScanConverter::Layout L>
+  const ScanConverter::PacketKernel* ScanConverter::getKernels() {
+    static const PacketKernel kernels[numFeatureSets] = {
+      &ScanConverter::convertPacket<L, 0>,
+      &ScanConverter::convertPacket<L, 1>,
+      &ScanConverter::convertPacket<L, 2>,
+      &ScanConverter::convertPacket<L, 3>,
+      &ScanConverter::convertPacket<L, 4>,
+      &ScanConverter::convertPacket<L, 5>,
+      &ScanConverter::convertPacket<L, 6>,
+      &ScanConverter::convertPacket<L, 7>,
+      &ScanConverter::convertPacket<L, 8>,
+      &ScanConverter::convertPacket<L, 9>,
+      &ScanConverter::convertPacket<L, 10>,
+      &ScanConverter::convertPacket<L, 11>,
+      &ScanConverter::convertPacket<L, 12>,
+      &ScanConverter::convertPacket<L, 13>,
+      &ScanConverter::convertPacket<L, 14>,
+      &ScanConverter::convertPacket<L, 15>
+    };
+    return kernels;
+  }
+
+  template <ScanConverter::Layout L, unsigned int Features>
+  void ScanConverter::convertPacket(const DataPacket& dataPacket, Outputs&
+      outputs) const {
+    // in dual-return mode, blocks come in pairs with the same azimuth, the
+    // first one holding the last return, the second one the strongest return
+    // if it differs from the last, the second strongest otherwise
+    const size_t step = _returnMode == ReturnMode::dual ? 2 : 1;
+    for (size_t i = 0; i + step <= DataPacket::mDataChunkNbr; i += step) {
+      const DataPacket::DataChunk& dataChunk = dataPacket.getDataChunk(i);
+      uint16_t azimuthStep = 0;
+      if (L != Layout::hdl) {
+        // the azimuth step of the last block is extrapolated from the
+        // previous one
+        if (i + step < DataPacket::mDataChunkNbr)
+          azimuthStep = getAzimuthStep(dataChunk.mRotationalInfo,
+            dataPacket.getDataChunk(i + step).mRotationalInfo);
+        else if (i >= step)
+          azimuthStep = getAzimuthStep(
+            dataPacket.getDataChunk(i - step).mRotationalInfo,
+            dataChunk.mRotationalInfo);
+      }
+      convertChunk<L, Features>(dataChunk, step == 2 ?
+        &dataPacket.getDataChunk(i + 1) : 0, azimuthStep,
+        outputs.mTime + (i / step) * _blockDuration, outputs);
+    }
+  }
+
+  template <ScanConverter::Layout L, unsigned int Features>
+  void ScanConverter::convertChunk(const DataPacket::DataChunk& dataChunk,
+      const DataPacket::DataChunk* otherChunk, uint16_t azimuthStep, float
+      time, Outputs& outputs) const {
+    const size_t laserIdxOffset = L == Layout::hdl &&
+      dataChunk.mHeaderInfo == mLowerBank ?
+      DataPacket::DataChunk::mLasersPerPacket : 0;
+    if (Features & cameras) {
+      outputs.mCameraMask = getCameraMask(dataChunk.mRotationalInfo);
+      outputs.mColorizerMask = getColorizerMask(dataChunk.mRotationalInfo);
+    }
+    const double rotation = dataChunk.mRotationalInfo * mRotationResolution;
+    const double sinBlockRotation = std::sin(rotation);
+    const double cosBlockRotation = std::cos(rotation);
+    for (size_t j = 0; j < DataPacket::DataChunk::mLasersPerPacket; ++j) {
+      const size_t laserIdx = L == Layout::vlp16 ? j % 16 :
+        laserIdxOffset + j;
+      uint16_t azimuth = dataChunk.mRotationalInfo;
+      double sinRotation = sinBlockRotation;
+      double cosRotation = cosBlockRotation;
+      float returnTime = time;
+      if (L != Layout::hdl) {
+        // the azimuth advances by a fraction of a block step, which is small
+        // enough for a third-order expansion of the angle addition
+        const uint32_t fraction = azimuthStep * _azimuthFractions[j];
+        azimuth = (azimuth + ((fraction + 32768) >> 16)) % 36000;
+        const double delta = fraction * (mRotationResolution / 65536.0);
+        const double sinDelta = delta * (1.0 - delta * delta / 6.0);
+        const double cosDelta = 1.0 - delta * delta * 0.5;
+        sinRotation = sinBlockRotation * cosDelta +
+          cosBlockRotation * sinDelta;
+        cosRotation = cosBlockRotation * cosDelta -
+          sinBlockRotation * sinDelta;
+        returnTime += _firingTimes[j];
+      }
+      const DataPacket::LaserData& last = dataChunk.mLaserData[j];
+      if (!otherChunk) {
+        convertReturn<Features>(last.mDistance, last.mIntensity, laserIdx,
+          azimuth, sinRotation, cosRotation, returnTime, true, true,
+          outputs);
+        continue;
+      }
+      const DataPacket::LaserData& other = otherChunk->mLaserData[j];
+      const bool duplicate = other.mDistance == last.mDistance &&
+        other.mIntensity == last.mIntensity;
+      const bool otherStrongest = other.mIntensity > last.mIntensity;
+      convertReturn<Features>(last.mDistance, last.mIntensity, laserIdx,
+        azimuth, sinRotation, cosRotation, returnTime,
+        _returnSelection != ReturnSelection::strongest || !otherStrongest,
+        _intensityReturnSelection != ReturnSelection::strongest ||
+        !otherStrongest, outputs);
+      if (duplicate)
+        continue;
+      convertReturn<Features>(other.mDistance, other.mIntensity, laserIdx,
+        azimuth, sinRotation, cosRotation, returnTime,
+        _returnSelection == ReturnSelection::both ||
+        (_returnSelection == ReturnSelection::strongest && otherStrongest),
+        _intensityReturnSelection == ReturnSelection::both ||
+        (_intensityReturnSelection == ReturnSelection::strongest &&
+        otherStrongest), outputs);
+    }
+  }
+
+  template <unsigned int Features>
+  void ScanConverter::convertReturn(uint16_t rawDistance, uint8_t intensity,
+      size_t laserIdx, uint16_t azimuth, double sinRotation, double
+      cosRotation, float time, bool toScan, bool toIntensityScan, Outputs&
+      outputs) const {
+    if (rawDistance == 0) {
+      if (Features & statistics)
+        outputs.mStatistics->addZero(laserIdx);
+      return;
+    }
+    const LaserCorrection& correction = _corrections[laserIdx];
+    const double distance = rawDistance * mDistanceResolution +
+      correction.mDistCorrection;
+    if (distance < _minDistance || distance > _maxDistance) {
+      if (Features & statistics)
+        outputs.mStatistics->addOutOfRange(laserIdx);
+      return;
+    }
+    if (Features & statistics)
+      outputs.mStatistics->addValid(laserIdx, intensity, distance);
+    const bool kept = toScan && (!(Features & downsampling) ||
+      outputs.mDownsampler->keep(laserIdx, azimuth, distance));
+    const bool selected = (Features & intensityExtraction) &&
+      toIntensityScan &&
+      outputs.mIntensityExtractor->select(laserIdx, intensity, distance);
+    if (!kept && !selected && !((Features & cameras) && outputs.mCameraMask))
+      return;
+    const double sinRotAngle = sinRotation * correction.mCosRotCorrection -
+      cosRotation * correction.mSinRotCorrection;
+    const double cosRotAngle = cosRotation * correction.mCosRotCorrection +
+      sinRotation * correction.mSinRotCorrection;
+    const double xyDistance = distance * correction.mCosVertCorrection -
+      correction.mVertOffsetCorrection * correction.mSinVertCorrection;
+    const float x = xyDistance * cosRotAngle +
+      correction.mHorizOffsetCorrection * sinRotAngle;
+    const float y = -(xyDistance * sinRotAngle -
+      correction.mHorizOffsetCorrection * cosRotAngle);
+    const float z = distance * correction.mSinVertCorrection +
+      correction.mVertOffsetCorrection * correction.mCosVertCorrection;
+    uint32_t rgb = 0;
+    if (Features & cameras) {
+      // depth images are fed at full resolution, before downsampling
+      for (uint32_t cameraMask = outputs.mCameraMask, i = 0; cameraMask;
+          cameraMask >>= 1, ++i)
+        if (cameraMask & 1)
+          _depthProjectors[i]->insert(x, y, z);
+      // the first colorizer that sees the point wins
+      for (uint32_t colorizerMask = outputs.mColorizerMask, i = 0;
+          colorizerMask; colorizerMask >>= 1, ++i)
+        if ((colorizerMask & 1) && _colorizers[i]->colorize(x, y, z, rgb))
+          break;
+    }
+    outputs.mScan.set(outputs.mNumPoints, x, y, z, intensity, distance,
+      laserIdx, azimuth, time, rgb);
+    // high-intensity returns bypass the downsampler and both outputs are
+    // compacted without branching: the point is always written, the write
+    // indices only advance when it is selected
+    if (Features & intensityExtraction) {
+      outputs.mIntensityScan->set(outputs.mNumIntensityPoints, outputs.mScan,
+        outputs.mNumPoints);
+      outputs.mNumIntensityPoints += selected;
+    }
+    outputs.mNumPoints += kept;
+  }
+
+}
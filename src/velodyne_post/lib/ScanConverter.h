@@ -0,0 +1,355 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file ScanConverter.h
+    \brief This file defines the ScanConverter class which converts Velodyne
+           data packets into a scan buffer.
+  */
+
+#ifndef SCAN_CONVERTER_H
+#define SCAN_CONVERTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <libvelodyne/sensor/DataPacket.h>
+
+class Calibration;
+
+namespace velodyne {
+
+  struct ScanBuffer;
+  class RangeDownsampler;
+  class IntensityExtractor;
+  class DepthImageProjector;
+  class PointColorizer;
+  class LaserStatistics;
+
+  /** The class ScanConverter converts Velodyne data packets into a scan buffer.
+      The per-laser calibration is precomputed at construction and the
+      filtering stages are applied inside the conversion loop, such that
+      rejected returns are never materialized. The loop is instantiated for
+      every packet layout and combination of optional stages and the matching
+      instance is selected once per packet.
+      \brief Velodyne data packet converter
+    */
+  class ScanConverter {
+  public:
+    /** \name Types definitions
+      @{
+      */
+    /// Return mode of the device
+    enum class ReturnMode {
+      /// One return per laser and firing
+      single,
+      /// Pairs of blocks with the last return and the strongest return (or
+      /// the second strongest if the strongest is the last), not supported
+      /// by the HDL-64E whose consecutive blocks alternate between banks
+      dual
+    };
+    /// Packet layout of the device
+    enum class Layout {
+      /// HDL-64E and HDL-32E: one firing of 32 lasers per block, the bank
+      /// being given by the block header
+      hdl,
+      /// VLP-16: two firing sequences of 16 lasers per block
+      vlp16,
+      /// VLP-32C: one firing sequence of 32 lasers per block, fired by pairs
+      vlp32c
+    };
+    /// Returns selected for an output in dual-return mode
+    enum class ReturnSelection {
+      /// Strongest return only
+      strongest,
+      /// Last return only
+      last,
+      /// Both returns, reported once if they are identical
+      both
+    };
+    /// Precomputed laser correction
+    struct LaserCorrection {
+      /// Sine of the vertical correction
+      double mSinVertCorrection;
+      /// Cosine of the vertical correction
+      double mCosVertCorrection;
+      /// Sine of the rotational correction
+      double mSinRotCorrection;
+      /// Cosine of the rotational correction
+      double mCosRotCorrection;
+      /// Distance correction [m]
+      double mDistCorrection;
+      /// Vertical offset correction [m]
+      double mVertOffsetCorrection;
+      /// Horizontal offset correction [m]
+      double mHorizOffsetCorrection;
+    };
+    /** @}
+      */
+
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    ScanConverter(const Calibration& calibration, double minDistance,
+      double maxDistance);
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Sets the range-adaptive downsampler (null to disable)
+    void setDownsampler(const std::shared_ptr<RangeDownsampler>&
+      downsampler);
+    /// Returns the range-adaptive downsampler
+    const std::shared_ptr<RangeDownsampler>& getDownsampler() const {
+      return _downsampler;
+    }
+    /// Sets the high-intensity returns selector (null to disable)
+    void setIntensityExtractor(const std::shared_ptr<IntensityExtractor>&
+      intensityExtractor);
+    /// Returns the high-intensity returns selector
+    const std::shared_ptr<IntensityExtractor>& getIntensityExtractor() const {
+      return _intensityExtractor;
+    }
+    /// Sets the depth image projectors fed during conversion (up to 32)
+    void setDepthProjectors(const
+      std::vector<std::shared_ptr<DepthImageProjector> >& depthProjectors);
+    /// Returns the depth image projectors fed during conversion
+    const std::vector<std::shared_ptr<DepthImageProjector> >&
+        getDepthProjectors() const {
+      return _depthProjectors;
+    }
+    /// Sets the colorizers applied during conversion (up to 32)
+    void setColorizers(const std::vector<std::shared_ptr<PointColorizer> >&
+      colorizers);
+    /// Returns the colorizers applied during conversion
+    const std::vector<std::shared_ptr<PointColorizer> >& getColorizers()
+        const {
+      return _colorizers;
+    }
+    /// Sets the per-laser statistics fed during conversion (null to disable)
+    void setStatistics(const std::shared_ptr<LaserStatistics>& statistics);
+    /// Returns the per-laser statistics fed during conversion
+    const std::shared_ptr<LaserStatistics>& getStatistics() const {
+      return _statistics;
+    }
+    /// Sets the return mode of the device
+    void setReturnMode(ReturnMode returnMode);
+    /// Returns the return mode of the device
+    ReturnMode getReturnMode() const {
+      return _returnMode;
+    }
+    /// Sets the returns selected for the scan output
+    void setReturnSelection(ReturnSelection returnSelection);
+    /// Returns the returns selected for the scan output
+    ReturnSelection getReturnSelection() const {
+      return _returnSelection;
+    }
+    /// Sets the returns selected for the intensity output
+    void setIntensityReturnSelection(ReturnSelection returnSelection);
+    /// Returns the returns selected for the intensity output
+    ReturnSelection getIntensityReturnSelection() const {
+      return _intensityReturnSelection;
+    }
+    /// Sets the packet layout of the device
+    void setLayout(Layout layout);
+    /// Returns the packet layout of the device
+    Layout getLayout() const {
+      return _layout;
+    }
+    /// Returns the duration of a firing block, null if the returns of a
+    /// packet share its time [s]
+    double getBlockDuration() const {
+      return _blockDuration;
+    }
+    /// Returns the number of lasers
+    size_t getNumLasers() const;
+    /// Returns the fraction of a firing step after which a laser fires, null
+    /// if the lasers of a block fire together
+    double getFiringFraction(size_t laserIdx) const {
+      return _blockDuration > 0.0f ? _firingTimes[laserIdx] /
+        mVlpSequenceDuration : 0.0;
+    }
+    /// Returns the max azimuth deviation of a return from its block [rad]
+    double getAzimuthMargin() const;
+    /// Returns the correction of a given laser
+    const LaserCorrection& getCorrection(size_t laserIdx) const {
+      return _corrections[laserIdx];
+    }
+    /// Returns the laser index of a return of a block
+    size_t getLaserIndex(uint16_t headerInfo, size_t returnIdx) const {
+      if (_layout == Layout::vlp16)
+        return returnIdx % 16;
+      return _layout == Layout::hdl && headerInfo == mLowerBank ?
+        DataPacket::DataChunk::mLasersPerPacket + returnIdx : returnIdx;
+    }
+    /// Returns the raw azimuth of a return of a block, given the azimuth
+    /// step to the next firing block [0.01 deg]
+    uint16_t getReturnAzimuth(uint16_t rotationalInfo, uint16_t azimuthStep,
+        size_t returnIdx) const {
+      return (rotationalInfo + ((azimuthStep * _azimuthFractions[returnIdx] +
+        32768) >> 16)) % 36000;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Converts a data packet and appends the points to the scan, and the
+    /// high-intensity returns to the optional intensity scan, point times
+    /// are relative to the start time of the scan
+    void convert(const DataPacket& dataPacket, ScanBuffer& scan,
+      ScanBuffer* intensityScan = 0) const;
+    /// Converts a block of raw returns at full resolution, i.e., without
+    /// downsampling, and appends the points to the scan, the timestamp is
+    /// the firing time of the block and the azimuth step to the next firing
+    /// block interpolates the azimuth of the returns on VLP layouts, in
+    /// dual-return mode the returns of the other block of the pair select
+    /// the returns as in the packet conversion
+    void convertBlock(int64_t timestamp, uint16_t headerInfo,
+      uint16_t rotationalInfo, uint16_t azimuthStep,
+      const uint16_t* distances, const uint8_t* intensities,
+      ScanBuffer& scan, const uint16_t* otherDistances = 0,
+      const uint8_t* otherIntensities = 0) const;
+    /// Returns the raw azimuth step between two firing blocks
+    static uint16_t getAzimuthStep(uint16_t rotationalInfo, uint16_t
+        nextRotationalInfo) {
+      return (nextRotationalInfo + 36000 - rotationalInfo) % 36000;
+    }
+    /** @}
+      */
+
+    /** \name Public members
+      @{
+      */
+    /// Distance resolution [m]
+    static constexpr double mDistanceResolution = 0.002;
+    /// Rotational resolution [rad]
+    static constexpr double mRotationResolution = M_PI / 18000.0;
+    /// Header info of the upper block
+    static const uint16_t mUpperBank = 0xeeff;
+    /// Header info of the lower block
+    static const uint16_t mLowerBank = 0xddff;
+    /// Firing period of a laser on VLP devices [s]
+    static constexpr double mVlpFiringPeriod = 2.304e-6;
+    /// Duration of a firing sequence on VLP devices [s]
+    static constexpr double mVlpSequenceDuration = 55.296e-6;
+    /** @}
+      */
+
+  protected:
+    /** \name Protected types
+      @{
+      */
+    /// State of the outputs during the conversion of a packet
+    struct Outputs;
+    /// Optional features of the conversion kernel, a feature missing from
+    /// a kernel instance generates no instruction in its loop
+    enum Feature {
+      /// Range-adaptive downsampling
+      downsampling = 1,
+      /// High-intensity returns extraction
+      intensityExtraction = 2,
+      /// Per-laser statistics
+      statistics = 4,
+      /// Depth image projection and colorization
+      cameras = 8,
+      /// Number of feature combinations
+      numFeatureSets = 16
+    };
+    /// Conversion kernel of a packet
+    typedef void (ScanConverter::*PacketKernel)(const DataPacket&, Outputs&)
+      const;
+    /** @}
+      */
+
+    /** \name Protected methods
+      @{
+      */
+    /// Returns the mask of the depth projectors that may see a block
+    uint32_t getCameraMask(uint16_t rotationalInfo) const;
+    /// Returns the mask of the colorizers with an image that may see a block
+    uint32_t getColorizerMask(uint16_t rotationalInfo) const;
+    /// Returns the conversion kernels of a layout indexed by feature set
+    template <Layout L>
+    static const PacketKernel* getKernels();
+    /// Converts the blocks of a packet with a given layout and set of
+    /// features
+    template <Layout L, unsigned int Features>
+    void convertPacket(const DataPacket& dataPacket, Outputs& outputs) const;
+    /// Converts a firing block, the other block holding the second returns
+    /// in dual-return mode
+    template <Layout L, unsigned int Features>
+    void convertChunk(const DataPacket::DataChunk& dataChunk,
+      const DataPacket::DataChunk* otherChunk, uint16_t azimuthStep,
+      float time, Outputs& outputs) const;
+    /// Converts a return and writes it to the outputs it is selected for
+    template <unsigned int Features>
+    void convertReturn(uint16_t rawDistance, uint8_t intensity, size_t
+      laserIdx, uint16_t azimuth, double sinRotation, double cosRotation,
+      float time, bool toScan, bool toIntensityScan, Outputs& outputs) const;
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Per-laser corrections
+    std::vector<LaserCorrection> _corrections;
+    /// Min distance for conversions
+    double _minDistance;
+    /// Max distance for conversions
+    double _maxDistance;
+    /// Range-adaptive downsampler
+    std::shared_ptr<RangeDownsampler> _downsampler;
+    /// High-intensity returns selector
+    std::shared_ptr<IntensityExtractor> _intensityExtractor;
+    /// Depth image projectors
+    std::vector<std::shared_ptr<DepthImageProjector> > _depthProjectors;
+    /// Colorizers
+    std::vector<std::shared_ptr<PointColorizer> > _colorizers;
+    /// Per-laser statistics
+    std::shared_ptr<LaserStatistics> _statistics;
+    /// Return mode of the device
+    ReturnMode _returnMode;
+    /// Returns selected for the scan output
+    ReturnSelection _returnSelection;
+    /// Returns selected for the intensity output
+    ReturnSelection _intensityReturnSelection;
+    /// Packet layout of the device
+    Layout _layout;
+    /// Fraction of the azimuth step to the next block at each return of a
+    /// block [2^-16]
+    uint32_t _azimuthFractions[32];
+    /// Firing time of each return of a block relative to the block [s]
+    float _firingTimes[32];
+    /// Duration of a firing block [s]
+    float _blockDuration;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // SCAN_CONVERTER_H
@@ -0,0 +1,186 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+#include "ScanExporter.h"
+
+#include <stdexcept>
+#include <vector>
+
+#ifdef VELODYNE_POST_WITH_ARROW
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/ipc/writer.h>
+#include <parquet/arrow/writer.h>
+#endif
+
+#include "ScanBuffer.h"
+
+namespace velodyne {
+
+#ifdef VELODYNE_POST_WITH_ARROW
+  struct ScanExporter::Implementation {
+    /// Schema of the batches
+    std::shared_ptr<arrow::Schema> mSchema;
+    /// Output file
+    std::shared_ptr<arrow::io::FileOutputStream> mFile;
+    /// Arrow IPC writer
+    std::shared_ptr<arrow::ipc::RecordBatchWriter> mArrowWriter;
+    /// Parquet writer
+    std::unique_ptr<parquet::arrow::FileWriter> mParquetWriter;
+    /// Scan id column, constant within a batch
+    std::vector<uint32_t> mScanIds;
+    /// Scan start time column, constant within a batch
+    std::vector<int64_t> mStartTimes;
+  };
+
+  namespace {
+
+    void check(const arrow::Status& status) {
+      if (!status.ok())
+        throw std::runtime_error("ScanExporter: " + status.ToString());
+    }
+
+    template <typename T>
+    T check(arrow::Result<T> result) {
+      check(result.status());
+      return std::move(result).ValueOrDie();
+    }
+
+    /// Wraps a column without copy, the column must outlive the array
+    template <typename T>
+    std::shared_ptr<arrow::Array> wrap(const std::shared_ptr<arrow::DataType>&
+        type, const std::vector<T>& column, size_t size) {
+      return arrow::MakeArray(arrow::ArrayData::Make(type, size,
+        {nullptr, std::make_shared<arrow::Buffer>(
+        reinterpret_cast<const uint8_t*>(column.data()),
+        size * sizeof(T))}));
+    }
+
+  }
+#else
+  struct ScanExporter::Implementation {
+  };
+#endif
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  ScanExporter::ScanExporter(const std::string& fileName, Format format) :
+      _numScans(0) {
+#ifdef VELODYNE_POST_WITH_ARROW
+    _implementation.reset(new Implementation());
+    _implementation->mSchema = arrow::schema({
+      arrow::field("x", arrow::float32(), false),
+      arrow::field("y", arrow::float32(), false),
+      arrow::field("z", arrow::float32(), false),
+      arrow::field("intensity", arrow::float32(), false),
+      arrow::field("ring", arrow::uint16(), false),
+      arrow::field("time", arrow::float32(), false),
+      arrow::field("scan_id", arrow::uint32(), false),
+      arrow::field("scan_start_time", arrow::int64(), false)});
+    _implementation->mFile =
+      check(arrow::io::FileOutputStream::Open(fileName));
+    if (format == Format::arrow)
+      _implementation->mArrowWriter = check(arrow::ipc::MakeFileWriter(
+        _implementation->mFile, _implementation->mSchema));
+    else
+      _implementation->mParquetWriter = check(
+        parquet::arrow::FileWriter::Open(*_implementation->mSchema,
+        arrow::default_memory_pool(), _implementation->mFile));
+#else
+    (void)format;
+    throw std::runtime_error("ScanExporter: cannot export " + fileName +
+      ", built without Arrow support");
+#endif
+  }
+
+  ScanExporter::~ScanExporter() {
+    try {
+      close();
+    }
+    catch (...) {
+    }
+  }
+
+/******************************************************************************/
+/* Accessors                                                                  */
+/******************************************************************************/
+
+  bool ScanExporter::isAvailable() {
+#ifdef VELODYNE_POST_WITH_ARROW
+    return true;
+#else
+    return false;
+#endif
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  void ScanExporter::write(const ScanBuffer& scan) {
+    const size_t scanId = _numScans++;
+#ifdef VELODYNE_POST_WITH_ARROW
+    if (!_implementation->mFile)
+      throw std::runtime_error("ScanExporter: write after close");
+    const size_t numPoints = scan.size();
+    if (!numPoints)
+      return;
+    Implementation& impl = *_implementation;
+    impl.mScanIds.assign(numPoints, scanId);
+    impl.mStartTimes.assign(numPoints, scan.mStartTime);
+    const std::shared_ptr<arrow::RecordBatch> batch =
+      arrow::RecordBatch::Make(impl.mSchema, numPoints, {
+      wrap(arrow::float32(), scan.mX, numPoints),
+      wrap(arrow::float32(), scan.mY, numPoints),
+      wrap(arrow::float32(), scan.mZ, numPoints),
+      wrap(arrow::float32(), scan.mIntensity, numPoints),
+      wrap(arrow::uint16(), scan.mRing, numPoints),
+      wrap(arrow::float32(), scan.mTime, numPoints),
+      wrap(arrow::uint32(), impl.mScanIds, numPoints),
+      wrap(arrow::int64(), impl.mStartTimes, numPoints)});
+    if (impl.mArrowWriter)
+      check(impl.mArrowWriter->WriteRecordBatch(*batch));
+    else {
+      // one row group per scan
+      const std::shared_ptr<arrow::Table> table =
+        check(arrow::Table::FromRecordBatches({batch}));
+      check(impl.mParquetWriter->WriteTable(*table, numPoints));
+    }
+#else
+    (void)scan;
+    (void)scanId;
+#endif
+  }
+
+  void ScanExporter::close() {
+#ifdef VELODYNE_POST_WITH_ARROW
+    if (!_implementation || !_implementation->mFile)
+      return;
+    if (_implementation->mArrowWriter)
+      check(_implementation->mArrowWriter->Close());
+    else
+      check(_implementation->mParquetWriter->Close());
+    check(_implementation->mFile->Close());
+    _implementation->mFile.reset();
+#endif
+  }
+
+}
@@ -0,0 +1,121 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+/** \file ScanExporter.h
+    \brief This file defines the ScanExporter class which exports scans to
+           Apache Arrow or Parquet files.
+  */
+
+#ifndef SCAN_EXPORTER_H
+#define SCAN_EXPORTER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace velodyne {
+
+  struct ScanBuffer;
+
+  /** The class ScanExporter writes scans as record batches of an Arrow IPC
+      file or as row groups of a Parquet file, one per scan. The columns are
+      x, y, z, intensity [float32], ring [uint16], time since the start of the
+      scan [float32, s], scan id [uint32] and scan start time [int64, ns]. The
+      point columns are handed over to Arrow without copy. The export is only
+      available if the package was built with Arrow and Parquet, i.e., with
+      VELODYNE_POST_WITH_ARROW defined, the constructor throws otherwise.
+      Since the Arrow headers require C++17, only the implementation file is
+      built with C++17 and the interface keeps the Arrow types hidden.
+      \brief Arrow and Parquet scan exporter
+    */
+  class ScanExporter {
+  public:
+    /** \name Types definitions
+      @{
+      */
+    /// File format
+    enum class Format {
+      /// Arrow IPC file
+      arrow,
+      /// Parquet file
+      parquet
+    };
+    /** @}
+      */
+
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    ScanExporter(const std::string& fileName, Format format);
+    /// Copy constructor
+    ScanExporter(const ScanExporter& other) = delete;
+    /// Copy assignment operator
+    ScanExporter& operator = (const ScanExporter& other) = delete;
+    /// Destructor, closes the file
+    ~ScanExporter();
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns true if the package was built with Arrow and Parquet
+    static bool isAvailable();
+    /// Returns the number of scans written so far, i.e., the next scan id
+    size_t getNumScans() const {
+      return _numScans;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Writes a scan, empty scans only consume a scan id
+    void write(const ScanBuffer& scan);
+    /// Writes the footer and closes the file
+    void close();
+    /** @}
+      */
+
+  protected:
+    /** \name Protected types
+      @{
+      */
+    /// Arrow writer state
+    struct Implementation;
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Arrow writer state
+    std::unique_ptr<Implementation> _implementation;
+    /// Number of scans written so far
+    size_t _numScans;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // SCAN_EXPORTER_H
@@ -0,0 +1,106 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+#include "ScanGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "ScanBuffer.h"
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Statics                                                                    */
+/******************************************************************************/
+
+  const uint32_t ScanGrid::mNone;
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  ScanGrid::ScanGrid(const std::vector<double>& elevations, const
+      std::vector<double>& firingFractions) :
+      _rows(elevations.size()),
+      _rowElevations(elevations.size()),
+      _firingFractions(firingFractions),
+      _numRows(elevations.size()) {
+    _firingFractions.resize(_numRows, 0.0);
+    std::vector<size_t> lasers(elevations.size());
+    std::iota(lasers.begin(), lasers.end(), 0);
+    std::stable_sort(lasers.begin(), lasers.end(), [&](size_t a, size_t b) {
+      return elevations[a] < elevations[b];});
+    for (size_t i = 0; i < lasers.size(); ++i) {
+      _rows[lasers[i]] = i;
+      _rowElevations[i] = elevations[lasers[i]];
+    }
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  void ScanGrid::fill(const ScanBuffer& scan) {
+    _cells.clear();
+    _columnAzimuths.clear();
+    const size_t numPoints = scan.size();
+    // the firing step is the smallest advance of a laser, the second return
+    // of a dual-return firing does not advance it
+    const uint16_t noAzimuth = 0xffff;
+    int firingStep = 36000;
+    _rowAzimuths.assign(_numRows, noAzimuth);
+    for (size_t i = 0; i < numPoints; ++i) {
+      if (scan.mRing[i] >= _numRows)
+        continue;
+      uint16_t& last = _rowAzimuths[_rows[scan.mRing[i]]];
+      if (last != noAzimuth) {
+        const int advance = (scan.mAzimuth[i] + 36000 - last) % 36000;
+        if (advance > 0)
+          firingStep = std::min(firingStep, advance);
+      }
+      last = scan.mAzimuth[i];
+    }
+    for (size_t i = 0; i < numPoints; ++i) {
+      if (scan.mRing[i] >= _numRows)
+        continue;
+      const size_t row = _rows[scan.mRing[i]];
+      const uint16_t azimuth = (scan.mAzimuth[i] + 36000 - std::lround(
+        _firingFractions[scan.mRing[i]] * firingStep) % 36000) % 36000;
+      // signed, the rounding may put a return slightly behind its firing
+      const int advance = _columnAzimuths.empty() ? firingStep :
+        (azimuth + 54000 - _columnAzimuths.back()) % 36000 - 18000;
+      if (2 * advance <= firingStep) {
+        uint32_t& cell = _cells[_cells.size() - _numRows + row];
+        if (cell == mNone) {
+          cell = i;
+          continue;
+        }
+        // the second return of a dual-return firing keeps the first one
+        if (scan.mAzimuth[cell] == scan.mAzimuth[i])
+          continue;
+      }
+      _cells.insert(_cells.end(), _numRows, mNone);
+      _cells[_cells.size() - _numRows + row] = i;
+      _columnAzimuths.push_back(azimuth);
+    }
+  }
+
+}
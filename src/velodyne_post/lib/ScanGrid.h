@@ -0,0 +1,128 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+/** \file ScanGrid.h
+    \brief This file defines the ScanGrid class which lays out a scan on its
+           ring by azimuth grid.
+  */
+
+#ifndef SCAN_GRID_H
+#define SCAN_GRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace velodyne {
+
+  struct ScanBuffer;
+
+  /** The class ScanGrid lays out the returns of a scan on a grid whose rows
+      are the lasers sorted by elevation and whose columns are the firings.
+      A return belongs to the firing at its azimuth less the fraction of a
+      firing step after which its laser fires, the firing step being the
+      smallest advance of a laser between two of its returns. A return more
+      than half a firing step ahead of the last column opens the next one,
+      such that returns removed by the filters leave empty cells.
+      \brief Organized scan grid
+    */
+  class ScanGrid {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor with the elevation of each laser and the fraction of a
+    /// firing step after which it fires, none if the lasers fire together
+    ScanGrid(const std::vector<double>& elevations, const
+      std::vector<double>& firingFractions = std::vector<double>());
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the number of rows
+    size_t getNumRows() const {
+      return _numRows;
+    }
+    /// Returns the number of columns
+    size_t getNumColumns() const {
+      return _columnAzimuths.size();
+    }
+    /// Returns the row of a laser
+    size_t getRow(size_t laserIdx) const {
+      return _rows[laserIdx];
+    }
+    /// Returns the elevation of each row, increasing
+    const std::vector<double>& getRowElevations() const {
+      return _rowElevations;
+    }
+    /// Returns the scan indices of the cells of a column, mNone if empty
+    const uint32_t* getColumn(size_t column) const {
+      return &_cells[column * _numRows];
+    }
+    /// Returns the raw azimuth of the firing of a column [0.01 deg]
+    uint16_t getAzimuth(size_t column) const {
+      return _columnAzimuths[column];
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Lays out the returns of a scan
+    void fill(const ScanBuffer& scan);
+    /** @}
+      */
+
+    /** \name Public members
+      @{
+      */
+    /// Scan index of an empty cell
+    static const uint32_t mNone = 0xffffffff;
+    /** @}
+      */
+
+  protected:
+    /** \name Protected members
+      @{
+      */
+    /// Row of each laser
+    std::vector<size_t> _rows;
+    /// Elevation of each row
+    std::vector<double> _rowElevations;
+    /// Fraction of a firing step after which each laser fires
+    std::vector<double> _firingFractions;
+    /// Number of rows
+    size_t _numRows;
+    /// Raw azimuth of the last return of each row, reused across scans
+    std::vector<uint16_t> _rowAzimuths;
+    /// Scan indices of the cells, column-major
+    std::vector<uint32_t> _cells;
+    /// Raw azimuth of the firing of each column [0.01 deg]
+    std::vector<uint16_t> _columnAzimuths;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // SCAN_GRID_H
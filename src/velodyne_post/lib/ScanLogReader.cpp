@@ -0,0 +1,104 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "ScanLogReader.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "ScanCodec.h"
+#include "ScanLogWriter.h"
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  ScanLogReader::ScanLogReader(const std::string& fileName) :
+      _file(fileName, std::ios::binary) {
+    if (!_file)
+      throw std::runtime_error("ScanLogReader: cannot open " + fileName);
+    char magic[sizeof(ScanLogWriter::mMagic)];
+    _file.read(magic, sizeof(magic));
+    if (!_file || std::memcmp(magic, ScanLogWriter::mMagic, sizeof(magic)))
+      throw std::runtime_error("ScanLogReader: bad magic number in " +
+        fileName);
+  }
+
+/******************************************************************************/
+/* Accessors                                                                  */
+/******************************************************************************/
+
+  uint64_t ScanLogReader::getOffset() {
+    return _file.tellg();
+  }
+
+  void ScanLogReader::setOffset(uint64_t offset) {
+    _file.clear();
+    _file.seekg(offset);
+    if (!_file)
+      throw std::runtime_error("ScanLogReader: bad offset");
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  bool ScanLogReader::readSize(uint32_t& size) {
+    unsigned char header[4];
+    _file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (_file.gcount() == 0 && _file.eof())
+      return false;
+    if (!_file)
+      throw std::runtime_error("ScanLogReader: truncated record");
+    size = header[0] | (header[1] << 8) | (header[2] << 16) |
+      (static_cast<uint32_t>(header[3]) << 24);
+    return true;
+  }
+
+  bool ScanLogReader::skip() {
+    uint32_t size;
+    if (!readSize(size))
+      return false;
+    _file.seekg(size, std::ios::cur);
+    if (!_file)
+      throw std::runtime_error("ScanLogReader: truncated record");
+    return true;
+  }
+
+  bool ScanLogReader::readEncoded(std::string& data) {
+    uint32_t size;
+    if (!readSize(size))
+      return false;
+    data.resize(size);
+    _file.read(&data[0], size);
+    if (!_file)
+      throw std::runtime_error("ScanLogReader: truncated record");
+    return true;
+  }
+
+  bool ScanLogReader::read(std::vector<DataPacket>& dataPackets) {
+    if (!readEncoded(_buffer))
+      return false;
+    ScanCodec::decode(_buffer, dataPackets);
+    return true;
+  }
+
+}
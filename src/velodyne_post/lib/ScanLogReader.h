@@ -0,0 +1,100 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file ScanLogReader.h
+    \brief This file defines the ScanLogReader class which reads compressed
+           Velodyne scans from a log file.
+  */
+
+#ifndef SCAN_LOG_READER_H
+#define SCAN_LOG_READER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class DataPacket;
+
+namespace velodyne {
+
+  /** The class ScanLogReader reads Velodyne scans from a log file written by
+      ScanLogWriter.
+      \brief Velodyne scan log reader
+    */
+  class ScanLogReader {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    ScanLogReader(const std::string& fileName);
+    /// Copy constructor
+    ScanLogReader(const ScanLogReader& other) = delete;
+    /// Copy assignment operator
+    ScanLogReader& operator = (const ScanLogReader& other) = delete;
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the offset of the next record in the log [B]
+    uint64_t getOffset();
+    /// Moves to the record starting at an offset in the log [B]
+    void setOffset(uint64_t offset);
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Skips the next scan without reading it, returns false at the end of
+    /// the log
+    bool skip();
+    /// Reads the next encoded scan, returns false at the end of the log
+    bool readEncoded(std::string& data);
+    /// Reads and decodes the next scan, returns false at the end of the log
+    bool read(std::vector<DataPacket>& dataPackets);
+    /** @}
+      */
+
+  protected:
+    /** \name Protected methods
+      @{
+      */
+    /// Reads the size of the next record, returns false at the end of the log
+    bool readSize(uint32_t& size);
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Log file
+    std::ifstream _file;
+    /// Buffer for the encoded scan
+    std::string _buffer;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // SCAN_LOG_READER_H
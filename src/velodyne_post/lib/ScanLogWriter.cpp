@@ -0,0 +1,106 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "ScanLogWriter.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "ScanCodec.h"
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Statics                                                                    */
+/******************************************************************************/
+
+  const char ScanLogWriter::mMagic[8] = {'V', 'P', 'L', 'O', 'G', 0, 0, 1};
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  ScanLogWriter::ScanLogWriter(const std::string& fileName) :
+      _numBytes(getValidSize(fileName)) {
+    // a record cut by a crash is dropped, the new records follow the
+    // last complete one
+    if (_numBytes > 0 && ::truncate(fileName.c_str(), _numBytes))
+      throw std::runtime_error("ScanLogWriter: cannot truncate " + fileName);
+    _file.open(fileName, std::ios::binary | std::ios::app);
+    if (!_file)
+      throw std::runtime_error("ScanLogWriter: cannot open " + fileName);
+    if (_numBytes == 0) {
+      _file.write(mMagic, sizeof(mMagic));
+      if (!_file)
+        throw std::runtime_error("ScanLogWriter: write failed");
+      _numBytes += sizeof(mMagic);
+    }
+  }
+
+/******************************************************************************/
+/* Accessors                                                                  */
+/******************************************************************************/
+
+  uint64_t ScanLogWriter::getValidSize(const std::string& fileName) {
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file)
+      return 0;
+    const uint64_t fileSize = file.tellg();
+    if (fileSize == 0)
+      return 0;
+    char magic[sizeof(mMagic)];
+    file.seekg(0);
+    file.read(magic, sizeof(magic));
+    if (!file || std::memcmp(magic, mMagic, sizeof(magic)))
+      throw std::runtime_error("ScanLogWriter: " + fileName +
+        " exists and is not a scan log");
+    uint64_t size = sizeof(mMagic);
+    unsigned char header[4];
+    while (file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+      const uint64_t recordSize = sizeof(header) + (header[0] |
+        (header[1] << 8) | (header[2] << 16) |
+        (static_cast<uint32_t>(header[3]) << 24));
+      if (size + recordSize > fileSize)
+        break;
+      size += recordSize;
+      file.seekg(size);
+    }
+    return size;
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  void ScanLogWriter::write(const std::vector<DataPacket>& dataPackets) {
+    ScanCodec::encode(dataPackets, _buffer);
+    const uint32_t size = _buffer.size();
+    const char header[] = {static_cast<char>(size),
+      static_cast<char>(size >> 8), static_cast<char>(size >> 16),
+      static_cast<char>(size >> 24)};
+    _file.write(header, sizeof(header));
+    _file.write(_buffer.data(), _buffer.size());
+    if (!_file)
+      throw std::runtime_error("ScanLogWriter: write failed");
+    _numBytes += sizeof(header) + _buffer.size();
+  }
+
+}
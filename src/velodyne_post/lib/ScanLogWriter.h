@@ -0,0 +1,110 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file ScanLogWriter.h
+    \brief This file defines the ScanLogWriter class which writes compressed
+           Velodyne scans to a log file.
+  */
+
+#ifndef SCAN_LOG_WRITER_H
+#define SCAN_LOG_WRITER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class DataPacket;
+
+namespace velodyne {
+
+  /** The class ScanLogWriter writes Velodyne scans to a log file. The file
+      starts with a magic number and is followed by one record per scan, each
+      record holding the size of the encoded scan as a 32-bit little-endian
+      integer and the scan encoded by ScanCodec. An existing log is never
+      truncated: the scans are appended after its last complete record, so
+      that a restarted node continues the log of the previous run.
+      \brief Velodyne scan log writer
+    */
+  class ScanLogWriter {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    ScanLogWriter(const std::string& fileName);
+    /// Copy constructor
+    ScanLogWriter(const ScanLogWriter& other) = delete;
+    /// Copy assignment operator
+    ScanLogWriter& operator = (const ScanLogWriter& other) = delete;
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the number of bytes in the log
+    size_t getNumBytes() const {
+      return _numBytes;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Writes the data packets of a scan
+    void write(const std::vector<DataPacket>& dataPackets);
+    /** @}
+      */
+
+    /** \name Public members
+      @{
+      */
+    /// Magic number of a log file
+    static const char mMagic[8];
+    /** @}
+      */
+
+  protected:
+    /** \name Protected methods
+      @{
+      */
+    /// Returns the size of an existing log up to its last complete record,
+    /// or 0 if the file does not exist or is empty
+    static uint64_t getValidSize(const std::string& fileName);
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Log file
+    std::ofstream _file;
+    /// Buffer for the encoded scan
+    std::string _buffer;
+    /// Number of bytes in the log
+    size_t _numBytes;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // SCAN_LOG_WRITER_H
@@ -0,0 +1,77 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file ScanStage.h
+    \brief This file defines the ScanStage class which is the interface of
+           the in-place processing stages loaded as plugins.
+  */
+
+#ifndef SCAN_STAGE_H
+#define SCAN_STAGE_H
+
+#include <ros/ros.h>
+
+namespace velodyne {
+
+  struct ScanBuffer;
+  class ScanConverter;
+
+  /** The class ScanStage is the interface of the processing stages loaded
+      through pluginlib. Stages run in the post node on its scan buffer, in
+      the order of their configuration, before the point cloud is
+      serialized. A stage removing points compacts the buffer in place with
+      ScanBuffer::set() and ScanBuffer::resize(), such that the firing order
+      is preserved.
+      \brief In-place scan processing stage
+    */
+  class ScanStage {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Destructor
+    virtual ~ScanStage();
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Initializes the stage with its parameter namespace and the converter
+    /// providing the per-laser calibration
+    virtual void initialize(const ros::NodeHandle& nodeHandle,
+      const ScanConverter& converter) = 0;
+    /// Processes a scan in place
+    virtual void process(ScanBuffer& scan) = 0;
+    /** @}
+      */
+
+  protected:
+    /** \name Protected constructors
+      @{
+      */
+    /// Default constructor, required by pluginlib
+    ScanStage();
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // SCAN_STAGE_H
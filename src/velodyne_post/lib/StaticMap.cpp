@@ -0,0 +1,337 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+#include "StaticMap.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ScanBuffer.h"
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Statics                                                                    */
+/******************************************************************************/
+
+  const char StaticMap::mMagic[8] = {'V', 'P', 'M', 'A', 'P', 0, 0, 2};
+  const size_t StaticMap::mMaxTileBits;
+  const uint64_t StaticMap::mMinAlignment;
+  const uint64_t StaticMap::mLineSize;
+  const uint32_t StaticMap::mEmpty;
+  const uint64_t StaticMap::mNoTile;
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  StaticMap::StaticMap(const std::string& fileName, size_t maxIdleScans) :
+      _data(0),
+      _size(0),
+      _lastTileKey(mNoTile),
+      _lastTile(0),
+      _maxIdleScans(maxIdleScans),
+      _numScans(0),
+      _totalNumLoads(0),
+      _numChecked(0),
+      _numRemoved(0),
+      _totalNumChecked(0),
+      _totalNumRemoved(0) {
+    const int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("StaticMap: cannot open " + fileName + ": " +
+        std::strerror(errno));
+    struct stat status;
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+      _size = status.st_size;
+      void* data = mmap(0, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED)
+        _data = static_cast<const char*>(data);
+    }
+    const int error = errno;
+    close(fd);
+    if (!_data)
+      throw std::runtime_error("StaticMap: cannot map " + fileName + ": " +
+        std::strerror(error));
+    // the tiles are paged in on demand only
+    madvise(const_cast<char*>(_data), _size, MADV_RANDOM);
+    try {
+      Header header;
+      if (_size < sizeof(header))
+        throw std::runtime_error("StaticMap: truncated header in " +
+          fileName);
+      std::memcpy(&header, _data, sizeof(header));
+      if (std::memcmp(header.mMagic, mMagic, sizeof(mMagic)))
+        throw std::runtime_error("StaticMap: bad magic number in " +
+          fileName);
+      if (!(header.mVoxelSize > 0.0f) || header.mTileBits == 0 ||
+          header.mTileBits > mMaxTileBits ||
+          header.mNumTiles > (_size - sizeof(header)) / sizeof(TileEntry) ||
+          header.mAlignment < mMinAlignment ||
+          (header.mAlignment & (header.mAlignment - 1)))
+        throw std::runtime_error("StaticMap: bad header in " + fileName);
+      // the tables are released page-wise, without touching their neighbours
+      if (header.mAlignment % sysconf(_SC_PAGESIZE))
+        throw std::runtime_error("StaticMap: alignment of " + fileName +
+          " below the page size");
+      _voxelSize = header.mVoxelSize;
+      _tileBits = header.mTileBits;
+      _alignment = header.mAlignment;
+      _tiles.reserve(header.mNumTiles);
+      for (size_t i = 0; i < header.mNumTiles; ++i) {
+        TileEntry entry;
+        std::memcpy(&entry, _data + sizeof(header) + i * sizeof(entry),
+          sizeof(entry));
+        if (entry.mNumSlots == 0 ||
+            (entry.mNumSlots & (entry.mNumSlots - 1)) ||
+            entry.mOffset % (entry.mNumSlots * sizeof(uint32_t) >= _alignment ?
+            _alignment : sizeof(uint32_t)) || entry.mOffset > _size ||
+            entry.mNumSlots > (_size - entry.mOffset) / sizeof(uint32_t))
+          throw std::runtime_error("StaticMap: bad tile in " + fileName);
+        Tile& tile = _tiles[getTileKey(entry.mCoordinates[0],
+          entry.mCoordinates[1], entry.mCoordinates[2])];
+        tile.mSlots = reinterpret_cast<const uint32_t*>(_data +
+          entry.mOffset);
+        tile.mMask = entry.mNumSlots - 1;
+        tile.mLastHit = 0;
+        tile.mLoaded = false;
+      }
+    }
+    catch (...) {
+      munmap(const_cast<char*>(_data), _size);
+      throw;
+    }
+  }
+
+  StaticMap::~StaticMap() {
+    munmap(const_cast<char*>(_data), _size);
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  void StaticMap::load(Tile& tile) {
+    // reads the whole hash table at once rather than by random page faults,
+    // with the packed neighbours of a small one
+    const size_t begin = (reinterpret_cast<const char*>(tile.mSlots) - _data)
+      / _alignment * _alignment;
+    const size_t end = reinterpret_cast<const char*>(tile.mSlots + tile.mMask
+      + 1) - _data;
+    madvise(const_cast<char*>(_data) + begin, end - begin, MADV_WILLNEED);
+    tile.mLoaded = true;
+    _loadedTiles.push_back(&tile);
+    ++_totalNumLoads;
+  }
+
+  void StaticMap::releaseIdleTiles() {
+    size_t numLoaded = 0;
+    for (size_t i = 0; i < _loadedTiles.size(); ++i) {
+      Tile& tile = *_loadedTiles[i];
+      if (_numScans - tile.mLastHit <= _maxIdleScans) {
+        _loadedTiles[numLoaded++] = &tile;
+        continue;
+      }
+      // the pages are read again from the file if the tile is hit later,
+      // only the aligned blocks of the table are released such that no other
+      // tile is, the small tables are left to the page cache
+      const size_t offset = reinterpret_cast<const char*>(tile.mSlots) -
+        _data;
+      const size_t begin = (offset + _alignment - 1) / _alignment *
+        _alignment;
+      const size_t end = (offset + (tile.mMask + 1) * sizeof(uint32_t)) /
+        _alignment * _alignment;
+      if (begin < end)
+        madvise(const_cast<char*>(_data) + begin, end - begin,
+          MADV_DONTNEED);
+      tile.mLoaded = false;
+    }
+    _loadedTiles.resize(numLoaded);
+  }
+
+  bool StaticMap::isOccupied(int64_t x, int64_t y, int64_t z) {
+    const uint64_t tileKey = getTileKey(x >> _tileBits, y >> _tileBits,
+      z >> _tileBits);
+    if (tileKey != _lastTileKey) {
+      auto it = _tiles.find(tileKey);
+      _lastTileKey = tileKey;
+      _lastTile = it != _tiles.end() ? &it->second : 0;
+      if (_lastTile) {
+        if (!_lastTile->mLoaded)
+          load(*_lastTile);
+        _lastTile->mLastHit = _numScans;
+      }
+    }
+    if (!_lastTile)
+      return false;
+    const int64_t localMask = (int64_t(1) << _tileBits) - 1;
+    const uint32_t key = ((x & localMask) << (2 * _tileBits)) |
+      ((y & localMask) << _tileBits) | (z & localMask);
+    // a corrupt table without empty slot is probed at most once
+    uint32_t slot = hash(key) & _lastTile->mMask;
+    for (uint64_t probe = 0; probe <= _lastTile->mMask; ++probe) {
+      const uint32_t value = _lastTile->mSlots[slot];
+      if (value == key)
+        return true;
+      if (value == mEmpty)
+        return false;
+      slot = (slot + 1) & _lastTile->mMask;
+    }
+    return false;
+  }
+
+  bool StaticMap::isOccupied(double x, double y, double z) {
+    _lastTileKey = mNoTile;
+    return isOccupied(int64_t(std::floor(x / _voxelSize)),
+      int64_t(std::floor(y / _voxelSize)), int64_t(std::floor(z / _voxelSize)));
+  }
+
+  void StaticMap::filter(ScanBuffer& scan, const Pose& pose) {
+    ++_numScans;
+    // the last tile is looked up again in each scan to record its hit
+    _lastTileKey = mNoTile;
+    const double scale = 1.0 / _voxelSize;
+    double rotation[9];
+    double translation[3];
+    for (size_t i = 0; i < 9; ++i)
+      rotation[i] = pose.mRotation[i] * scale;
+    for (size_t i = 0; i < 3; ++i)
+      translation[i] = pose.mTranslation[i] * scale;
+    const size_t numPoints = scan.size();
+    _static.resize(numPoints);
+    _numRemoved = 0;
+    for (size_t i = 0; i < numPoints; ++i) {
+      const double x = scan.mX[i];
+      const double y = scan.mY[i];
+      const double z = scan.mZ[i];
+      const bool occupied = isOccupied(
+        int64_t(std::floor(rotation[0] * x + rotation[1] * y + rotation[2] * z
+          + translation[0])),
+        int64_t(std::floor(rotation[3] * x + rotation[4] * y + rotation[5] * z
+          + translation[1])),
+        int64_t(std::floor(rotation[6] * x + rotation[7] * y + rotation[8] * z
+          + translation[2])));
+      _static[i] = occupied;
+      _numRemoved += occupied;
+    }
+    size_t numKept = 0;
+    for (size_t i = 0; i < numPoints; ++i) {
+      scan.set(numKept, scan, i);
+      numKept += !_static[i];
+    }
+    scan.resize(numKept);
+    _numChecked = numPoints;
+    _totalNumChecked += _numChecked;
+    _totalNumRemoved += _numRemoved;
+    releaseIdleTiles();
+  }
+
+  size_t StaticMap::write(const std::string& fileName, double voxelSize,
+      size_t tileBits, const std::vector<float>& points) {
+    if (!(voxelSize > 0.0) || tileBits == 0 || tileBits > mMaxTileBits)
+      throw std::runtime_error("StaticMap: bad voxel size or tile bits");
+    // the voxels follow the voxel size as stored in the file, in float
+    voxelSize = static_cast<float>(voxelSize);
+    const int64_t localMask = (int64_t(1) << tileBits) - 1;
+    std::map<std::tuple<int32_t, int32_t, int32_t>, std::vector<uint32_t> >
+      tiles;
+    for (size_t i = 0; i + 2 < points.size(); i += 3) {
+      int64_t voxel[3];
+      for (size_t j = 0; j < 3; ++j)
+        voxel[j] = int64_t(std::floor(points[i + j] / voxelSize));
+      tiles[std::make_tuple(int32_t(voxel[0] >> tileBits),
+        int32_t(voxel[1] >> tileBits), int32_t(voxel[2] >> tileBits))].
+        push_back(((voxel[0] & localMask) << (2 * tileBits)) |
+        ((voxel[1] & localMask) << tileBits) | (voxel[2] & localMask));
+    }
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file)
+      throw std::runtime_error("StaticMap: cannot write " + fileName);
+    Header header;
+    std::memcpy(header.mMagic, mMagic, sizeof(mMagic));
+    header.mVoxelSize = voxelSize;
+    header.mTileBits = tileBits;
+    header.mNumTiles = tiles.size();
+    // the large hash tables are aligned on multiples of the page size, the
+    // small ones packed on cache lines, all at most half full
+    const uint64_t alignment = std::max<uint64_t>(mMinAlignment,
+      sysconf(_SC_PAGESIZE));
+    header.mAlignment = alignment;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    std::vector<uint64_t> offsets;
+    offsets.reserve(tiles.size());
+    uint64_t offset = sizeof(header) + tiles.size() * sizeof(TileEntry);
+    size_t numVoxels = 0;
+    for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+      std::vector<uint32_t>& keys = it->second;
+      std::sort(keys.begin(), keys.end());
+      keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+      numVoxels += keys.size();
+      TileEntry entry;
+      entry.mCoordinates[0] = std::get<0>(it->first);
+      entry.mCoordinates[1] = std::get<1>(it->first);
+      entry.mCoordinates[2] = std::get<2>(it->first);
+      entry.mNumSlots = 1;
+      while (entry.mNumSlots < 2 * keys.size())
+        entry.mNumSlots <<= 1;
+      const uint64_t tableSize = entry.mNumSlots * sizeof(uint32_t);
+      const uint64_t tableAlignment = tableSize >= alignment ? alignment :
+        mLineSize;
+      offset = (offset + tableAlignment - 1) / tableAlignment *
+        tableAlignment;
+      entry.mOffset = offset;
+      offsets.push_back(offset);
+      file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+      offset += tableSize;
+    }
+    size_t tileIdx = 0;
+    for (auto it = tiles.cbegin(); it != tiles.cend(); ++it) {
+      const std::vector<uint32_t>& keys = it->second;
+      uint32_t numSlots = 1;
+      while (numSlots < 2 * keys.size())
+        numSlots <<= 1;
+      std::vector<uint32_t> slots(numSlots, mEmpty);
+      for (auto itKey = keys.cbegin(); itKey != keys.cend(); ++itKey) {
+        uint32_t slot = hash(*itKey) & (numSlots - 1);
+        while (slots[slot] != mEmpty)
+          slot = (slot + 1) & (numSlots - 1);
+        slots[slot] = *itKey;
+      }
+      // the padding is skipped, it reads as zeros and takes no disk space
+      file.seekp(offsets[tileIdx++]);
+      file.write(reinterpret_cast<const char*>(slots.data()),
+        slots.size() * sizeof(uint32_t));
+    }
+    if (!file)
+      throw std::runtime_error("StaticMap: write failed");
+    return numVoxels;
+  }
+
+}
@@ -0,0 +1,261 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+
+/** \file StaticMap.h
+    \brief This file defines the StaticMap class which removes the returns
+           falling in the occupied voxels of a prior map.
+  */
+
+#ifndef STATIC_MAP_H
+#define STATIC_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace velodyne {
+
+  struct ScanBuffer;
+
+  /** The class StaticMap removes the returns of a scan that fall in the
+      occupied voxels of a prior map of the static structure, such that only
+      the novel returns remain. The map file is memory-mapped: it holds a
+      directory of tiles of 2^tileBits voxels along each axis, followed by
+      one open-addressing hash table of the occupied voxels per tile. The
+      tables of at least the alignment stored in the header start on it,
+      the smaller ones are packed on cache lines in between. The alignment
+      is at least 64 KiB, a multiple of the page size of the usual kernels,
+      such that the aligned blocks of a large table are released without its
+      neighbours, while the padding is left as holes of a sparse file. Only
+      the directory is read at construction, a tile is paged in when a
+      return first falls in it and released once it has not been hit for a
+      number of scans, such that the resident size follows the neighbourhood
+      of the sensor rather than the size of the map.
+      \brief Prior static map filter
+    */
+  class StaticMap {
+  public:
+    /** \name Types definitions
+      @{
+      */
+    /// Pose of the sensor in the map frame
+    struct Pose {
+      /// Rotation matrix, row-major
+      double mRotation[9];
+      /// Translation [m]
+      double mTranslation[3];
+    };
+    /** @}
+      */
+
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor with the map file and the number of scans after which an
+    /// idle tile is released
+    StaticMap(const std::string& fileName, size_t maxIdleScans);
+    /// Copy constructor
+    StaticMap(const StaticMap& other) = delete;
+    /// Copy assignment operator
+    StaticMap& operator = (const StaticMap& other) = delete;
+    /// Destructor
+    ~StaticMap();
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the edge length of a voxel [m]
+    double getVoxelSize() const {
+      return _voxelSize;
+    }
+    /// Returns the number of tiles of the map
+    size_t getNumTiles() const {
+      return _tiles.size();
+    }
+    /// Returns the number of tiles paged in
+    size_t getNumLoadedTiles() const {
+      return _loadedTiles.size();
+    }
+    /// Returns the total number of tile loads
+    uint64_t getTotalNumLoads() const {
+      return _totalNumLoads;
+    }
+    /// Returns the number of returns checked in the last scan
+    size_t getNumChecked() const {
+      return _numChecked;
+    }
+    /// Returns the number of returns removed in the last scan
+    size_t getNumRemoved() const {
+      return _numRemoved;
+    }
+    /// Returns the total number of returns checked
+    uint64_t getTotalNumChecked() const {
+      return _totalNumChecked;
+    }
+    /// Returns the total number of returns removed
+    uint64_t getTotalNumRemoved() const {
+      return _totalNumRemoved;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Removes the returns of a scan falling in occupied voxels in place,
+    /// given the pose of the sensor in the map frame
+    void filter(ScanBuffer& scan, const Pose& pose);
+    /// Returns true if the voxel holding a point of the map frame is occupied
+    bool isOccupied(double x, double y, double z);
+    /// Writes a map file with the voxels occupied by a set of points of the
+    /// map frame given as consecutive coordinates, returns the number of
+    /// occupied voxels
+    static size_t write(const std::string& fileName, double voxelSize,
+      size_t tileBits, const std::vector<float>& points);
+    /** @}
+      */
+
+    /** \name Public members
+      @{
+      */
+    /// Magic number of a map file
+    static const char mMagic[8];
+    /// Max number of voxel bits of a tile along an axis
+    static const size_t mMaxTileBits = 10;
+    /// Min alignment of the large hash tables in a map file [B]
+    static const uint64_t mMinAlignment = 65536;
+    /// Alignment of the small hash tables in a map file [B]
+    static const uint64_t mLineSize = 64;
+    /// Empty slot of a tile
+    static const uint32_t mEmpty = 0xffffffff;
+    /// Key matching no tile
+    static const uint64_t mNoTile = 0xffffffffffffffff;
+    /** @}
+      */
+
+  protected:
+    /** \name Protected types
+      @{
+      */
+    /// File header
+    struct Header {
+      /// Magic number
+      char mMagic[8];
+      /// Edge length of a voxel [m]
+      float mVoxelSize;
+      /// Number of voxel bits of a tile along an axis
+      uint32_t mTileBits;
+      /// Number of tiles
+      uint64_t mNumTiles;
+      /// Alignment of the large hash tables [B], a power of two
+      uint64_t mAlignment;
+    };
+    /// Directory entry of a tile
+    struct TileEntry {
+      /// Tile coordinates
+      int32_t mCoordinates[3];
+      /// Number of slots of the hash table, a power of two
+      uint32_t mNumSlots;
+      /// Offset of the hash table in the file [B]
+      uint64_t mOffset;
+    };
+    /// Mapped tile
+    struct Tile {
+      /// Hash table of the local keys of the occupied voxels
+      const uint32_t* mSlots;
+      /// Number of slots minus one
+      uint32_t mMask;
+      /// Scan in which the tile was last hit
+      uint64_t mLastHit;
+      /// Whether the tile is paged in
+      bool mLoaded;
+    };
+    /** @}
+      */
+
+    /** \name Protected methods
+      @{
+      */
+    /// Returns the key of a tile from its coordinates
+    static uint64_t getTileKey(int64_t x, int64_t y, int64_t z) {
+      const uint64_t mask = (uint64_t(1) << 21) - 1;
+      return ((x & mask) << 42) | ((y & mask) << 21) | (z & mask);
+    }
+    /// Returns the first slot of a local key in a hash table
+    static uint32_t hash(uint32_t key) {
+      return key * 2654435761u;
+    }
+    /// Returns true if a voxel is occupied
+    bool isOccupied(int64_t x, int64_t y, int64_t z);
+    /// Pages in a tile
+    void load(Tile& tile);
+    /// Releases the tiles that have not been hit recently
+    void releaseIdleTiles();
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Mapped file
+    const char* _data;
+    /// Size of the mapped file [B]
+    size_t _size;
+    /// Edge length of a voxel [m]
+    double _voxelSize;
+    /// Number of voxel bits of a tile along an axis
+    size_t _tileBits;
+    /// Alignment of the hash tables [B]
+    size_t _alignment;
+    /// Tiles by key
+    std::unordered_map<uint64_t, Tile> _tiles;
+    /// Tiles paged in
+    std::vector<Tile*> _loadedTiles;
+    /// Key of the last tile looked up
+    uint64_t _lastTileKey;
+    /// Last tile looked up, null if missing from the map
+    Tile* _lastTile;
+    /// Number of scans after which an idle tile is released
+    size_t _maxIdleScans;
+    /// Number of filtered scans
+    uint64_t _numScans;
+    /// Total number of tile loads
+    uint64_t _totalNumLoads;
+    /// Flags of the static returns
+    std::vector<uint8_t> _static;
+    /// Number of returns checked in the last scan
+    size_t _numChecked;
+    /// Number of returns removed in the last scan
+    size_t _numRemoved;
+    /// Total number of returns checked
+    uint64_t _totalNumChecked;
+    /// Total number of returns removed
+    uint64_t _totalNumRemoved;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // STATIC_MAP_H
@@ -0,0 +1,188 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "TaskScheduler.h"
+
+#include <exception>
+
+namespace velodyne {
+
+  namespace {
+
+    /// Index of the worker running on the current thread, or -1
+    thread_local int workerIndex = -1;
+
+  }
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  TaskScheduler::TaskScheduler(size_t numThreads, const
+      std::function<void()>& threadInitializer, const
+      std::function<void(const std::string&)>& errorHandler) :
+      _numQueued(0),
+      _numUncompleted(0),
+      _nextWorker(0),
+      _stop(false),
+      _threadInitializer(threadInitializer),
+      _errorHandler(errorHandler),
+      _numFailed(0) {
+    if (numThreads == 0)
+      numThreads = 1;
+    for (size_t i = 0; i < numThreads; ++i)
+      _workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    for (size_t i = 0; i < numThreads; ++i)
+      _workers[i]->mThread = std::thread(&TaskScheduler::run, this, i);
+  }
+
+  TaskScheduler::~TaskScheduler() {
+    wait();
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _queuedCondition.notify_all();
+    for (auto it = _workers.begin(); it != _workers.end(); ++it)
+      (*it)->mThread.join();
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  TaskScheduler::TaskPtr TaskScheduler::createTask(const
+      std::function<void()>& function) const {
+    TaskPtr task = std::make_shared<Task>();
+    task->mFunction = function;
+    task->mFinished = false;
+    task->mNumPending = 1;
+    return task;
+  }
+
+  void TaskScheduler::addDependency(const TaskPtr& before, const TaskPtr&
+      after) const {
+    if (!before)
+      return;
+    std::lock_guard<std::mutex> lock(before->mMutex);
+    if (before->mFinished)
+      return;
+    ++after->mNumPending;
+    before->mSuccessors.push_back(after);
+  }
+
+  void TaskScheduler::submit(const TaskPtr& task) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      ++_numUncompleted;
+    }
+    if (--task->mNumPending == 0)
+      enqueue(task);
+  }
+
+  void TaskScheduler::wait() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _doneCondition.wait(lock, [this] {return _numUncompleted == 0;});
+  }
+
+  void TaskScheduler::run(size_t workerIdx) {
+    workerIndex = workerIdx;
+    if (_threadInitializer)
+      _threadInitializer();
+    while (true) {
+      TaskPtr task;
+      if (pop(workerIdx, task)) {
+        execute(task);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(_mutex);
+      _queuedCondition.wait(lock, [this] {return _stop || _numQueued > 0;});
+      if (_stop && _numQueued == 0)
+        return;
+    }
+  }
+
+  void TaskScheduler::enqueue(const TaskPtr& task) {
+    // tasks released by a worker stay on its queue, where they are likely to
+    // find the data of their predecessor in cache
+    size_t workerIdx = workerIndex;
+    {
+      // counted before the push, a worker may pop the task right after it
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (workerIndex < 0 || workerIdx >= _workers.size())
+        workerIdx = _nextWorker++ % _workers.size();
+      ++_numQueued;
+    }
+    {
+      std::lock_guard<std::mutex> lock(_workers[workerIdx]->mMutex);
+      _workers[workerIdx]->mQueue.push_back(task);
+    }
+    _queuedCondition.notify_one();
+  }
+
+  bool TaskScheduler::pop(size_t workerIdx, TaskPtr& task) {
+    for (size_t i = 0; i < _workers.size() && !task; ++i) {
+      Worker& worker = *_workers[(workerIdx + i) % _workers.size()];
+      std::lock_guard<std::mutex> lock(worker.mMutex);
+      if (worker.mQueue.empty())
+        continue;
+      if (i == 0) {
+        task = worker.mQueue.back();
+        worker.mQueue.pop_back();
+      }
+      else {
+        task = worker.mQueue.front();
+        worker.mQueue.pop_front();
+      }
+    }
+    if (!task)
+      return false;
+    std::lock_guard<std::mutex> lock(_mutex);
+    --_numQueued;
+    return true;
+  }
+
+  void TaskScheduler::execute(const TaskPtr& task) {
+    try {
+      task->mFunction();
+    }
+    catch (const std::exception& e) {
+      ++_numFailed;
+      if (_errorHandler)
+        _errorHandler(e.what());
+    }
+    catch (...) {
+      ++_numFailed;
+      if (_errorHandler)
+        _errorHandler("unknown exception");
+    }
+    std::vector<TaskPtr> successors;
+    {
+      std::lock_guard<std::mutex> lock(task->mMutex);
+      task->mFinished = true;
+      successors.swap(task->mSuccessors);
+    }
+    for (auto it = successors.cbegin(); it != successors.cend(); ++it)
+      if (--(*it)->mNumPending == 0)
+        enqueue(*it);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (--_numUncompleted == 0)
+      _doneCondition.notify_all();
+  }
+
+}
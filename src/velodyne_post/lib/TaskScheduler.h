@@ -0,0 +1,181 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file TaskScheduler.h
+    \brief This file defines the TaskScheduler class which runs dependency
+           graphs of tasks on a work-stealing thread pool.
+  */
+
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <cstddef>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace velodyne {
+
+  /** The class TaskScheduler runs tasks on a pool of worker threads as soon
+      as their dependencies are completed. Each worker pops the tasks it
+      released from the back of its own queue and steals from the front of
+      the other queues when idle. Dependencies may be added on tasks of
+      previously submitted graphs, which allows consecutive graphs to overlap
+      while keeping the order of selected tasks. A task that throws is
+      reported to the error handler and counts as completed, so that its
+      successors still run.
+      \brief Work-stealing task scheduler
+    */
+  class TaskScheduler {
+  public:
+    /** \name Types definitions
+      @{
+      */
+    /// Task of a dependency graph
+    struct Task {
+      /// Function executed by the task
+      std::function<void()> mFunction;
+      /// Mutex protecting the completion and the successors
+      std::mutex mMutex;
+      /// Completion flag
+      bool mFinished;
+      /// Tasks waiting on this task
+      std::vector<std::shared_ptr<Task> > mSuccessors;
+      /// Number of uncompleted dependencies, plus one until submission
+      std::atomic<size_t> mNumPending;
+    };
+    /// Shared pointer to a task
+    typedef std::shared_ptr<Task> TaskPtr;
+    /** @}
+      */
+
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor, the initializer runs on each worker before its tasks
+    /// and the error handler receives the message of the failed tasks
+    TaskScheduler(size_t numThreads, const std::function<void()>&
+      threadInitializer = std::function<void()>(), const
+      std::function<void(const std::string&)>& errorHandler =
+      std::function<void(const std::string&)>());
+    /// Copy constructor
+    TaskScheduler(const TaskScheduler& other) = delete;
+    /// Copy assignment operator
+    TaskScheduler& operator = (const TaskScheduler& other) = delete;
+    /// Destructor, completes the submitted tasks
+    ~TaskScheduler();
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the number of worker threads
+    size_t getNumThreads() const {
+      return _workers.size();
+    }
+    /// Returns the number of tasks that threw
+    size_t getNumFailedTasks() const {
+      return _numFailed;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Creates a task, which runs once submitted and its dependencies done
+    TaskPtr createTask(const std::function<void()>& function) const;
+    /// Makes a task wait on another one (ignored if null or completed)
+    void addDependency(const TaskPtr& before, const TaskPtr& after) const;
+    /// Submits a task, the dependencies must be added beforehand
+    void submit(const TaskPtr& task);
+    /// Waits for the completion of all the submitted tasks
+    void wait();
+    /** @}
+      */
+
+  protected:
+    /** \name Protected types
+      @{
+      */
+    /// Worker thread with its task queue
+    struct Worker {
+      /// Thread
+      std::thread mThread;
+      /// Queue of ready tasks
+      std::deque<TaskPtr> mQueue;
+      /// Mutex protecting the queue
+      std::mutex mMutex;
+    };
+    /** @}
+      */
+
+    /** \name Protected methods
+      @{
+      */
+    /// Main loop of a worker
+    void run(size_t workerIdx);
+    /// Queues a ready task
+    void enqueue(const TaskPtr& task);
+    /// Pops a ready task from the own queue or steals one
+    bool pop(size_t workerIdx, TaskPtr& task);
+    /// Executes a task and releases its successors
+    void execute(const TaskPtr& task);
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Workers
+    std::vector<std::unique_ptr<Worker> > _workers;
+    /// Mutex protecting the counters and the stop flag
+    std::mutex _mutex;
+    /// Signals queued tasks or stop to the workers
+    std::condition_variable _queuedCondition;
+    /// Signals the completion of all the submitted tasks
+    std::condition_variable _doneCondition;
+    /// Number of queued tasks
+    size_t _numQueued;
+    /// Number of submitted and uncompleted tasks
+    size_t _numUncompleted;
+    /// Next queue for tasks released outside the workers
+    size_t _nextWorker;
+    /// Stop flag
+    bool _stop;
+    /// Initializer of the worker threads
+    std::function<void()> _threadInitializer;
+    /// Handler of the failed tasks
+    std::function<void(const std::string&)> _errorHandler;
+    /// Number of tasks that threw
+    std::atomic<size_t> _numFailed;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // TASK_SCHEDULER_H
@@ -0,0 +1,113 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+#include "VeilingFilter.h"
+
+#include <cmath>
+#include <limits>
+
+#include "ScanBuffer.h"
+
+namespace velodyne {
+
+/******************************************************************************/
+/* Constructors and Destructor                                                */
+/******************************************************************************/
+
+  VeilingFilter::VeilingFilter(double maxIncidenceAngle, double maxAzimuthGap,
+      size_t numLasers) :
+      _tanMaxIncidenceAngle(std::tan(maxIncidenceAngle)),
+      _maxAzimuthGap(std::round(maxAzimuthGap * 18000.0 / M_PI)),
+      _sinGaps(_maxAzimuthGap + 1),
+      _cosGaps(_maxAzimuthGap + 1),
+      _previous(numLasers),
+      _beforePrevious(numLasers),
+      _numChecked(0),
+      _numRemoved(0),
+      _totalNumChecked(0),
+      _totalNumRemoved(0) {
+    for (size_t i = 0; i <= _maxAzimuthGap; ++i) {
+      _sinGaps[i] = std::sin(i * M_PI / 18000.0);
+      _cosGaps[i] = std::cos(i * M_PI / 18000.0);
+    }
+  }
+
+/******************************************************************************/
+/* Methods                                                                    */
+/******************************************************************************/
+
+  uint16_t VeilingFilter::getAzimuthGap(uint16_t azimuth, uint16_t
+      neighbourAzimuth) {
+    const uint16_t gap = neighbourAzimuth > azimuth ?
+      neighbourAzimuth - azimuth : azimuth - neighbourAzimuth;
+    return gap > 18000 ? 36000 - gap : gap;
+  }
+
+  bool VeilingFilter::isNeighbour(uint16_t gap) const {
+    return gap > 0 && gap <= _maxAzimuthGap;
+  }
+
+  bool VeilingFilter::isGrazing(float range, float neighbourRange, uint16_t
+      gap) const {
+    // angle between the beam and the segment to the neighbour, by placing the
+    // return on the x-axis and the neighbour at the azimuth gap
+    return neighbourRange * _sinGaps[gap] < _tanMaxIncidenceAngle *
+      std::fabs(range - neighbourRange * _cosGaps[gap]);
+  }
+
+  void VeilingFilter::filter(ScanBuffer& scan) {
+    const size_t none = std::numeric_limits<size_t>::max();
+    _previous.assign(_previous.size(), none);
+    _beforePrevious.assign(_beforePrevious.size(), none);
+    const size_t numPoints = scan.size();
+    _veiling.assign(numPoints, 0);
+    _numChecked = 0;
+    _numRemoved = 0;
+    for (size_t i = 0; i < numPoints; ++i) {
+      const size_t ring = scan.mRing[i];
+      const size_t previous = _previous[ring];
+      const size_t beforePrevious = _beforePrevious[ring];
+      if (beforePrevious != none) {
+        // only the returns with both neighbours within the gap are tested
+        const uint16_t previousGap = getAzimuthGap(scan.mAzimuth[previous],
+          scan.mAzimuth[beforePrevious]);
+        const uint16_t nextGap = getAzimuthGap(scan.mAzimuth[previous],
+          scan.mAzimuth[i]);
+        if (isNeighbour(previousGap) && isNeighbour(nextGap)) {
+          ++_numChecked;
+          const bool veiling = isGrazing(scan.mRange[previous],
+            scan.mRange[beforePrevious], previousGap) &&
+            isGrazing(scan.mRange[previous], scan.mRange[i], nextGap);
+          _veiling[previous] = veiling;
+          _numRemoved += veiling;
+        }
+      }
+      _beforePrevious[ring] = previous;
+      _previous[ring] = i;
+    }
+    size_t numKept = 0;
+    for (size_t i = 0; i < numPoints; ++i) {
+      scan.set(numKept, scan, i);
+      numKept += !_veiling[i];
+    }
+    scan.resize(numKept);
+    _totalNumChecked += _numChecked;
+    _totalNumRemoved += _numRemoved;
+  }
+
+}
@@ -0,0 +1,137 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file VeilingFilter.h
+    \brief This file defines the VeilingFilter class which removes the mixed
+           pixels at depth discontinuities.
+  */
+
+#ifndef VEILING_FILTER_H
+#define VEILING_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace velodyne {
+
+  struct ScanBuffer;
+
+  /** The class VeilingFilter removes the veiling points, i.e., the mixed
+      pixels lying between a foreground and a background object. For each
+      return, the angle between its beam and the segments to its previous and
+      next azimuthal neighbours on the same ring is computed. A return is
+      veiling if both segments are nearly parallel to the beam. The detection
+      runs in a single pass over the scan, since the returns of a given ring
+      appear with increasing azimuth. It is not fused into the conversion
+      kernel: a return is only decided once the next return of its laser is
+      converted, which may belong to the next packet or, with the sector
+      conversion, to another thread, and the decided returns would still
+      have to be compacted out of the scan afterwards.
+      \brief Veiling points filter
+    */
+  class VeilingFilter {
+  public:
+    /** \name Constructors/destructor
+      @{
+      */
+    /// Constructor
+    VeilingFilter(double maxIncidenceAngle, double maxAzimuthGap,
+      size_t numLasers);
+    /** @}
+      */
+
+    /** \name Accessors
+      @{
+      */
+    /// Returns the number of returns tested in the last scan, i.e., with
+    /// both neighbours within the max azimuth gap
+    size_t getNumChecked() const {
+      return _numChecked;
+    }
+    /// Returns the number of returns removed in the last scan
+    size_t getNumRemoved() const {
+      return _numRemoved;
+    }
+    /// Returns the total number of returns checked
+    uint64_t getTotalNumChecked() const {
+      return _totalNumChecked;
+    }
+    /// Returns the total number of returns removed
+    uint64_t getTotalNumRemoved() const {
+      return _totalNumRemoved;
+    }
+    /** @}
+      */
+
+    /** \name Methods
+      @{
+      */
+    /// Removes the veiling points of a scan in place
+    void filter(ScanBuffer& scan);
+    /** @}
+      */
+
+  protected:
+    /** \name Protected methods
+      @{
+      */
+    /// Returns the wrapped gap between two raw azimuths [0.01 deg]
+    static uint16_t getAzimuthGap(uint16_t azimuth, uint16_t
+      neighbourAzimuth);
+    /// Returns true if a return at an azimuth gap is a neighbour to test
+    bool isNeighbour(uint16_t gap) const;
+    /// Returns true if the segment to a neighbour at an azimuth gap is nearly
+    /// parallel to a beam
+    bool isGrazing(float range, float neighbourRange, uint16_t gap) const;
+    /** @}
+      */
+
+    /** \name Protected members
+      @{
+      */
+    /// Tangent of the maximum angle between beam and segment
+    double _tanMaxIncidenceAngle;
+    /// Maximum azimuth gap between neighbours [0.01 deg]
+    uint16_t _maxAzimuthGap;
+    /// Sines of the azimuth gaps
+    std::vector<float> _sinGaps;
+    /// Cosines of the azimuth gaps
+    std::vector<float> _cosGaps;
+    /// Per-laser index of the previous return
+    std::vector<size_t> _previous;
+    /// Per-laser index of the return before the previous one
+    std::vector<size_t> _beforePrevious;
+    /// Flags of the veiling points
+    std::vector<uint8_t> _veiling;
+    /// Number of returns checked in the last scan
+    size_t _numChecked;
+    /// Number of returns removed in the last scan
+    size_t _numRemoved;
+    /// Total number of returns checked
+    uint64_t _totalNumChecked;
+    /// Total number of returns removed
+    uint64_t _totalNumRemoved;
+    /** @}
+      */
+
+  };
+
+}
+
+#endif // VEILING_FILTER_H
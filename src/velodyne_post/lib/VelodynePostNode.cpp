@@ -23,31 +23,85 @@
 #include <cstring>
 #include <cmath>
 #include <fstream>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <stdexcept>
 
 #include <boost/make_shared.hpp>
-
-#include <sensor_msgs/PointCloud2.h>
-#include <sensor_msgs/PointCloud.h>
-#include <sensor_msgs/point_cloud_conversion.h>
+#include <boost/bind.hpp>
 
 #include <libsnappy/snappy.h>
 
 #include <libvelodyne/sensor/DataPacket.h>
 #include <libvelodyne/sensor/Calibration.h>
-#include <libvelodyne/sensor/Converter.h>
-#include <libvelodyne/data-structures/VdynePointCloud.h>
 #include <libvelodyne/exceptions/IOException.h>
 
+#include "ScanConverter.h"
+#include "RangeDownsampler.h"
+#include "IntensityExtractor.h"
+#include "VeilingFilter.h"
+#include "StaticMap.h"
+#include "FailoverChannel.h"
+#include "BandwidthController.h"
+#include "ScanLogWriter.h"
+#include "ScanCache.h"
+#include "DepthImageProjector.h"
+#include "PointColorizer.h"
+#include "LaserStatistics.h"
+#include "ScanExporter.h"
+#include "LodServer.h"
+#include "MeshGenerator.h"
+
 namespace velodyne {
 
+  namespace {
+
+    ScanConverter::ReturnSelection toReturnSelection(const std::string&
+        returnSelection) {
+      if (returnSelection == "last")
+        return ScanConverter::ReturnSelection::last;
+      else if (returnSelection == "both")
+        return ScanConverter::ReturnSelection::both;
+      else if (returnSelection != "strongest")
+        ROS_ERROR_STREAM("Unknown return selection: " << returnSelection);
+      return ScanConverter::ReturnSelection::strongest;
+    }
+
+    double toDouble(XmlRpc::XmlRpcValue& value) {
+      if (value.getType() == XmlRpc::XmlRpcValue::TypeInt)
+        return static_cast<int>(value);
+      return static_cast<double>(value);
+    }
+
+  }
+
 /******************************************************************************/
 /* Constructors and Destructor                                                */
 /******************************************************************************/
 
   VelodynePostNode::VelodynePostNode(const ros::NodeHandle& nh) :
       _nodeHandle(nh),
-      _subscriptionIsActive(false) {
+      _staticMapNumMissingPoses(0),
+      _stageLoader("velodyne_post", "velodyne::ScanStage"),
+      _adaptiveLevel(0),
+      _standby(false),
+      _logging(false),
+      _subscriptionIsActive(false),
+      _exporting(false),
+      _numaCounters(),
+      _numScansInFlight(0),
+      _numSkippedScans(0),
+      _stageTotals(),
+      _stopPublishing(false) {
     getParameters();
+    if (_numaNode >= 0) {
+      // the buffers reserved from now on are first touched on the node
+      _numaTopology = std::make_shared<NumaTopology>();
+      bindToNumaNode();
+      _numaTopology->readCounters(_numaNode, _numaCounters);
+      _updater.add("NUMA", this, &VelodynePostNode::diagnoseNuma);
+    }
     std::ifstream calibFile(_calibFileName);
     _calibration = std::make_shared<Calibration>();
     try {
@@ -56,6 +110,130 @@ namespace velodyne {
     catch (const IOException& e) {
       ROS_WARN_STREAM("IOException: " << e.what());
     }
+    _converter = std::make_shared<ScanConverter>(*_calibration, _minDistance,
+      _maxDistance);
+    if (_deviceName == "Velodyne VLP-16")
+      _converter->setLayout(ScanConverter::Layout::vlp16);
+    else if (_deviceName == "Velodyne VLP-32C")
+      _converter->setLayout(ScanConverter::Layout::vlp32c);
+    // the HDL-64E alternates its banks between consecutive blocks, which are
+    // no pairs of returns of the same lasers
+    if (_returnMode == "dual" && _deviceName.find("HDL-64E") !=
+        std::string::npos)
+      ROS_ERROR_STREAM("Dual return mode not supported on " << _deviceName
+        << ", single return mode used");
+    else if (_returnMode == "dual")
+      _converter->setReturnMode(ScanConverter::ReturnMode::dual);
+    else if (_returnMode != "single")
+      ROS_ERROR_STREAM("Unknown return mode: " << _returnMode);
+    _converter->setReturnSelection(toReturnSelection(_returnSelection));
+    _converter->setIntensityReturnSelection(
+      toReturnSelection(_intensityExtractionReturnSelection));
+    if (_downsamplingEnabled)
+      _converter->setDownsampler(std::make_shared<RangeDownsampler>(
+        _downsamplingReferenceDistance, _downsamplingMinKeepProbability,
+        _downsamplingLaserWeights));
+    if (_veilingFilterEnabled)
+      _veilingFilter = std::make_shared<VeilingFilter>(
+        _veilingFilterMaxIncidenceAngle * M_PI / 180.0,
+        _veilingFilterMaxAzimuthGap * M_PI / 180.0, Calibration::mLasersNbr);
+    if (!_staticMapFileName.empty()) {
+      try {
+        _staticMap = std::make_shared<StaticMap>(_staticMapFileName,
+          _staticMapMaxIdleScans);
+        _transformListener = std::make_shared<tf::TransformListener>();
+        _updater.add("Static map", this, &VelodynePostNode::diagnoseStaticMap);
+      }
+      catch (const std::runtime_error& e) {
+        ROS_ERROR_STREAM("Static map filter disabled: " << e.what());
+      }
+    }
+    if (_intensityExtractionEnabled)
+      _converter->setIntensityExtractor(std::make_shared<IntensityExtractor>(
+        _intensityExtractionLaserThresholds,
+        _intensityExtractionDefaultThreshold,
+        _intensityExtractionNormalizeByDistance,
+        _intensityExtractionReferenceDistance, Calibration::mLasersNbr));
+    _updater.setHardwareID(_deviceName);
+    if (_hardwareCountersEnabled) {
+      _perfCounters = std::make_shared<PerfCounters>();
+      if (!_perfCounters->isAvailable())
+        ROS_INFO_STREAM("Hardware performance counters are not available");
+      _updater.add("Hardware counters", this,
+        &VelodynePostNode::diagnoseHardwareCounters);
+    }
+    loadStages("stages");
+    if (!_exportFileName.empty()) {
+      try {
+        if (_exportFormat != "arrow" && _exportFormat != "parquet")
+          throw std::runtime_error("unknown export format " + _exportFormat);
+        _scanExporter = std::make_shared<ScanExporter>(_exportFileName,
+          _exportFormat == "arrow" ? ScanExporter::Format::arrow :
+          ScanExporter::Format::parquet);
+        _exporting = true;
+      }
+      catch (const std::runtime_error& e) {
+        ROS_ERROR_STREAM("Export disabled: " << e.what());
+      }
+    }
+    if (_streamingEnabled) {
+      try {
+        _lodServer = std::make_shared<LodServer>(_streamingBindAddress,
+          _streamingPort, LodEncoder(_streamingVoxelSize,
+          _streamingNumLevels), _streamingMaxClients);
+        _updater.add("Streaming", this, &VelodynePostNode::diagnoseStreaming);
+      }
+      catch (const std::runtime_error& e) {
+        ROS_ERROR_STREAM("Streaming disabled: " << e.what());
+      }
+    }
+    getSafetyFieldParameters("safety_fields/fields", _safetyFields);
+    if (!_safetyFields.empty()) {
+      try {
+        _safetyMonitor = std::make_shared<SafetyMonitor>(*_converter,
+          _safetyFields, _minDistance, _maxDistance,
+          _safetyAzimuthResolution * M_PI / 180.0, _safetyMinReturns,
+          std::round(_safetyClearDelay * 1e9));
+        // latched, such that late subscribers get the current state
+        _safetyStatusPublisher =
+          _nodeHandle.advertise<velodyne_post::SafetyStatus>(
+          _safetyStatusTopicName, _queueDepth, true);
+        _updater.add("Safety fields", this,
+          &VelodynePostNode::diagnoseSafetyFields);
+      }
+      catch (const std::runtime_error& e) {
+        ROS_ERROR_STREAM("Safety fields disabled: " << e.what());
+      }
+    }
+    getCameraParameters("depth_images/cameras", _depthImageCameras);
+    for (auto it = _depthImageCameras.cbegin();
+        it != _depthImageCameras.cend(); ++it) {
+      _depthProjectors.push_back(std::make_shared<DepthImageProjector>(*it));
+      _depthImagePublishers.push_back(
+        _nodeHandle.advertise<sensor_msgs::Image>(it->getName() +
+        "/depth_image", _queueDepth));
+    }
+    getCameraParameters("colorization/cameras", _colorizationCameras);
+    for (auto it = _colorizationCameras.cbegin();
+        it != _colorizationCameras.cend(); ++it)
+      _colorizers.push_back(std::make_shared<PointColorizer>(*it,
+        _colorizationNumImages, std::round(_colorizationMaxTimeOffset *
+        1e9)));
+    _converter->setColorizers(_colorizers);
+    if (_cacheNumScans > 0) {
+      _scanCache = std::make_shared<ScanCache>(_cacheNumScans);
+      _queryRegionService = _nodeHandle.advertiseService(
+        _queryRegionServiceName, &VelodynePostNode::queryRegion, this);
+    }
+    if (_loggingEnabled) {
+      try {
+        _logWriter = std::make_shared<ScanLogWriter>(_logFileName);
+        _logging = true;
+      }
+      catch (const std::runtime_error& e) {
+        ROS_ERROR_STREAM("Logging disabled: " << e.what());
+      }
+    }
     if (_transportType == "udp")
       _transportHints = ros::TransportHints().unreliable().reliable();
     else if (_transportType == "tcp")
@@ -64,90 +242,1313 @@ namespace velodyne {
       ROS_ERROR_STREAM("Unknown transport type: " << _transportType);
     _pointCloudPublisher = _nodeHandle.advertise<sensor_msgs::PointCloud2>(
       _pointCloudTopicName, _queueDepth);
-    _dataPackets.reserve(_numDataPackets);
+    if (_intensityExtractionEnabled)
+      _intensityPointCloudPublisher =
+        _nodeHandle.advertise<sensor_msgs::PointCloud2>(
+        _intensityPointCloudTopicName, _queueDepth);
+    if (_meshingEnabled) {
+      std::vector<double> elevations(_converter->getNumLasers());
+      std::vector<double> firingFractions(elevations.size());
+      for (size_t i = 0; i < elevations.size(); ++i) {
+        elevations[i] = _calibration->getVertCorrection(i);
+        firingFractions[i] = _converter->getFiringFraction(i);
+      }
+      _meshGenerator = std::make_shared<MeshGenerator>(elevations,
+        firingFractions, _meshingMaxRangeRatio,
+        _meshingMaxIncidenceAngle * M_PI / 180.0,
+        _meshingMaxAzimuthGap * M_PI / 180.0);
+      _meshPublisher = _nodeHandle.advertise<velodyne_post::ScanMesh>(
+        _meshTopicName, _queueDepth);
+    }
+    if (_adaptiveOutputEnabled) {
+      try {
+        _bandwidthController = std::make_shared<BandwidthController>(
+          _adaptiveOutputNumLevels, _adaptiveOutputTargetLatency,
+          _adaptiveOutputReferenceDistance, _adaptiveOutputMinKeepProbability,
+          _adaptiveOutputResolution, _adaptiveOutputInitialThroughput,
+          _adaptiveOutputProbeFactor);
+        _adaptivePointCloudPublisher =
+          _nodeHandle.advertise<sensor_msgs::PointCloud2>(
+          _adaptivePointCloudTopicName, _queueDepth);
+        _adaptiveInfoPublisher =
+          _nodeHandle.advertise<velodyne_post::AdaptiveScanInfo>(
+          _adaptiveInfoTopicName, _queueDepth);
+        // published by the subscribers with /enable_statistics set
+        _statisticsSubscriber = _nodeHandle.subscribe("/statistics",
+          _queueDepth, &VelodynePostNode::statisticsCallback, this);
+        _updater.add("Adaptive output", this,
+          &VelodynePostNode::diagnoseAdaptiveOutput);
+      }
+      catch (const std::runtime_error& e) {
+        ROS_ERROR_STREAM("Adaptive output disabled: " << e.what());
+      }
+    }
+    if (_motionEstimationEnabled) {
+      std::vector<double> elevations(_converter->getNumLasers());
+      std::vector<double> firingFractions(elevations.size());
+      for (size_t i = 0; i < elevations.size(); ++i) {
+        elevations[i] = _calibration->getVertCorrection(i);
+        firingFractions[i] = _converter->getFiringFraction(i);
+      }
+      _twistPublisher = _nodeHandle.advertise<geometry_msgs::TwistStamped>(
+        _twistTopicName, _queueDepth);
+      _motionEstimator = std::make_shared<MotionEstimator>(elevations,
+        firingFractions, _motionEstimationColumnStride,
+        _motionEstimationMaxIterations,
+        _motionEstimationMaxCorrespondenceDistance,
+        _motionEstimationHuberThreshold, _motionEstimationMinCorrespondences,
+        std::round(_motionEstimationMaxScanGap * 1e9),
+        [this](const MotionEstimator::Motion& motion) {
+          publishTwist(motion);});
+      _updater.add("Motion estimation", this,
+        &VelodynePostNode::diagnoseMotionEstimation);
+    }
+    if (_statisticsEnabled) {
+      _laserStatistics = std::make_shared<LaserStatistics>(
+        _converter->getNumLasers());
+      _laserStatisticsPublisher =
+        _nodeHandle.advertise<velodyne_post::LaserStatistics>(
+        _laserStatisticsTopicName, _queueDepth);
+      _statisticsTimer = _nodeHandle.createTimer(
+        ros::Duration(1.0 / _statisticsPublishRate),
+        &VelodynePostNode::publishStatistics, this);
+    }
+    if (_failoverEnabled) {
+      try {
+        // the ring holds the revolution in progress even if the primary has
+        // just missed a publication
+        _failoverChannel = std::make_shared<FailoverChannel>(_failoverShmName,
+          2 * _numDataPackets, std::round(_failoverHeartbeatTimeout * 1e9));
+        _standby = !_failoverChannel->acquire();
+        if (_standby)
+          ROS_INFO_STREAM("Standby of primary "
+            << _failoverChannel->getPrimaryPid());
+        _failoverTimer = _nodeHandle.createTimer(
+          ros::Duration(_failoverHeartbeatTimeout * 0.25),
+          &VelodynePostNode::beatFailover, this);
+        _updater.add("Failover", this, &VelodynePostNode::diagnoseFailover);
+      }
+      catch (const std::runtime_error& e) {
+        ROS_ERROR_STREAM("Failover disabled: " << e.what());
+      }
+    }
+    // a standby keeps up to two revolutions if the primary stops publishing,
+    // the buffers rotate between the node and the publishing threads
+    std::vector<DataPacket>* buffers[] = {&_dataPackets, &_pendingPackets,
+      &_scanPackets};
+    for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); ++i) {
+      buffers[i]->reserve(_failoverChannel ? 3 * _numDataPackets :
+        _numDataPackets);
+      if (_numaTopology && _numaFirstTouch)
+        NumaTopology::touch(buffers[i]->data(),
+          buffers[i]->capacity() * sizeof(DataPacket));
+    }
+    if (_autotuningEnabled)
+      autotune();
+    if (_schedulerNumThreads > 0) {
+      _scheduler = std::make_shared<TaskScheduler>(_schedulerNumThreads,
+        _numaTopology ? std::function<void()>([this] {bindToNumaNode();}) :
+        std::function<void()>(), [](const std::string& error) {
+          ROS_ERROR_STREAM("Scheduled stage failed: " << error);
+        });
+      if (_perfCounters)
+        ROS_INFO_STREAM("Hardware counters only cover decoding when the "
+          "stages run on the scheduler");
+    }
+    _updater.add("Publication", this, &VelodynePostNode::diagnosePublication);
+    _publishThread = std::thread(&VelodynePostNode::runPublication, this);
   }
 
   VelodynePostNode::~VelodynePostNode() {
+    {
+      std::lock_guard<std::mutex> lock(_scanMutex);
+      _stopPublishing = true;
+    }
+    _scanCondition.notify_one();
+    _publishThread.join();
+    // completes the scheduled stages before the outputs are destroyed
+    _scheduler.reset();
+    _motionEstimator.reset();
   }
 
 /******************************************************************************/
 /* Methods                                                                    */
 /******************************************************************************/
 
+  void VelodynePostNode::imageCallback(const sensor_msgs::ImageConstPtr& msg,
+      size_t colorizerIdx) {
+    PointColorizer::Encoding encoding;
+    if (msg->encoding == "rgb8")
+      encoding = PointColorizer::rgb8;
+    else if (msg->encoding == "bgr8")
+      encoding = PointColorizer::bgr8;
+    else if (msg->encoding == "mono8")
+      encoding = PointColorizer::mono8;
+    else {
+      ROS_WARN_STREAM_THROTTLE(10.0, "Unsupported image encoding: "
+        << msg->encoding);
+      return;
+    }
+    std::lock_guard<std::mutex> lock(_conversionMutex);
+    PointColorizer& colorizer = *_colorizers[colorizerIdx];
+    if (!colorizer.addImage(msg->header.stamp.toNSec(), msg->data.data(),
+        msg->data.size(), msg->width, msg->height, msg->step, encoding))
+      ROS_WARN_STREAM_THROTTLE(10.0, "Image of size " << msg->width << "x"
+        << msg->height << ", step " << msg->step << " and "
+        << msg->data.size() << " bytes rejected by camera "
+        << colorizer.getCamera().getName());
+  }
+
+  void VelodynePostNode::statisticsCallback(const
+      rosgraph_msgs::TopicStatisticsConstPtr& msg) {
+    // one message per subscriber and window, the slowest one rules
+    if (msg->topic != _adaptivePointCloudPublisher.getTopic() ||
+        msg->node_pub != ros::this_node::getName())
+      return;
+    std::lock_guard<std::mutex> lock(_bandwidthMutex);
+    _bandwidthController->addStatistics((msg->window_stop -
+      msg->window_start).toSec(), std::max(msg->traffic, 0),
+      std::max(msg->dropped_msgs, 0), msg->stamp_age_mean.toSec());
+  }
+
   void VelodynePostNode::velodyneDataPacketCallback(const
       velodyne::DataPacketMsgConstPtr& msg) {
     _frameId = msg->header.frame_id;
     DataPacket dataPacket;
-    for (size_t i = 0; i < DataPacket::mDataChunkNbr; ++i) {
-      DataPacket::DataChunk dataChunk;
-      dataChunk.mHeaderInfo = msg->dataChunks[i].headerInfo;
-      dataChunk.mRotationalInfo = msg->dataChunks[i].rotationalInfo;
-      for (size_t j = 0; j < DataPacket::DataChunk::mLasersPerPacket; ++j) {
-        DataPacket::LaserData laserData;
-        laserData.mDistance = msg->dataChunks[i].laserData[j].distance;
-        laserData.mIntensity = msg->dataChunks[i].laserData[j].intensity;
-        dataChunk.mLaserData[j] = laserData;
-      }
-      dataPacket.setDataChunk(dataChunk, i);
+    {
+      PerfCounters::Scope scope(_perfCounters.get(), PerfCounters::decode);
+      for (size_t i = 0; i < DataPacket::mDataChunkNbr; ++i) {
+        DataPacket::DataChunk dataChunk;
+        dataChunk.mHeaderInfo = msg->dataChunks[i].headerInfo;
+        dataChunk.mRotationalInfo = msg->dataChunks[i].rotationalInfo;
+        for (size_t j = 0; j < DataPacket::DataChunk::mLasersPerPacket; ++j) {
+          DataPacket::LaserData laserData;
+          laserData.mDistance = msg->dataChunks[i].laserData[j].distance;
+          laserData.mIntensity = msg->dataChunks[i].laserData[j].intensity;
+          dataChunk.mLaserData[j] = laserData;
+        }
+        dataPacket.setDataChunk(dataChunk, i);
+      }
     }
+    if (_perfCounters)
+      _perfCounters->addPoints(DataPacket::mDataChunkNbr *
+        DataPacket::DataChunk::mLasersPerPacket);
     dataPacket.setTimestamp(msg->header.stamp.toNSec());
     dataPacket.setSpinCount(msg->spinCount);
     dataPacket.setReserved(msg->reserved);
-    _dataPackets.push_back(dataPacket);
-    if (_dataPackets.size() == static_cast<size_t>(_numDataPackets)) {
-      publish();
-      _dataPackets.clear();
-    }
+    addDataPacket(dataPacket);
   }
 
   void VelodynePostNode::velodyneBinarySnappyCallback(const
       velodyne::BinarySnappyMsgConstPtr& msg) {
     std::string uncompressedData;
-    snappy::Uncompress(
-      reinterpret_cast<const char*>(msg->data.data()),
-      msg->data.size(), &uncompressedData);
+    {
+      PerfCounters::Scope scope(_perfCounters.get(),
+        PerfCounters::decompress);
+      snappy::Uncompress(
+        reinterpret_cast<const char*>(msg->data.data()),
+        msg->data.size(), &uncompressedData);
+    }
     _frameId = msg->header.frame_id;
     DataPacket dataPacket;
-    std::istringstream binaryStream(uncompressedData);
-    dataPacket.readBinary(binaryStream);
+    {
+      PerfCounters::Scope scope(_perfCounters.get(), PerfCounters::decode);
+      std::istringstream binaryStream(uncompressedData);
+      dataPacket.readBinary(binaryStream);
+    }
+    if (_perfCounters)
+      _perfCounters->addPoints(DataPacket::mDataChunkNbr *
+        DataPacket::DataChunk::mLasersPerPacket);
     dataPacket.setTimestamp(msg->header.stamp.toNSec());
+    addDataPacket(dataPacket);
+  }
+
+  void VelodynePostNode::addDataPacket(const DataPacket& dataPacket) {
+    if (_failoverChannel && !_failoverChannel->acquire()) {
+      keepStandbyPacket(dataPacket);
+      return;
+    }
+    if (_standby)
+      takeOver();
+    if (_safetyMonitor)
+      checkSafetyFields(dataPacket);
     _dataPackets.push_back(dataPacket);
+    if (_failoverChannel)
+      _failoverChannel->write(dataPacket);
     if (_dataPackets.size() == static_cast<size_t>(_numDataPackets)) {
+      const int64_t timestamp = _dataPackets.back().getTimestamp();
+      handOff();
+      if (_failoverChannel)
+        _failoverChannel->setPublished(timestamp);
+    }
+  }
+
+  void VelodynePostNode::handOff() {
+    _updater.update();
+    {
+      // the node thread only waits for the publishing thread to take or
+      // replace a revolution, never for a publication
+      std::lock_guard<std::mutex> lock(_scanMutex);
+      if (!_pendingPackets.empty())
+        ++_numSkippedScans;
+      _pendingPackets.swap(_dataPackets);
+      _pendingFrameId = _frameId;
+    }
+    _scanCondition.notify_one();
+    _dataPackets.clear();
+  }
+
+  void VelodynePostNode::runPublication() {
+    if (_numaTopology)
+      bindToNumaNode();
+    // the counters are opened for the calling thread
+    if (_perfCounters && !_scheduler)
+      _stagePerfCounters = std::make_shared<PerfCounters>();
+    std::unique_lock<std::mutex> lock(_scanMutex);
+    while (true) {
+      _scanCondition.wait(lock, [this] {
+        return _stopPublishing || !_pendingPackets.empty();});
+      if (_stopPublishing)
+        return;
+      _scanPackets.swap(_pendingPackets);
+      _scanFrameId = _pendingFrameId;
+      lock.unlock();
       publish();
-      _dataPackets.clear();
+      _scanPackets.clear();
+      lock.lock();
+      if (_stagePerfCounters) {
+        for (size_t i = 0; i < PerfCounters::numStages; ++i) {
+          const PerfCounters::Totals& totals =
+            _stagePerfCounters->getTotals(static_cast<PerfCounters::Stage>(i));
+          for (size_t j = 0; j < PerfCounters::numCounters; ++j)
+            _stageTotals[i].mValues[j] += totals.mValues[j];
+          _stageTotals[i].mNumSamples += totals.mNumSamples;
+        }
+        _stagePerfCounters->reset();
+      }
+    }
+  }
+
+  void VelodynePostNode::keepStandbyPacket(const DataPacket& dataPacket) {
+    // the protective fields are checked from the takeover on, such that the
+    // primary alone publishes their state
+    _standby = true;
+    _dataPackets.push_back(dataPacket);
+    const int64_t published = _failoverChannel->getPublished();
+    size_t numPublished = 0;
+    while (numPublished < _dataPackets.size() &&
+        _dataPackets[numPublished].getTimestamp() <= published)
+      ++numPublished;
+    const size_t maxNumPackets = 2 * _numDataPackets;
+    if (_dataPackets.size() - numPublished > maxNumPackets)
+      numPublished = _dataPackets.size() - maxNumPackets;
+    _dataPackets.erase(_dataPackets.begin(), _dataPackets.begin() +
+      numPublished);
+  }
+
+  void VelodynePostNode::takeOver() {
+    _standby = false;
+    // the revolution in progress is the one of the former primary, completed
+    // with the packets it did not receive before it died
+    const int64_t published = _failoverChannel->getPublished();
+    _failoverChannel->read(published, _failoverPackets);
+    const size_t numMirrored = _failoverPackets.size();
+    for (auto it = _dataPackets.cbegin(); it != _dataPackets.cend(); ++it)
+      if (it->getTimestamp() > published)
+        _failoverPackets.push_back(*it);
+    std::stable_sort(_failoverPackets.begin(), _failoverPackets.end(),
+      [](const DataPacket& lhs, const DataPacket& rhs) {
+        return lhs.getTimestamp() < rhs.getTimestamp();});
+    _failoverPackets.erase(std::unique(_failoverPackets.begin(),
+      _failoverPackets.end(), [](const DataPacket& lhs, const DataPacket& rhs) {
+        return lhs.getTimestamp() == rhs.getTimestamp();}),
+      _failoverPackets.end());
+    ROS_WARN_STREAM("Took over from the former primary with "
+      << _failoverPackets.size() << " packets in progress, " << numMirrored
+      << " from its ring");
+    _dataPackets.clear();
+    for (auto it = _failoverPackets.cbegin(); it != _failoverPackets.cend();
+        ++it) {
+      _dataPackets.push_back(*it);
+      _failoverChannel->write(*it);
+      if (_dataPackets.size() == static_cast<size_t>(_numDataPackets)) {
+        handOff();
+        _failoverChannel->setPublished(it->getTimestamp());
+      }
     }
   }
 
+  void VelodynePostNode::beatFailover(const ros::TimerEvent& /*event*/) {
+    // a primary stalled beyond the heartbeat timeout has been replaced
+    if (!_standby && !_failoverChannel->beat()) {
+      ROS_WARN_STREAM("Primary role taken over by "
+        << _failoverChannel->getPrimaryPid());
+      _standby = true;
+    }
+    // the diagnostics are otherwise updated on publication
+    if (_standby)
+      _updater.update();
+  }
+
+  void VelodynePostNode::checkSafetyFields(const DataPacket& dataPacket) {
+    // the packet is checked before it waits for the rest of its revolution
+    if (!_safetyMonitor->update(dataPacket))
+      return;
+    auto status = boost::make_shared<velodyne_post::SafetyStatus>();
+    status->header.stamp = ros::Time().fromNSec(dataPacket.getTimestamp());
+    status->header.frame_id = _frameId;
+    status->violated_fields = _safetyMonitor->getViolatedFields();
+    status->num_returns = _safetyMonitor->getNumReturns();
+    _safetyStatusPublisher.publish(status);
+  }
+
   void VelodynePostNode::publish() {
-    if (_pointCloudPublisher.getNumSubscribers() == 0)
+    if (_logWriter) {
+      try {
+        _logWriter->write(_scanPackets);
+      }
+      catch (const std::runtime_error& e) {
+        ROS_ERROR_STREAM("Logging disabled: " << e.what());
+        _logWriter.reset();
+        _logging = false;
+      }
+    }
+    if (_scanCache) {
+      std::lock_guard<std::mutex> lock(_cacheMutex);
+      _scanCache->insert(_scanPackets);
+    }
+    const bool publishPointCloud =
+      _pointCloudPublisher.getNumSubscribers() > 0;
+    const bool publishIntensity = _intensityExtractionEnabled &&
+      _intensityPointCloudPublisher.getNumSubscribers() > 0;
+    const bool accumulateStatistics = _statisticsEnabled &&
+      _laserStatisticsPublisher.getNumSubscribers() > 0;
+    std::vector<size_t> depthImages;
+    for (size_t i = 0; i < _depthImagePublishers.size(); ++i)
+      if (_depthImagePublishers[i].getNumSubscribers() > 0)
+        depthImages.push_back(i);
+    // slow streaming clients skip scans, they never hold back the node
+    const bool stream = _lodServer && _lodServer->getNumClients() > 0;
+    const bool publishMesh = _meshingEnabled &&
+      _meshPublisher.getNumSubscribers() > 0;
+    const bool estimateMotion = _motionEstimator &&
+      _twistPublisher.getNumSubscribers() > 0;
+    const bool publishAdaptive = _bandwidthController &&
+      _adaptivePointCloudPublisher.getNumSubscribers() > 0;
+    const bool filter = publishPointCloud || _exporting || stream ||
+      publishMesh || estimateMotion || publishAdaptive;
+    if (!filter && !publishIntensity && depthImages.empty() &&
+        !accumulateStatistics)
       return;
-    VdynePointCloud pointCloud;
-    for (auto it = _dataPackets.cbegin(); it != _dataPackets.cend(); ++it)
-      Converter::toPointCloud(*it, *_calibration, pointCloud, _minDistance,
-        _maxDistance);
-    auto rosPointCloud = boost::make_shared<sensor_msgs::PointCloud>();
-    rosPointCloud->header.stamp =
-      ros::Time().fromNSec(_dataPackets.front().getTimestamp()
-      + std::round((_dataPackets.back().getTimestamp() -
-      _dataPackets.front().getTimestamp()) * 0.5));
-    rosPointCloud->header.frame_id = _frameId;
-    const auto numPoints = pointCloud.getSize();
-    rosPointCloud->points.reserve(numPoints);
-    rosPointCloud->channels.resize(1);
-    rosPointCloud->channels[0].name = "intensity";
-    rosPointCloud->channels[0].values.reserve(numPoints);
-    const auto& points = pointCloud.getPoints();
-    for (const auto& point : points) {
-      geometry_msgs::Point32 rosPoint;
-      rosPoint.x = point.mX;
-      rosPoint.y = point.mY;
-      rosPoint.z = point.mZ;
-      rosPointCloud->points.push_back(rosPoint);
-      rosPointCloud->channels[0].values.push_back(point.mIntensity);
-    }
-    auto rosPointCloud2 = boost::make_shared<sensor_msgs::PointCloud2>();
-    convertPointCloudToPointCloud2 (*rosPointCloud, *rosPointCloud2);
-    _pointCloudPublisher.publish(rosPointCloud2);
+    std::shared_ptr<ScanJob> job = acquireJob();
+    job->mTimestamp = getScanTimestamp();
+    job->mFrameId = _scanFrameId;
+    job->mFilter = filter;
+    job->mPublishPointCloud = publishPointCloud;
+    job->mStream = stream;
+    job->mPublishMesh = publishMesh;
+    job->mPublishAdaptive = publishAdaptive;
+    job->mPublishIntensity = publishIntensity;
+    job->mAccumulateStatistics = accumulateStatistics;
+    job->mDepthImages.swap(depthImages);
+    // the job keeps the packets, the publishing thread gets back the buffer
+    // of a former job to be cleared by the caller
+    job->mDataPackets.swap(_scanPackets);
+    if (_scheduler)
+      scheduleScan(job);
+    else {
+      runScan(*job);
+      releaseJob(job);
+    }
+  }
+
+  void VelodynePostNode::runScan(ScanJob& job) {
+    convertScan(job);
+    if (job.mFilter)
+      filterScan(job);
+    if (job.mPublishPointCloud) {
+      serializePointCloud(job);
+      _pointCloudPublisher.publish(job.mPointCloud);
+    }
+    if (job.mStream)
+      _lodServer->publish(job.mScan);
+    if (job.mPublishMesh) {
+      serializeMesh(job);
+      _meshPublisher.publish(job.mMesh);
+    }
+    if (job.mPublishAdaptive) {
+      serializeAdaptivePointCloud(job);
+      publishAdaptivePointCloud(job);
+    }
+    if (job.mPublishIntensity) {
+      serializeIntensityPointCloud(job);
+      _intensityPointCloudPublisher.publish(job.mIntensityPointCloud);
+    }
+    for (auto it = job.mDepthImages.cbegin(); it != job.mDepthImages.cend();
+        ++it)
+      publishDepthImage(job, *it);
+  }
+
+  void VelodynePostNode::scheduleScan(const std::shared_ptr<ScanJob>& job) {
+    {
+      std::unique_lock<std::mutex> lock(_jobsMutex);
+      _jobsCondition.wait(lock, [this] {return _numScansInFlight <
+        static_cast<size_t>(std::max(_schedulerMaxScansInFlight, 1));});
+      ++_numScansInFlight;
+    }
+    TaskScheduler& scheduler = *_scheduler;
+    std::vector<TaskScheduler::TaskPtr> tasks;
+    // the conversion mutates the converter, the depth projectors and the
+    // statistics, it waits on the conversion and the depth images of the
+    // previous scan
+    const size_t numSectors = isSectorConvertible(*job) ?
+      std::min(_schedulerNumSectors > 0 ?
+      static_cast<size_t>(_schedulerNumSectors) : scheduler.getNumThreads(),
+      job->mDataPackets.size()) : 1;
+    TaskScheduler::TaskPtr convertTask;
+    if (numSectors > 1) {
+      TaskScheduler::TaskPtr configureTask = scheduler.createTask(
+        [this, job, numSectors] {
+          configureConverter(*job);
+          job->mSectorScans.resize(numSectors);
+          job->mSectorIntensityScans.resize(numSectors);
+        });
+      convertTask = scheduler.createTask([this, job] {mergeSectors(*job);});
+      tasks.push_back(configureTask);
+      for (size_t i = 0; i < numSectors; ++i) {
+        TaskScheduler::TaskPtr sectorTask = scheduler.createTask(
+          [this, job, i, numSectors] {convertSector(*job, i, numSectors);});
+        scheduler.addDependency(configureTask, sectorTask);
+        scheduler.addDependency(sectorTask, convertTask);
+        tasks.push_back(sectorTask);
+      }
+    }
+    else {
+      convertTask = scheduler.createTask([this, job] {convertScan(*job);});
+      tasks.push_back(convertTask);
+    }
+    scheduler.addDependency(_lastConvertTask, tasks.front());
+    for (auto it = _lastDepthImageTasks.cbegin();
+        it != _lastDepthImageTasks.cend(); ++it)
+      scheduler.addDependency(*it, tasks.front());
+    if (numSectors > 1)
+      tasks.push_back(convertTask);
+    _lastConvertTask = convertTask;
+    // outputs wait on their counterpart of the previous scan, such that they
+    // are published in order, the serializations overlap
+    std::vector<TaskScheduler::TaskPtr> publishTasks;
+    TaskScheduler::TaskPtr filterTask;
+    if (job->mFilter) {
+      filterTask = scheduler.createTask([this, job] {filterScan(*job);});
+      scheduler.addDependency(convertTask, filterTask);
+      scheduler.addDependency(_lastFilterTask, filterTask);
+      _lastFilterTask = filterTask;
+      tasks.push_back(filterTask);
+      publishTasks.push_back(filterTask);
+    }
+    if (job->mPublishPointCloud) {
+      TaskScheduler::TaskPtr serializeTask = scheduler.createTask(
+        [this, job] {serializePointCloud(*job);});
+      scheduler.addDependency(filterTask, serializeTask);
+      TaskScheduler::TaskPtr publishTask = scheduler.createTask(
+        [this, job] {_pointCloudPublisher.publish(job->mPointCloud);});
+      scheduler.addDependency(serializeTask, publishTask);
+      scheduler.addDependency(_lastPointCloudTask, publishTask);
+      _lastPointCloudTask = publishTask;
+      tasks.push_back(serializeTask);
+      publishTasks.push_back(publishTask);
+    }
+    if (job->mStream) {
+      // the encoding runs beside the serializations, in scan order
+      TaskScheduler::TaskPtr streamTask = scheduler.createTask(
+        [this, job] {_lodServer->publish(job->mScan);});
+      scheduler.addDependency(filterTask, streamTask);
+      scheduler.addDependency(_lastStreamTask, streamTask);
+      _lastStreamTask = streamTask;
+      publishTasks.push_back(streamTask);
+    }
+    if (job->mPublishMesh) {
+      // the generator keeps its grid between scans, the triangulation waits
+      // on the publishing of the previous mesh
+      TaskScheduler::TaskPtr serializeTask = scheduler.createTask(
+        [this, job] {serializeMesh(*job);});
+      scheduler.addDependency(filterTask, serializeTask);
+      scheduler.addDependency(_lastMeshTask, serializeTask);
+      TaskScheduler::TaskPtr publishTask = scheduler.createTask(
+        [this, job] {_meshPublisher.publish(job->mMesh);});
+      scheduler.addDependency(serializeTask, publishTask);
+      _lastMeshTask = publishTask;
+      tasks.push_back(serializeTask);
+      publishTasks.push_back(publishTask);
+    }
+    if (job->mPublishAdaptive) {
+      // the controller keeps the levels of the scan it measures, the
+      // serialization waits on the publishing of the previous scan
+      TaskScheduler::TaskPtr serializeTask = scheduler.createTask(
+        [this, job] {serializeAdaptivePointCloud(*job);});
+      scheduler.addDependency(filterTask, serializeTask);
+      scheduler.addDependency(_lastAdaptiveTask, serializeTask);
+      TaskScheduler::TaskPtr publishTask = scheduler.createTask(
+        [this, job] {publishAdaptivePointCloud(*job);});
+      scheduler.addDependency(serializeTask, publishTask);
+      _lastAdaptiveTask = publishTask;
+      tasks.push_back(serializeTask);
+      publishTasks.push_back(publishTask);
+    }
+    if (job->mPublishIntensity) {
+      TaskScheduler::TaskPtr serializeTask = scheduler.createTask(
+        [this, job] {serializeIntensityPointCloud(*job);});
+      scheduler.addDependency(convertTask, serializeTask);
+      TaskScheduler::TaskPtr publishTask = scheduler.createTask(
+        [this, job] {_intensityPointCloudPublisher.publish(
+          job->mIntensityPointCloud);});
+      scheduler.addDependency(serializeTask, publishTask);
+      scheduler.addDependency(_lastIntensityTask, publishTask);
+      _lastIntensityTask = publishTask;
+      tasks.push_back(serializeTask);
+      publishTasks.push_back(publishTask);
+    }
+    _lastDepthImageTasks.clear();
+    for (auto it = job->mDepthImages.cbegin(); it != job->mDepthImages.cend();
+        ++it) {
+      const size_t cameraIdx = *it;
+      TaskScheduler::TaskPtr publishTask = scheduler.createTask(
+        [this, job, cameraIdx] {publishDepthImage(*job, cameraIdx);});
+      scheduler.addDependency(convertTask, publishTask);
+      _lastDepthImageTasks.push_back(publishTask);
+      publishTasks.push_back(publishTask);
+    }
+    TaskScheduler::TaskPtr doneTask = scheduler.createTask([this, job] {
+      releaseJob(job);
+      {
+        std::lock_guard<std::mutex> lock(_jobsMutex);
+        --_numScansInFlight;
+      }
+      _jobsCondition.notify_one();
+    });
+    scheduler.addDependency(convertTask, doneTask);
+    for (auto it = publishTasks.cbegin(); it != publishTasks.cend(); ++it) {
+      scheduler.addDependency(*it, doneTask);
+      tasks.push_back(*it);
+    }
+    tasks.push_back(doneTask);
+    for (auto it = tasks.cbegin(); it != tasks.cend(); ++it)
+      scheduler.submit(*it);
+  }
+
+  std::shared_ptr<VelodynePostNode::ScanJob> VelodynePostNode::acquireJob() {
+    std::lock_guard<std::mutex> lock(_jobsMutex);
+    if (_freeJobs.empty()) {
+      auto job = std::make_shared<ScanJob>();
+      job->mDataPackets.reserve(_numDataPackets);
+      job->mScan.reserve(_numDataPackets * DataPacket::mDataChunkNbr *
+        DataPacket::DataChunk::mLasersPerPacket);
+      if (_numaTopology && _numaFirstTouch)
+        touchJob(*job);
+      return job;
+    }
+    std::shared_ptr<ScanJob> job = _freeJobs.back();
+    _freeJobs.pop_back();
+    return job;
+  }
+
+  void VelodynePostNode::releaseJob(const std::shared_ptr<ScanJob>& job) {
+    job->mPointCloud.reset();
+    job->mIntensityPointCloud.reset();
+    job->mMesh.reset();
+    job->mAdaptivePointCloud.reset();
+    job->mAdaptiveInfo.reset();
+    std::lock_guard<std::mutex> lock(_jobsMutex);
+    _freeJobs.push_back(job);
+  }
+
+  bool VelodynePostNode::isSectorConvertible(const ScanJob& job) const {
+    // sectors only write to their own buffers
+    return job.mDepthImages.empty() && !job.mAccumulateStatistics &&
+      _colorizers.empty();
+  }
+
+  void VelodynePostNode::configureConverter(const ScanJob& job) {
+    std::vector<std::shared_ptr<DepthImageProjector> > depthProjectors;
+    for (auto it = job.mDepthImages.cbegin(); it != job.mDepthImages.cend();
+        ++it) {
+      _depthProjectors[*it]->reset();
+      depthProjectors.push_back(_depthProjectors[*it]);
+    }
+    _converter->setDepthProjectors(depthProjectors);
+    _converter->setStatistics(job.mAccumulateStatistics ? _laserStatistics :
+      std::shared_ptr<LaserStatistics>());
+  }
+
+  void VelodynePostNode::convertScan(ScanJob& job) {
+    PerfCounters::Scope scope(getStagePerfCounters(), PerfCounters::convert);
+    std::lock_guard<std::mutex> lock(_conversionMutex);
+    configureConverter(job);
+    job.mScan.clear();
+    job.mIntensityScan.clear();
+    job.mScan.mStartTime = job.mDataPackets.front().getTimestamp();
+    job.mIntensityScan.mStartTime = job.mScan.mStartTime;
+    for (auto it = job.mDataPackets.cbegin(); it != job.mDataPackets.cend();
+        ++it)
+      _converter->convert(*it, job.mScan,
+        job.mPublishIntensity ? &job.mIntensityScan : 0);
+  }
+
+  void VelodynePostNode::convertSector(ScanJob& job, size_t sector, size_t
+      numSectors) {
+    const size_t numPackets = job.mDataPackets.size();
+    ScanBuffer& scan = job.mSectorScans[sector];
+    ScanBuffer& intensityScan = job.mSectorIntensityScans[sector];
+    scan.clear();
+    intensityScan.clear();
+    scan.mStartTime = job.mDataPackets.front().getTimestamp();
+    intensityScan.mStartTime = scan.mStartTime;
+    for (size_t i = sector * numPackets / numSectors;
+        i < (sector + 1) * numPackets / numSectors; ++i)
+      _converter->convert(job.mDataPackets[i], scan,
+        job.mPublishIntensity ? &intensityScan : 0);
+  }
+
+  void VelodynePostNode::mergeSectors(ScanJob& job) {
+    job.mScan.clear();
+    job.mIntensityScan.clear();
+    job.mScan.mStartTime = job.mDataPackets.front().getTimestamp();
+    job.mIntensityScan.mStartTime = job.mScan.mStartTime;
+    for (size_t i = 0; i < job.mSectorScans.size(); ++i) {
+      job.mScan.append(job.mSectorScans[i]);
+      job.mIntensityScan.append(job.mSectorIntensityScans[i]);
+    }
+  }
+
+  void VelodynePostNode::estimateMotion(ScanJob& job) {
+    {
+      std::lock_guard<std::mutex> lock(_motionMutex);
+      _motionFrameId = job.mFrameId;
+    }
+    // the points are deskewed to the timestamp of the scan, which is its
+    // reference time for the registration
+    const int64_t time = job.mTimestamp.toNSec();
+    _motionEstimator->deskew(job.mScan, (time - job.mScan.mStartTime) * 1e-9);
+    _motionEstimator->addScan(job.mScan, time);
+  }
+
+  void VelodynePostNode::publishTwist(const MotionEstimator::Motion& motion) {
+    auto twist = boost::make_shared<geometry_msgs::TwistStamped>();
+    twist->header.stamp = ros::Time().fromNSec(motion.mTime);
+    {
+      std::lock_guard<std::mutex> lock(_motionMutex);
+      twist->header.frame_id = _motionFrameId;
+    }
+    twist->twist.linear.x = motion.mLinear[0];
+    twist->twist.linear.y = motion.mLinear[1];
+    twist->twist.linear.z = motion.mLinear[2];
+    twist->twist.angular.x = motion.mAngular[0];
+    twist->twist.angular.y = motion.mAngular[1];
+    twist->twist.angular.z = motion.mAngular[2];
+    _twistPublisher.publish(twist);
+  }
+
+  void VelodynePostNode::removeStaticReturns(ScanJob& job) {
+    // the pose at the timestamp of the scan, to which it is deskewed when
+    // the motion is estimated
+    tf::StampedTransform transform;
+    try {
+      _transformListener->waitForTransform(_staticMapFrameId, job.mFrameId,
+        job.mTimestamp, ros::Duration(_staticMapTransformTimeout));
+      _transformListener->lookupTransform(_staticMapFrameId, job.mFrameId,
+        job.mTimestamp, transform);
+    }
+    catch (const tf::TransformException& e) {
+      ++_staticMapNumMissingPoses;
+      ROS_WARN_STREAM_THROTTLE(10.0, "Scan not filtered by the static map: "
+        << e.what());
+      return;
+    }
+    StaticMap::Pose pose;
+    for (size_t i = 0; i < 3; ++i) {
+      for (size_t j = 0; j < 3; ++j)
+        pose.mRotation[3 * i + j] = transform.getBasis()[i][j];
+      pose.mTranslation[i] = transform.getOrigin()[i];
+    }
+    _staticMap->filter(job.mScan, pose);
+    ROS_DEBUG_STREAM("Static map removed " << _staticMap->getNumRemoved()
+      << " of " << _staticMap->getNumChecked() << " returns, "
+      << _staticMap->getNumLoadedTiles() << " tiles loaded");
+  }
+
+  void VelodynePostNode::filterScan(ScanJob& job) {
+    PerfCounters::Scope scope(getStagePerfCounters(), PerfCounters::convert);
+    if (_motionEstimator)
+      estimateMotion(job);
+    if (_veilingFilter) {
+      _veilingFilter->filter(job.mScan);
+      ROS_DEBUG_STREAM("Veiling filter removed "
+        << _veilingFilter->getNumRemoved() << " of "
+        << _veilingFilter->getNumChecked() << " returns ("
+        << _veilingFilter->getTotalNumRemoved() << " of "
+        << _veilingFilter->getTotalNumChecked() << " in total)");
+    }
+    if (_staticMap)
+      removeStaticReturns(job);
+    for (auto it = _stages.cbegin(); it != _stages.cend(); ++it)
+      (*it)->process(job.mScan);
+    // the filter stages of consecutive scans are ordered, so are the exports
+    if (_exporting) {
+      try {
+        _scanExporter->write(job.mScan);
+      }
+      catch (const std::runtime_error& e) {
+        ROS_ERROR_STREAM("Export disabled: " << e.what());
+        _exporting = false;
+      }
+    }
+  }
+
+  void VelodynePostNode::serializePointCloud(ScanJob& job) {
+    PerfCounters::Scope scope(getStagePerfCounters(),
+      PerfCounters::serialize);
+    job.mPointCloud = boost::make_shared<sensor_msgs::PointCloud2>();
+    job.mPointCloud->header.stamp = job.mTimestamp;
+    job.mPointCloud->header.frame_id = job.mFrameId;
+    toRosPointCloud(job.mScan, *job.mPointCloud, !_colorizers.empty());
+  }
+
+  void VelodynePostNode::serializeIntensityPointCloud(ScanJob& job) {
+    PerfCounters::Scope scope(getStagePerfCounters(),
+      PerfCounters::serialize);
+    job.mIntensityPointCloud = boost::make_shared<sensor_msgs::PointCloud2>();
+    job.mIntensityPointCloud->header.stamp = job.mTimestamp;
+    job.mIntensityPointCloud->header.frame_id = job.mFrameId;
+    toRosPointCloud(job.mIntensityScan, *job.mIntensityPointCloud,
+      !_colorizers.empty());
+  }
+
+  void VelodynePostNode::serializeAdaptivePointCloud(ScanJob& job) {
+    PerfCounters::Scope scope(getStagePerfCounters(),
+      PerfCounters::serialize);
+    const bool withColor = !_colorizers.empty();
+    // the packets span the revolution but for the last packet period
+    const double scanPeriod = (job.mDataPackets.back().getTimestamp() -
+      job.mDataPackets.front().getTimestamp()) * 1e-9 *
+      job.mDataPackets.size() / std::max<size_t>(job.mDataPackets.size() - 1,
+      1);
+    job.mAdaptiveInfo = boost::make_shared<velodyne_post::AdaptiveScanInfo>();
+    size_t level;
+    {
+      std::lock_guard<std::mutex> lock(_bandwidthMutex);
+      _bandwidthController->measure(job.mScan, withColor);
+      level = _bandwidthController->selectLevel(scanPeriod);
+      _adaptiveLevel = level;
+      job.mAdaptiveInfo->throughput = _bandwidthController->getThroughput();
+      job.mAdaptiveInfo->latency = _bandwidthController->getLatency();
+    }
+    job.mAdaptivePointCloud = boost::make_shared<sensor_msgs::PointCloud2>();
+    job.mAdaptivePointCloud->header.stamp = job.mTimestamp;
+    job.mAdaptivePointCloud->header.frame_id = job.mFrameId;
+    if (level)
+      toQuantizedRosPointCloud(job.mScan, *_bandwidthController, level,
+        *job.mAdaptivePointCloud, withColor);
+    else
+      toRosPointCloud(job.mScan, *job.mAdaptivePointCloud, withColor);
+    job.mAdaptiveInfo->header = job.mAdaptivePointCloud->header;
+    job.mAdaptiveInfo->level = level;
+    job.mAdaptiveInfo->num_levels = _bandwidthController->getNumLevels();
+    job.mAdaptiveInfo->num_points = job.mAdaptivePointCloud->width;
+    job.mAdaptiveInfo->keep_fraction = job.mScan.size() ?
+      static_cast<double>(job.mAdaptivePointCloud->width) /
+      job.mScan.size() : 1.0;
+    job.mAdaptiveInfo->resolution = _bandwidthController->getResolution(
+      level);
+    job.mAdaptiveInfo->size = job.mAdaptivePointCloud->data.size();
+  }
+
+  void VelodynePostNode::publishAdaptivePointCloud(const ScanJob& job) {
+    _adaptivePointCloudPublisher.publish(job.mAdaptivePointCloud);
+    _adaptiveInfoPublisher.publish(job.mAdaptiveInfo);
+  }
+
+  void VelodynePostNode::serializeMesh(ScanJob& job) {
+    PerfCounters::Scope scope(getStagePerfCounters(),
+      PerfCounters::serialize);
+    _meshGenerator->generate(job.mScan);
+    job.mMesh = boost::make_shared<velodyne_post::ScanMesh>();
+    job.mMesh->header.stamp = job.mTimestamp;
+    job.mMesh->header.frame_id = job.mFrameId;
+    const std::vector<uint32_t>& vertices = _meshGenerator->getVertices();
+    job.mMesh->mesh.vertices.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      geometry_msgs::Point& vertex = job.mMesh->mesh.vertices[i];
+      vertex.x = job.mScan.mX[vertices[i]];
+      vertex.y = job.mScan.mY[vertices[i]];
+      vertex.z = job.mScan.mZ[vertices[i]];
+    }
+    const std::vector<uint32_t>& triangles = _meshGenerator->getTriangles();
+    job.mMesh->mesh.triangles.resize(triangles.size() / 3);
+    for (size_t i = 0; i < job.mMesh->mesh.triangles.size(); ++i)
+      for (size_t j = 0; j < 3; ++j)
+        job.mMesh->mesh.triangles[i].vertex_indices[j] =
+          triangles[3 * i + j];
+    ROS_DEBUG_STREAM("Mesh of " << job.mMesh->mesh.triangles.size()
+      << " triangles over " << _meshGenerator->getNumColumns()
+      << " columns, " << _meshGenerator->getNumRejected() << " rejected");
+  }
+
+  void VelodynePostNode::publishDepthImage(const ScanJob& job, size_t
+      cameraIdx) {
+    const DepthImageProjector& depthProjector = *_depthProjectors[cameraIdx];
+    const CameraModel& camera = depthProjector.getCamera();
+    auto depthImage = boost::make_shared<sensor_msgs::Image>();
+    depthImage->header.stamp = job.mTimestamp;
+    depthImage->header.frame_id = camera.getFrameId();
+    depthImage->height = camera.getHeight();
+    depthImage->width = camera.getWidth();
+    depthImage->encoding = "32FC1";
+    depthImage->is_bigendian = false;
+    depthImage->step = camera.getWidth() * sizeof(float);
+    const std::vector<float>& depths = depthProjector.getDepths();
+    depthImage->data.resize(depths.size() * sizeof(float));
+    std::memcpy(depthImage->data.data(), depths.data(),
+      depthImage->data.size());
+    _depthImagePublishers[cameraIdx].publish(depthImage);
+  }
+
+  PerfCounters* VelodynePostNode::getStagePerfCounters() const {
+    // the counters are opened for the publishing thread
+    return _stagePerfCounters.get();
+  }
+
+  ros::Time VelodynePostNode::getScanTimestamp() const {
+    return ros::Time().fromNSec(_scanPackets.front().getTimestamp()
+      + std::round((_scanPackets.back().getTimestamp() -
+      _scanPackets.front().getTimestamp()) * 0.5));
+  }
+
+  bool VelodynePostNode::isOutputActive() const {
+    // the protective fields and the export run without subscribers
+    return getNumSubscribers() > 0 || _logging || _scanCache ||
+      _safetyMonitor || _exporting ||
+      (_lodServer && _lodServer->getNumClients() > 0);
+  }
+
+  void VelodynePostNode::publishStatistics(const ros::TimerEvent&
+      /*event*/) {
+    std::lock_guard<std::mutex> lock(_conversionMutex);
+    if (_laserStatisticsPublisher.getNumSubscribers() == 0) {
+      _laserStatistics->reset();
+      return;
+    }
+    auto statistics = boost::make_shared<velodyne_post::LaserStatistics>();
+    statistics->header.stamp = ros::Time::now();
+    statistics->header.frame_id = _frameId;
+    const size_t numLasers = _laserStatistics->getNumLasers();
+    statistics->num_valid_returns.resize(numLasers);
+    statistics->num_zero_returns.resize(numLasers);
+    statistics->num_out_of_range_returns.resize(numLasers);
+    statistics->mean_intensity.resize(numLasers);
+    statistics->mean_range.resize(numLasers);
+    for (size_t i = 0; i < numLasers; ++i) {
+      statistics->num_valid_returns[i] = _laserStatistics->getNumValid(i);
+      statistics->num_zero_returns[i] = _laserStatistics->getNumZero(i);
+      statistics->num_out_of_range_returns[i] =
+        _laserStatistics->getNumOutOfRange(i);
+      statistics->mean_intensity[i] = _laserStatistics->getMeanIntensity(i);
+      statistics->mean_range[i] = _laserStatistics->getMeanRange(i);
+    }
+    _laserStatistics->reset();
+    _laserStatisticsPublisher.publish(statistics);
+  }
+
+  bool VelodynePostNode::queryRegion(velodyne_post::QueryRegion::Request&
+      request, velodyne_post::QueryRegion::Response& response) {
+    ScanCache::Region region;
+    region.mHasBox = request.box_min.x < request.box_max.x &&
+      request.box_min.y < request.box_max.y &&
+      request.box_min.z < request.box_max.z;
+    region.mBoxMin[0] = request.box_min.x;
+    region.mBoxMin[1] = request.box_min.y;
+    region.mBoxMin[2] = request.box_min.z;
+    region.mBoxMax[0] = request.box_max.x;
+    region.mBoxMax[1] = request.box_max.y;
+    region.mBoxMax[2] = request.box_max.z;
+    region.mHasSector = request.sector_start != request.sector_end;
+    region.mSectorStart = request.sector_start;
+    region.mSectorEnd = request.sector_end;
+    region.mHasTimeWindow = !request.end_time.isZero();
+    region.mStartTime = request.start_time.toNSec();
+    region.mEndTime = request.end_time.toNSec();
+    ScanBuffer scan;
+    {
+      std::lock_guard<std::mutex> lock(_cacheMutex);
+      response.num_blocks = _scanCache->query(region, *_converter,
+        request.num_scans, scan);
+    }
+    response.point_cloud.header.stamp = ros::Time::now();
+    response.point_cloud.header.frame_id = _frameId;
+    toRosPointCloud(scan, response.point_cloud);
+    return true;
+  }
+
+  void VelodynePostNode::autotune() {
+    _autotuningCpuModel = ConversionAutotuner::getCpuModel();
+    // the colorizers always disable the sectors, the depth images and the
+    // statistics only while subscribed
+    const bool sectorConversion = _colorizers.empty();
+    _autotuningCacheKey = ConversionAutotuner::getCacheKey(
+      _autotuningCpuModel, _deviceName, _numDataPackets, sectorConversion);
+    _autotuningCached = ConversionAutotuner::loadCache(
+      _autotuningCacheFileName, _autotuningCacheKey, _autotunedConfiguration);
+    if (!_autotuningCached) {
+      ROS_INFO_STREAM("Autotuning the conversion for "
+        << _autotuningCacheKey);
+      ConversionAutotuner autotuner(*_converter, _numDataPackets,
+        sectorConversion);
+      _autotunedConfiguration = autotuner.tune(_autotuningBudget);
+      if (!ConversionAutotuner::saveCache(_autotuningCacheFileName,
+          _autotuningCacheKey, _autotunedConfiguration))
+        ROS_WARN_STREAM("Cannot write autotuning cache "
+          << _autotuningCacheFileName);
+    }
+    _schedulerNumThreads = _autotunedConfiguration.mNumThreads;
+    _schedulerNumSectors = _autotunedConfiguration.mNumSectors;
+    ROS_INFO_STREAM("Conversion with " << _schedulerNumThreads
+      << " threads and " << _schedulerNumSectors << " sectors ("
+      << _autotunedConfiguration.mThroughput * 1e-6 << " Mpoints/s"
+      << (_autotuningCached ? ", cached)" : ")"));
+    _updater.add("Autotuning", this, &VelodynePostNode::diagnoseAutotuning);
+  }
+
+  void VelodynePostNode::diagnoseAutotuning(
+      diagnostic_updater::DiagnosticStatusWrapper& status) {
+    status.summary(diagnostic_msgs::DiagnosticStatus::OK,
+      _autotuningCached ? "Configuration from cache" :
+      "Configuration from startup benchmark");
+    status.add("CPU model", _autotuningCpuModel);
+    status.add("Cache key", _autotuningCacheKey);
+    status.add("Threads", _autotunedConfiguration.mNumThreads);
+    status.add("Sectors", _autotunedConfiguration.mNumSectors);
+    status.add("Throughput [points/s]", _autotunedConfiguration.mThroughput);
+  }
+
+  void VelodynePostNode::bindToNumaNode() {
+    if (!_numaTopology->bindThread(_numaNode))
+      ROS_WARN_STREAM("Cannot bind thread to NUMA node " << _numaNode);
+  }
+
+  void VelodynePostNode::touchJob(ScanJob& job) {
+    NumaTopology::touch(job.mDataPackets.data(),
+      job.mDataPackets.capacity() * sizeof(DataPacket));
+    ScanBuffer& scan = job.mScan;
+    NumaTopology::touch(scan.mX.data(), scan.mX.capacity() * sizeof(float));
+    NumaTopology::touch(scan.mY.data(), scan.mY.capacity() * sizeof(float));
+    NumaTopology::touch(scan.mZ.data(), scan.mZ.capacity() * sizeof(float));
+    NumaTopology::touch(scan.mIntensity.data(),
+      scan.mIntensity.capacity() * sizeof(float));
+    NumaTopology::touch(scan.mRange.data(),
+      scan.mRange.capacity() * sizeof(float));
+    NumaTopology::touch(scan.mRing.data(),
+      scan.mRing.capacity() * sizeof(uint16_t));
+    NumaTopology::touch(scan.mAzimuth.data(),
+      scan.mAzimuth.capacity() * sizeof(uint16_t));
+    NumaTopology::touch(scan.mTime.data(),
+      scan.mTime.capacity() * sizeof(float));
+    NumaTopology::touch(scan.mRgb.data(),
+      scan.mRgb.capacity() * sizeof(uint32_t));
+  }
+
+  void VelodynePostNode::diagnoseAdaptiveOutput(
+      diagnostic_updater::DiagnosticStatusWrapper& status) {
+    std::lock_guard<std::mutex> lock(_bandwidthMutex);
+    const size_t numLevels = _bandwidthController->getNumLevels();
+    if (_adaptiveLevel + 1 == numLevels &&
+        _bandwidthController->getLatency() > _adaptiveOutputTargetLatency)
+      status.summary(diagnostic_msgs::DiagnosticStatus::WARN,
+        "Target latency missed at the coarsest level");
+    else
+      status.summary(diagnostic_msgs::DiagnosticStatus::OK,
+        "Resolution adapted to the link");
+    status.add("Level", _adaptiveLevel);
+    status.add("Levels", numLevels);
+    status.add("Throughput [Mbit/s]", _bandwidthController->getThroughput() *
+      8e-6);
+    status.add("Latency [s]", _bandwidthController->getLatency());
+  }
+
+  void VelodynePostNode::diagnosePublication(
+      diagnostic_updater::DiagnosticStatusWrapper& status) {
+    std::lock_guard<std::mutex> lock(_scanMutex);
+    status.summary(diagnostic_msgs::DiagnosticStatus::OK,
+      "Revolutions published off the packet callbacks");
+    status.add("Revolutions skipped by the busy publishing thread",
+      _numSkippedScans);
+  }
+
+  void VelodynePostNode::diagnoseFailover(
+      diagnostic_updater::DiagnosticStatusWrapper& status) {
+    status.summary(diagnostic_msgs::DiagnosticStatus::OK, _standby ?
+      "Standby" : "Primary");
+    status.add("Primary pid", _failoverChannel->getPrimaryPid());
+    status.add("Takeovers", _failoverChannel->getNumTakeovers());
+    status.add("Packets in progress", _dataPackets.size());
+  }
+
+  void VelodynePostNode::diagnoseStaticMap(
+      diagnostic_updater::DiagnosticStatusWrapper& status) {
+    const size_t numMissingPoses = _staticMapNumMissingPoses.exchange(0);
+    if (numMissingPoses)
+      status.summary(diagnostic_msgs::DiagnosticStatus::WARN,
+        "Scans passed unfiltered for lack of a pose");
+    else
+      status.summary(diagnostic_msgs::DiagnosticStatus::OK,
+        "Static returns removed");
+    status.add("Static returns removed", _staticMap->getTotalNumRemoved());
+    status.add("Returns checked", _staticMap->getTotalNumChecked());
+    status.add("Scans without pose", numMissingPoses);
+    status.add("Tiles loaded", _staticMap->getNumLoadedTiles());
+    status.add("Tiles in map", _staticMap->getNumTiles());
+    status.add("Tile loads", _staticMap->getTotalNumLoads());
+  }
+
+  void VelodynePostNode::diagnoseMotionEstimation(
+      diagnostic_updater::DiagnosticStatusWrapper& status) {
+    MotionEstimator::Motion motion;
+    if (_motionEstimator->getMotion(motion)) {
+      status.summary(diagnostic_msgs::DiagnosticStatus::OK,
+        "Scans deskewed with the estimated velocity");
+      status.add("Speed [m/s]", std::sqrt(motion.mLinear[0] *
+        motion.mLinear[0] + motion.mLinear[1] * motion.mLinear[1] +
+        motion.mLinear[2] * motion.mLinear[2]));
+      status.add("Yaw rate [rad/s]", motion.mAngular[2]);
+      status.add("Correspondences", motion.mNumCorrespondences);
+      status.add("Iterations", motion.mNumIterations);
+      status.add("RMS error [m]", motion.mRmsError);
+    }
+    else
+      status.summary(diagnostic_msgs::DiagnosticStatus::WARN,
+        "No velocity, scans are not deskewed");
+    status.add("Registered scans", _motionEstimator->getNumRegistered());
+    status.add("Failed registrations", _motionEstimator->getNumFailed());
+    status.add("Scans dropped by the busy estimator",
+      _motionEstimator->getNumDropped());
+  }
+
+  void VelodynePostNode::diagnoseSafetyFields(
+      diagnostic_updater::DiagnosticStatusWrapper& status) {
+    const uint32_t violatedFields = _safetyMonitor->getViolatedFields();
+    if (violatedFields)
+      status.summary(diagnostic_msgs::DiagnosticStatus::WARN,
+        "Protective field violated");
+    else
+      status.summary(diagnostic_msgs::DiagnosticStatus::OK,
+        "Protective fields clear");
+    const std::vector<SafetyMonitor::Field>& fields =
+      _safetyMonitor->getFields();
+    for (size_t i = 0; i < fields.size(); ++i) {
+      std::stringstream stream;
+      stream << ((violatedFields >> i) & 1 ? "violated" : "clear") << ", "
+        << _safetyMonitor->getNumViolations()[i] << " violations";
+      status.add(fields[i].mName, stream.str());
+    }
+  }
+
+  void VelodynePostNode::diagnoseStreaming(
+      diagnostic_updater::DiagnosticStatusWrapper& status) {
+    status.summary(diagnostic_msgs::DiagnosticStatus::OK,
+      "Level-of-detail streaming");
+    status.add("Address", _lodServer->getAddress());
+    status.add("Port", _lodServer->getPort());
+    status.add("Clients", _lodServer->getNumClients());
+    status.add("Sent bytes", _lodServer->getNumSentBytes());
+    status.add("Frames skipped by slow clients",
+      _lodServer->getNumSkippedFrames());
+  }
+
+  void VelodynePostNode::diagnoseNuma(
+      diagnostic_updater::DiagnosticStatusWrapper& status) {
+    const int currentNode = _numaTopology->getCurrentNode();
+    const std::vector<uint64_t> pages = _numaTopology->readProcessPages();
+    uint64_t numPages = 0;
+    for (auto it = pages.cbegin(); it != pages.cend(); ++it)
+      numPages += *it;
+    const uint64_t numRemotePages = numPages -
+      (static_cast<size_t>(_numaNode) < pages.size() ? pages[_numaNode] : 0);
+    if (!_numaTopology->isAvailable())
+      status.summary(diagnostic_msgs::DiagnosticStatus::WARN,
+        "NUMA topology unavailable");
+    else if (currentNode != _numaNode)
+      status.summary(diagnostic_msgs::DiagnosticStatus::WARN,
+        "Node thread runs outside its NUMA node");
+    else
+      status.summary(diagnostic_msgs::DiagnosticStatus::OK,
+        "Threads bound to their NUMA node");
+    status.add("Node", _numaNode);
+    status.add("Current node", currentNode);
+    status.add("Resident pages", numPages);
+    status.add("Remote resident pages", numRemotePages);
+    if (numPages)
+      status.add("Remote resident ratio",
+        static_cast<double>(numRemotePages) / numPages);
+    // the allocation counters are system-wide, they include other processes
+    NumaTopology::Counters counters;
+    if (_numaTopology->readCounters(_numaNode, counters)) {
+      status.add("Local allocations since last update",
+        counters.mLocal - _numaCounters.mLocal);
+      status.add("Allocations from other nodes since last update",
+        counters.mOther - _numaCounters.mOther);
+      status.add("Allocations missing their node since last update",
+        counters.mMiss - _numaCounters.mMiss);
+      status.add("Allocations spilled to other nodes since last update",
+        counters.mForeign - _numaCounters.mForeign);
+      _numaCounters = counters;
+    }
+  }
+
+  void VelodynePostNode::diagnoseHardwareCounters(
+      diagnostic_updater::DiagnosticStatusWrapper& status) {
+    if (!_perfCounters->isAvailable()) {
+      status.summary(diagnostic_msgs::DiagnosticStatus::OK,
+        "Hardware counters unavailable");
+      return;
+    }
+    status.summary(diagnostic_msgs::DiagnosticStatus::OK,
+      "Hardware counters per stage since last update");
+    const double numPoints = _perfCounters->getNumPoints();
+    status.add("Points", numPoints);
+    // the publishing thread hands over the counters of the stages it ran
+    PerfCounters::Totals stageTotals[PerfCounters::numStages];
+    {
+      std::lock_guard<std::mutex> lock(_scanMutex);
+      std::memcpy(stageTotals, _stageTotals, sizeof(stageTotals));
+      std::memset(_stageTotals, 0, sizeof(_stageTotals));
+    }
+    for (size_t i = 0; i < PerfCounters::numStages; ++i) {
+      const PerfCounters::Stage stage = static_cast<PerfCounters::Stage>(i);
+      PerfCounters::Totals totals = _perfCounters->getTotals(stage);
+      for (size_t j = 0; j < PerfCounters::numCounters; ++j)
+        totals.mValues[j] += stageTotals[i].mValues[j];
+      totals.mNumSamples += stageTotals[i].mNumSamples;
+      if (!totals.mNumSamples)
+        continue;
+      const std::string name = PerfCounters::getStageName(stage);
+      const double cycles = totals.mValues[PerfCounters::cycles];
+      if (_perfCounters->isAvailable(PerfCounters::cycles)) {
+        status.add(name + " cycles", cycles);
+        if (numPoints > 0)
+          status.add(name + " cycles per point", cycles / numPoints);
+      }
+      if (_perfCounters->isAvailable(PerfCounters::instructions) &&
+          cycles > 0)
+        status.add(name + " IPC",
+          totals.mValues[PerfCounters::instructions] / cycles);
+      if (_perfCounters->isAvailable(PerfCounters::cacheMisses) &&
+          numPoints > 0)
+        status.add(name + " LLC misses per point",
+          totals.mValues[PerfCounters::cacheMisses] / numPoints);
+      if (_perfCounters->isAvailable(PerfCounters::branchMisses) &&
+          numPoints > 0)
+        status.add(name + " branch misses per point",
+          totals.mValues[PerfCounters::branchMisses] / numPoints);
+    }
+    _perfCounters->reset();
+  }
+
+  uint32_t VelodynePostNode::getNumSubscribers() const {
+    uint32_t numSubscribers = _pointCloudPublisher.getNumSubscribers();
+    if (_intensityExtractionEnabled)
+      numSubscribers += _intensityPointCloudPublisher.getNumSubscribers();
+    if (_statisticsEnabled)
+      numSubscribers += _laserStatisticsPublisher.getNumSubscribers();
+    if (_meshingEnabled)
+      numSubscribers += _meshPublisher.getNumSubscribers();
+    if (_motionEstimationEnabled)
+      numSubscribers += _twistPublisher.getNumSubscribers();
+    if (_bandwidthController)
+      numSubscribers += _adaptivePointCloudPublisher.getNumSubscribers();
+    for (auto it = _depthImagePublishers.cbegin();
+        it != _depthImagePublishers.cend(); ++it)
+      numSubscribers += it->getNumSubscribers();
+    return numSubscribers;
+  }
+
+  void VelodynePostNode::toRosPointCloud(const ScanBuffer& scan,
+      sensor_msgs::PointCloud2& pointCloud, bool withColor) {
+    // rgb is packed as 0x00RRGGBB into a float, following PCL
+    static const char* fieldNames[] = {"x", "y", "z", "intensity", "rgb"};
+    const size_t numFields = withColor ? 5 : 4;
+    pointCloud.fields.resize(numFields);
+    for (size_t i = 0; i < numFields; ++i) {
+      pointCloud.fields[i].name = fieldNames[i];
+      pointCloud.fields[i].offset = i * sizeof(float);
+      pointCloud.fields[i].datatype = sensor_msgs::PointField::FLOAT32;
+      pointCloud.fields[i].count = 1;
+    }
+    const size_t numPoints = scan.size();
+    pointCloud.height = 1;
+    pointCloud.width = numPoints;
+    pointCloud.is_bigendian = false;
+    pointCloud.point_step = numFields * sizeof(float);
+    pointCloud.row_step = pointCloud.point_step * numPoints;
+    pointCloud.is_dense = true;
+    pointCloud.data.resize(pointCloud.row_step);
+    float* data = reinterpret_cast<float*>(pointCloud.data.data());
+    for (size_t i = 0; i < numPoints; ++i) {
+      *data++ = scan.mX[i];
+      *data++ = scan.mY[i];
+      *data++ = scan.mZ[i];
+      *data++ = scan.mIntensity[i];
+      if (withColor)
+        std::memcpy(data++, &scan.mRgb[i], sizeof(float));
+    }
+  }
+
+  void VelodynePostNode::toQuantizedRosPointCloud(const ScanBuffer& scan,
+      const BandwidthController& controller, size_t level,
+      sensor_msgs::PointCloud2& pointCloud, bool withColor) {
+    // int16 positions in units of the resolution reported in the scan info,
+    // not named x, y and z such that generic consumers do not read them as
+    // meters, rgb is packed into an aligned float as in toRosPointCloud
+    static const char* fieldNames[] = {"qx", "qy", "qz", "intensity", "rgb"};
+    static const uint8_t dataTypes[] = {sensor_msgs::PointField::INT16,
+      sensor_msgs::PointField::INT16, sensor_msgs::PointField::INT16,
+      sensor_msgs::PointField::UINT8, sensor_msgs::PointField::FLOAT32};
+    static const uint32_t offsets[] = {0, 2, 4, 6, 8};
+    const size_t numFields = withColor ? 5 : 4;
+    pointCloud.fields.resize(numFields);
+    for (size_t i = 0; i < numFields; ++i) {
+      pointCloud.fields[i].name = fieldNames[i];
+      pointCloud.fields[i].offset = offsets[i];
+      pointCloud.fields[i].datatype = dataTypes[i];
+      pointCloud.fields[i].count = 1;
+    }
+    const size_t numPoints = controller.getNumPoints(level);
+    pointCloud.height = 1;
+    pointCloud.width = numPoints;
+    pointCloud.is_bigendian = false;
+    pointCloud.point_step = BandwidthController::getPointSize(level,
+      withColor);
+    pointCloud.row_step = pointCloud.point_step * numPoints;
+    pointCloud.is_dense = true;
+    pointCloud.data.resize(pointCloud.row_step);
+    const float scale = 1.0 / controller.getResolution(level);
+    uint8_t* data = pointCloud.data.data();
+    for (size_t i = 0; i < scan.size(); ++i) {
+      if (!controller.keep(i, level))
+        continue;
+      const int16_t position[3] = {
+        static_cast<int16_t>(std::max(-32767.0f, std::min(32767.0f,
+          std::round(scan.mX[i] * scale)))),
+        static_cast<int16_t>(std::max(-32767.0f, std::min(32767.0f,
+          std::round(scan.mY[i] * scale)))),
+        static_cast<int16_t>(std::max(-32767.0f, std::min(32767.0f,
+          std::round(scan.mZ[i] * scale))))};
+      std::memcpy(data, position, sizeof(position));
+      data[6] = std::max(0.0f, std::min(255.0f,
+        std::round(scan.mIntensity[i])));
+      if (withColor) {
+        data[7] = 0;
+        std::memcpy(data + 8, &scan.mRgb[i], sizeof(float));
+      }
+      data += pointCloud.point_step;
+    }
   }
 
   void VelodynePostNode::spin() {
@@ -159,20 +1560,125 @@ namespace velodyne {
     _nodeHandle.param<double>("sensor/max_distance", _maxDistance, 120.0);
     _nodeHandle.param<std::string>("sensor/device_name", _deviceName,
       "Velodyne HDL-32E");
+    _nodeHandle.param<std::string>("sensor/return_mode", _returnMode,
+      "single");
+    _nodeHandle.param<std::string>("sensor/return_selection",
+      _returnSelection, "strongest");
     if (_deviceName == "Velodyne HDL-64E S2")
       _nodeHandle.param<std::string>("sensor/calibration_file", _calibFileName,
         "conf/calib-HDL-64E.dat");
     else if (_deviceName == "Velodyne HDL-32E")
       _nodeHandle.param<std::string>("sensor/calibration_file", _calibFileName,
         "conf/calib-HDL-32E.dat");
+    else if (_deviceName == "Velodyne VLP-16")
+      _nodeHandle.param<std::string>("sensor/calibration_file", _calibFileName,
+        "conf/calib-VLP-16.dat");
+    else if (_deviceName == "Velodyne VLP-32C")
+      _nodeHandle.param<std::string>("sensor/calibration_file", _calibFileName,
+        "conf/calib-VLP-32C.dat");
     else
       ROS_ERROR_STREAM("Unknown device: " << _deviceName);
+    _nodeHandle.param<bool>("downsampling/enable", _downsamplingEnabled,
+      false);
+    _nodeHandle.param<double>("downsampling/reference_distance",
+      _downsamplingReferenceDistance, 10.0);
+    _nodeHandle.param<double>("downsampling/min_keep_probability",
+      _downsamplingMinKeepProbability, 0.1);
+    _nodeHandle.getParam("downsampling/laser_weights",
+      _downsamplingLaserWeights);
+    _nodeHandle.param<bool>("veiling_filter/enable", _veilingFilterEnabled,
+      false);
+    _nodeHandle.param<double>("veiling_filter/max_incidence_angle",
+      _veilingFilterMaxIncidenceAngle, 10.0);
+    _nodeHandle.param<double>("veiling_filter/max_azimuth_gap",
+      _veilingFilterMaxAzimuthGap, 0.5);
+    _nodeHandle.param<bool>("failover/enable", _failoverEnabled, false);
+    _nodeHandle.param<std::string>("failover/shm_name", _failoverShmName,
+      "/velodyne_post");
+    _nodeHandle.param<double>("failover/heartbeat_timeout",
+      _failoverHeartbeatTimeout, 0.05);
+    _nodeHandle.param<std::string>("static_map/file_name",
+      _staticMapFileName, "");
+    _nodeHandle.param<std::string>("static_map/frame_id", _staticMapFrameId,
+      "map");
+    _nodeHandle.param<double>("static_map/transform_timeout",
+      _staticMapTransformTimeout, 0.05);
+    _nodeHandle.param<int>("static_map/max_idle_scans",
+      _staticMapMaxIdleScans, 50);
+    _nodeHandle.param<bool>("meshing/enable", _meshingEnabled, false);
+    _nodeHandle.param<double>("meshing/max_range_ratio",
+      _meshingMaxRangeRatio, 1.2);
+    _nodeHandle.param<double>("meshing/max_incidence_angle",
+      _meshingMaxIncidenceAngle, 85.0);
+    _nodeHandle.param<double>("meshing/max_azimuth_gap",
+      _meshingMaxAzimuthGap, 1.0);
+    _nodeHandle.param<bool>("adaptive_output/enable", _adaptiveOutputEnabled,
+      false);
+    _nodeHandle.param<int>("adaptive_output/num_levels",
+      _adaptiveOutputNumLevels, 8);
+    _nodeHandle.param<double>("adaptive_output/target_latency",
+      _adaptiveOutputTargetLatency, 0.3);
+    _nodeHandle.param<double>("adaptive_output/reference_distance",
+      _adaptiveOutputReferenceDistance, 10.0);
+    _nodeHandle.param<double>("adaptive_output/min_keep_probability",
+      _adaptiveOutputMinKeepProbability, 0.1);
+    _nodeHandle.param<double>("adaptive_output/resolution",
+      _adaptiveOutputResolution, 0.01);
+    _nodeHandle.param<double>("adaptive_output/initial_throughput",
+      _adaptiveOutputInitialThroughput, 1.25e6);
+    _nodeHandle.param<double>("adaptive_output/probe_factor",
+      _adaptiveOutputProbeFactor, 1.25);
+    _nodeHandle.param<bool>("motion_estimation/enable",
+      _motionEstimationEnabled, false);
+    _nodeHandle.param<int>("motion_estimation/column_stride",
+      _motionEstimationColumnStride, 4);
+    _nodeHandle.param<int>("motion_estimation/max_iterations",
+      _motionEstimationMaxIterations, 10);
+    _nodeHandle.param<double>("motion_estimation/max_correspondence_distance",
+      _motionEstimationMaxCorrespondenceDistance, 0.5);
+    _nodeHandle.param<double>("motion_estimation/huber_threshold",
+      _motionEstimationHuberThreshold, 0.1);
+    _nodeHandle.param<int>("motion_estimation/min_correspondences",
+      _motionEstimationMinCorrespondences, 200);
+    _nodeHandle.param<double>("motion_estimation/max_scan_gap",
+      _motionEstimationMaxScanGap, 0.3);
+    _nodeHandle.param<bool>("intensity_extraction/enable",
+      _intensityExtractionEnabled, false);
+    _nodeHandle.param<double>("intensity_extraction/default_threshold",
+      _intensityExtractionDefaultThreshold, 200.0);
+    _nodeHandle.param<std::string>("intensity_extraction/return_selection",
+      _intensityExtractionReturnSelection, "strongest");
+    _nodeHandle.getParam("intensity_extraction/laser_thresholds",
+      _intensityExtractionLaserThresholds);
+    _nodeHandle.param<bool>("intensity_extraction/normalize_by_distance",
+      _intensityExtractionNormalizeByDistance, false);
+    _nodeHandle.param<double>("intensity_extraction/reference_distance",
+      _intensityExtractionReferenceDistance, 10.0);
+    _nodeHandle.param<bool>("statistics/enable", _statisticsEnabled, false);
+    _nodeHandle.param<double>("statistics/publish_rate",
+      _statisticsPublishRate, 0.2);
+    _nodeHandle.param<int>("colorization/num_images", _colorizationNumImages,
+      4);
+    _nodeHandle.param<double>("colorization/max_time_offset",
+      _colorizationMaxTimeOffset, 0.05);
     _nodeHandle.param<std::string>("ros/velodyne_binary_snappy_topic_name",
       _velodyneBinarySnappyTopicName, "/velodyne/binary_snappy");
     _nodeHandle.param<std::string>("ros/velodyne_data_packet_topic_name",
       _velodyneDataPacketTopicName, "/velodyne/data_packet");
     _nodeHandle.param<std::string>("ros/point_cloud_topic_name",
       _pointCloudTopicName, "point_cloud");
+    _nodeHandle.param<std::string>("ros/intensity_point_cloud_topic_name",
+      _intensityPointCloudTopicName, "intensity_point_cloud");
+    _nodeHandle.param<std::string>("ros/laser_statistics_topic_name",
+      _laserStatisticsTopicName, "laser_statistics");
+    _nodeHandle.param<std::string>("ros/mesh_topic_name", _meshTopicName,
+      "mesh");
+    _nodeHandle.param<std::string>("ros/twist_topic_name", _twistTopicName,
+      "twist");
+    _nodeHandle.param<std::string>("ros/adaptive_point_cloud_topic_name",
+      _adaptivePointCloudTopicName, "adaptive_point_cloud");
+    _nodeHandle.param<std::string>("ros/adaptive_point_cloud_info_topic_name",
+      _adaptiveInfoTopicName, "adaptive_point_cloud_info");
     _nodeHandle.param<bool>("ros/use_binary_snappy", _useBinarySnappy, true);
     _nodeHandle.param<int>("ros/queue_depth", _queueDepth, 100);
     _nodeHandle.param<std::string>("ros/transport_type", _transportType, "udp");
@@ -180,18 +1686,168 @@ namespace velodyne {
       _nodeHandle.param<int>("ros/num_data_packets", _numDataPackets, 348);
     else if (_deviceName == "Velodyne HDL-32E")
       _nodeHandle.param<int>("ros/num_data_packets", _numDataPackets, 174);
+    else if (_deviceName == "Velodyne VLP-16")
+      _nodeHandle.param<int>("ros/num_data_packets", _numDataPackets, 75);
+    else if (_deviceName == "Velodyne VLP-32C")
+      _nodeHandle.param<int>("ros/num_data_packets", _numDataPackets, 151);
+    _nodeHandle.param<bool>("profiling/hardware_counters",
+      _hardwareCountersEnabled, false);
+    _nodeHandle.param<int>("cache/num_scans", _cacheNumScans, 0);
+    _nodeHandle.param<double>("safety_fields/azimuth_resolution",
+      _safetyAzimuthResolution, 0.1);
+    _nodeHandle.param<int>("safety_fields/min_returns", _safetyMinReturns,
+      3);
+    _nodeHandle.param<double>("safety_fields/clear_delay", _safetyClearDelay,
+      0.2);
+    _nodeHandle.param<std::string>("ros/safety_status_topic_name",
+      _safetyStatusTopicName, "safety_status");
+    _nodeHandle.param<std::string>("ros/query_region_service_name",
+      _queryRegionServiceName, "query_region");
+    _nodeHandle.param<int>("scheduler/num_threads", _schedulerNumThreads, 0);
+    _nodeHandle.param<int>("scheduler/num_sectors", _schedulerNumSectors, 0);
+    _nodeHandle.param<int>("scheduler/max_scans_in_flight",
+      _schedulerMaxScansInFlight, 2);
+    _nodeHandle.param<std::string>("export/file_name", _exportFileName, "");
+    _nodeHandle.param<std::string>("export/format", _exportFormat,
+      "parquet");
+    _nodeHandle.param<bool>("streaming/enable", _streamingEnabled, false);
+    _nodeHandle.param<std::string>("streaming/bind_address",
+      _streamingBindAddress, "127.0.0.1");
+    _nodeHandle.param<int>("streaming/port", _streamingPort, 9001);
+    _nodeHandle.param<double>("streaming/voxel_size", _streamingVoxelSize,
+      1.6);
+    _nodeHandle.param<int>("streaming/num_levels", _streamingNumLevels, 4);
+    _nodeHandle.param<int>("streaming/max_clients", _streamingMaxClients, 8);
+    _nodeHandle.param<int>("numa/node", _numaNode, -1);
+    _nodeHandle.param<bool>("numa/first_touch", _numaFirstTouch, true);
+    _nodeHandle.param<bool>("autotuning/enable", _autotuningEnabled, false);
+    _nodeHandle.param<double>("autotuning/budget", _autotuningBudget, 0.3);
+    const char* home = std::getenv("ROS_HOME");
+    const std::string rosHome = home ? home :
+      std::string(std::getenv("HOME") ? std::getenv("HOME") : ".") + "/.ros";
+    _nodeHandle.param<std::string>("autotuning/cache_file",
+      _autotuningCacheFileName, rosHome + "/velodyne_post_autotuning.cache");
+    _nodeHandle.param<bool>("logging/enable", _loggingEnabled, false);
+    _nodeHandle.param<std::string>("logging/file_name", _logFileName,
+      "velodyne.vpl");
     double rate;
     _nodeHandle.param<double>("ros/subscription_updater_rate", rate, 1.0);
     _timer = _nodeHandle.createTimer(ros::Duration(1.0 / rate),
       &VelodynePostNode::updateSubscription, this);
   }
 
+  void VelodynePostNode::loadStages(const std::string& name) {
+    XmlRpc::XmlRpcValue list;
+    if (!_nodeHandle.getParam(name, list))
+      return;
+    if (list.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+      ROS_ERROR_STREAM("Parameter " << name << " is not a list");
+      return;
+    }
+    for (int i = 0; i < list.size(); ++i) {
+      XmlRpc::XmlRpcValue& stage = list[i];
+      if (stage.getType() != XmlRpc::XmlRpcValue::TypeStruct ||
+          !stage.hasMember("name") || !stage.hasMember("type")) {
+        ROS_ERROR_STREAM("Invalid stage " << i << " in " << name);
+        continue;
+      }
+      const std::string stageName = stage["name"];
+      const std::string stageType = stage["type"];
+      try {
+        boost::shared_ptr<ScanStage> scanStage =
+          _stageLoader.createInstance(stageType);
+        scanStage->initialize(ros::NodeHandle(_nodeHandle, stageName),
+          *_converter);
+        _stages.push_back(scanStage);
+        ROS_INFO_STREAM("Loaded stage " << stageName << " of type "
+          << stageType);
+      }
+      catch (const pluginlib::PluginlibException& e) {
+        ROS_ERROR_STREAM("Failed to load stage " << stageName << ": "
+          << e.what());
+      }
+    }
+  }
+
+  void VelodynePostNode::getCameraParameters(const std::string& name,
+      std::vector<CameraModel>& cameras) {
+    XmlRpc::XmlRpcValue list;
+    if (!_nodeHandle.getParam(name, list))
+      return;
+    if (list.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+      ROS_ERROR_STREAM("Parameter " << name << " is not a list");
+      return;
+    }
+    double margin;
+    _nodeHandle.param<double>("sensor/camera_azimuth_margin", margin, 2.0);
+    margin = margin * M_PI / 180.0 + _converter->getAzimuthMargin();
+    static const char* members[] = {"name", "frame_id", "width", "height",
+      "fx", "fy", "cx", "cy", "translation", "rotation"};
+    for (int i = 0; i < list.size(); ++i) {
+      XmlRpc::XmlRpcValue& camera = list[i];
+      bool valid = camera.getType() == XmlRpc::XmlRpcValue::TypeStruct;
+      for (size_t j = 0; valid && j < sizeof(members) / sizeof(members[0]);
+          ++j)
+        valid = camera.hasMember(members[j]);
+      if (!valid || camera["translation"].size() != 3 ||
+          camera["rotation"].size() != 4) {
+        ROS_ERROR_STREAM("Invalid camera " << i << " in " << name);
+        continue;
+      }
+      double translation[3];
+      for (int j = 0; j < 3; ++j)
+        translation[j] = toDouble(camera["translation"][j]);
+      double rotation[4];
+      for (int j = 0; j < 4; ++j)
+        rotation[j] = toDouble(camera["rotation"][j]);
+      cameras.push_back(CameraModel(camera["name"], camera["frame_id"],
+        static_cast<int>(camera["width"]), static_cast<int>(camera["height"]),
+        toDouble(camera["fx"]), toDouble(camera["fy"]),
+        toDouble(camera["cx"]), toDouble(camera["cy"]), translation,
+        rotation, margin, _minDistance));
+    }
+  }
+
+  void VelodynePostNode::getSafetyFieldParameters(const std::string& name,
+      std::vector<SafetyMonitor::Field>& fields) {
+    XmlRpc::XmlRpcValue list;
+    if (!_nodeHandle.getParam(name, list))
+      return;
+    if (list.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+      ROS_ERROR_STREAM("Parameter " << name << " is not a list");
+      return;
+    }
+    for (int i = 0; i < list.size(); ++i) {
+      XmlRpc::XmlRpcValue& field = list[i];
+      bool valid = field.getType() == XmlRpc::XmlRpcValue::TypeStruct &&
+        field.hasMember("name") && field.hasMember("polygon") &&
+        field["polygon"].getType() == XmlRpc::XmlRpcValue::TypeArray &&
+        field["polygon"].size() >= 3;
+      for (int j = 0; valid && j < field["polygon"].size(); ++j)
+        valid = field["polygon"][j].size() == 2;
+      if (!valid) {
+        ROS_ERROR_STREAM("Invalid safety field " << i << " in " << name);
+        continue;
+      }
+      // fields without height limits are 2D
+      SafetyMonitor::Field safetyField;
+      safetyField.mName = static_cast<std::string&>(field["name"]);
+      for (int j = 0; j < field["polygon"].size(); ++j) {
+        safetyField.mX.push_back(toDouble(field["polygon"][j][0]));
+        safetyField.mY.push_back(toDouble(field["polygon"][j][1]));
+      }
+      safetyField.mMinZ = field.hasMember("min_z") ?
+        toDouble(field["min_z"]) : -std::numeric_limits<double>::infinity();
+      safetyField.mMaxZ = field.hasMember("max_z") ?
+        toDouble(field["max_z"]) : std::numeric_limits<double>::infinity();
+      fields.push_back(safetyField);
+    }
+  }
+
   void VelodynePostNode::updateSubscription(const ros::TimerEvent& /*event*/) {
-    if (_subscriptionIsActive &&
-        _pointCloudPublisher.getNumSubscribers() == 0)
+    if (_subscriptionIsActive && !isOutputActive())
       shutdownSubscribers();
-    else if (!_subscriptionIsActive &&
-        _pointCloudPublisher.getNumSubscribers() > 0)
+    else if (!_subscriptionIsActive && isOutputActive())
       initSubscribers();
   }
 
@@ -206,6 +1862,11 @@ namespace velodyne {
         _nodeHandle.subscribe(_velodyneDataPacketTopicName,
         _queueDepth, &VelodynePostNode::velodyneDataPacketCallback, this,
         _transportHints);
+    _imageSubscribers.resize(_colorizers.size());
+    for (size_t i = 0; i < _colorizers.size(); ++i)
+      _imageSubscribers[i] = _nodeHandle.subscribe<sensor_msgs::Image>(
+        _colorizers[i]->getCamera().getName() + "/image", _queueDepth,
+        boost::bind(&VelodynePostNode::imageCallback, this, _1, i));
     _subscriptionIsActive = true;
   }
 
@@ -214,6 +1875,9 @@ namespace velodyne {
       _velodyneBinarySnappySubscriber.shutdown();
     else
       _velodyneDataPacketSubscriber.shutdown();
+    for (auto it = _imageSubscribers.begin(); it != _imageSubscribers.end();
+        ++it)
+      it->shutdown();
     _subscriptionIsActive = false;
   }
 
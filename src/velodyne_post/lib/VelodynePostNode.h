@@ -27,17 +27,60 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
 
 #include <ros/ros.h>
 
 #include <velodyne/BinarySnappyMsg.h>
 #include <velodyne/DataPacketMsg.h>
 
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/Image.h>
+#include <geometry_msgs/TwistStamped.h>
+
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <pluginlib/class_loader.h>
+#include <tf/transform_listener.h>
+#include <rosgraph_msgs/TopicStatistics.h>
+
+#include <velodyne_post/QueryRegion.h>
+#include <velodyne_post/LaserStatistics.h>
+#include <velodyne_post/ScanMesh.h>
+#include <velodyne_post/SafetyStatus.h>
+#include <velodyne_post/AdaptiveScanInfo.h>
+
+#include "ScanBuffer.h"
+#include "CameraModel.h"
+#include "ScanStage.h"
+#include "TaskScheduler.h"
+#include "ConversionAutotuner.h"
+#include "NumaTopology.h"
+#include "SafetyMonitor.h"
+#include "MotionEstimator.h"
+#include "PerfCounters.h"
+
 class Calibration;
 class DataPacket;
 
 namespace velodyne {
 
+  class ScanConverter;
+  class VeilingFilter;
+  class ScanLogWriter;
+  class ScanCache;
+  class DepthImageProjector;
+  class PointColorizer;
+  class LaserStatistics;
+  class ScanExporter;
+  class LodServer;
+  class MeshGenerator;
+  class StaticMap;
+  class FailoverChannel;
+  class BandwidthController;
+
   /** The class VelodynePostNode implements the Velodyne post-processing node.
       \brief Velodyne post-processing node
     */
@@ -70,6 +113,55 @@ namespace velodyne {
       */
 
   protected:
+    /** \name Protected types
+      @{
+      */
+    /// Data and outputs of a scan going through the processing stages
+    struct ScanJob {
+      /// Data packets of the scan
+      std::vector<DataPacket> mDataPackets;
+      /// Timestamp of the scan
+      ros::Time mTimestamp;
+      /// Frame ID of the scan
+      std::string mFrameId;
+      /// Filters the scan for the point cloud, the export or the stream
+      bool mFilter;
+      /// Publishes the point cloud
+      bool mPublishPointCloud;
+      /// Streams the filtered scan to the level-of-detail clients
+      bool mStream;
+      /// Publishes the mesh
+      bool mPublishMesh;
+      /// Publishes the bandwidth-adaptive point cloud
+      bool mPublishAdaptive;
+      /// Publishes the high-intensity point cloud
+      bool mPublishIntensity;
+      /// Accumulates the per-laser statistics
+      bool mAccumulateStatistics;
+      /// Indices of the published depth images
+      std::vector<size_t> mDepthImages;
+      /// Converted scan
+      ScanBuffer mScan;
+      /// High-intensity returns
+      ScanBuffer mIntensityScan;
+      /// Converted sectors of the scan
+      std::vector<ScanBuffer> mSectorScans;
+      /// High-intensity returns of the sectors
+      std::vector<ScanBuffer> mSectorIntensityScans;
+      /// Serialized point cloud
+      sensor_msgs::PointCloud2Ptr mPointCloud;
+      /// Serialized high-intensity point cloud
+      sensor_msgs::PointCloud2Ptr mIntensityPointCloud;
+      /// Serialized mesh
+      velodyne_post::ScanMeshPtr mMesh;
+      /// Serialized bandwidth-adaptive point cloud
+      sensor_msgs::PointCloud2Ptr mAdaptivePointCloud;
+      /// Resolution of the bandwidth-adaptive point cloud
+      velodyne_post::AdaptiveScanInfoPtr mAdaptiveInfo;
+    };
+    /** @}
+      */
+
     /** \name Protected methods
       @{
       */
@@ -79,16 +171,145 @@ namespace velodyne {
     /// Velodyne callback for data packet
     void velodyneDataPacketCallback(const velodyne::DataPacketMsgConstPtr&
       msg);
+    /// Camera image callback for colorization
+    void imageCallback(const sensor_msgs::ImageConstPtr& msg, size_t
+      colorizerIdx);
+    /// Topic statistics callback for the bandwidth-adaptive point cloud
+    void statisticsCallback(const rosgraph_msgs::TopicStatisticsConstPtr&
+      msg);
     /// Retrieves parameters
     void getParameters();
+    /// Retrieves the protective fields from a parameter list
+    void getSafetyFieldParameters(const std::string& name,
+      std::vector<SafetyMonitor::Field>& fields);
+    /// Checks a data packet against the protective fields and publishes the
+    /// state if it changed
+    void checkSafetyFields(const DataPacket& dataPacket);
+    /// Adds a decoded data packet to the revolution, hands it off to the
+    /// publishing thread once complete
+    void addDataPacket(const DataPacket& dataPacket);
+    /// Hands the complete revolution off to the publishing thread
+    void handOff();
+    /// Publishes the revolutions handed off, on the publishing thread
+    void runPublication();
+    /// Keeps a data packet of the revolution in progress on the primary
+    void keepStandbyPacket(const DataPacket& dataPacket);
+    /// Takes the publishing over from a former primary, completing its
+    /// revolution in progress
+    void takeOver();
+    /// Refreshes the failover heartbeat
+    void beatFailover(const ros::TimerEvent& event);
+    /// Loads the processing stages from a parameter list
+    void loadStages(const std::string& name);
+    /// Retrieves the camera models from a parameter list
+    void getCameraParameters(const std::string& name,
+      std::vector<CameraModel>& cameras);
     /// Update subscription (subscribe only when subscriber is around)
     void updateSubscription(const ros::TimerEvent& event);
-    /// Publishes the currently stored data
+    /// Publishes the revolution taken by the publishing thread
     void publish();
+    /// Runs the stages of a scan on the calling thread
+    void runScan(ScanJob& job);
+    /// Schedules the stages of a scan on the task scheduler
+    void scheduleScan(const std::shared_ptr<ScanJob>& job);
+    /// Returns a scan job from the pool
+    std::shared_ptr<ScanJob> acquireJob();
+    /// Returns a scan job to the pool
+    void releaseJob(const std::shared_ptr<ScanJob>& job);
+    /// Returns true if the scan may be converted in independent sectors
+    bool isSectorConvertible(const ScanJob& job) const;
+    /// Configures the converter for the outputs of a scan
+    void configureConverter(const ScanJob& job);
+    /// Converts a scan
+    void convertScan(ScanJob& job);
+    /// Converts a sector of a scan
+    void convertSector(ScanJob& job, size_t sector, size_t numSectors);
+    /// Merges the converted sectors of a scan
+    void mergeSectors(ScanJob& job);
+    /// Deskews a scan with the latest velocity and hands it over to the
+    /// motion estimator
+    void estimateMotion(ScanJob& job);
+    /// Publishes an estimated velocity, called on the estimator thread
+    void publishTwist(const MotionEstimator::Motion& motion);
+    /// Removes the returns of a scan falling in the static map
+    void removeStaticReturns(ScanJob& job);
+    /// Runs the veiling filter and the processing stages on a scan
+    void filterScan(ScanJob& job);
+    /// Serializes the point cloud of a scan
+    void serializePointCloud(ScanJob& job);
+    /// Serializes the high-intensity point cloud of a scan
+    void serializeIntensityPointCloud(ScanJob& job);
+    /// Selects the level of the filtered scan for the link and serializes
+    /// the bandwidth-adaptive point cloud
+    void serializeAdaptivePointCloud(ScanJob& job);
+    /// Publishes the bandwidth-adaptive point cloud and its resolution
+    void publishAdaptivePointCloud(const ScanJob& job);
+    /// Triangulates the filtered scan and serializes the mesh
+    void serializeMesh(ScanJob& job);
+    /// Publishes a depth image of a scan
+    void publishDepthImage(const ScanJob& job, size_t cameraIdx);
+    /// Returns the counters for the processing stages, if they run on the
+    /// publishing thread
+    PerfCounters* getStagePerfCounters() const;
     /// Inits the subscribers
     void initSubscribers();
     /// Shutdowns the subscribers
     void shutdownSubscribers();
+    /// Returns the number of subscribers over all the outputs
+    uint32_t getNumSubscribers() const;
+    /// Returns true if any output needs the incoming data
+    bool isOutputActive() const;
+    /// Returns the timestamp of the revolution being published
+    ros::Time getScanTimestamp() const;
+    /// Publishes the per-laser statistics accumulated since the last call
+    void publishStatistics(const ros::TimerEvent& event);
+    /// Region query service callback
+    bool queryRegion(velodyne_post::QueryRegion::Request& request,
+      velodyne_post::QueryRegion::Response& response);
+    /// Selects the scheduler configuration from the cache or a benchmark
+    void autotune();
+    /// Diagnoses the autotuned configuration
+    void diagnoseAutotuning(diagnostic_updater::DiagnosticStatusWrapper&
+      status);
+    /// Binds the calling thread to the configured NUMA node
+    void bindToNumaNode();
+    /// Writes to the reserved buffers of a scan job from the calling thread
+    static void touchJob(ScanJob& job);
+    /// Diagnoses the bandwidth-adaptive output
+    void diagnoseAdaptiveOutput(diagnostic_updater::DiagnosticStatusWrapper&
+      status);
+    /// Diagnoses the publishing thread
+    void diagnosePublication(diagnostic_updater::DiagnosticStatusWrapper&
+      status);
+    /// Diagnoses the failover state
+    void diagnoseFailover(diagnostic_updater::DiagnosticStatusWrapper&
+      status);
+    /// Diagnoses the static map filter
+    void diagnoseStaticMap(diagnostic_updater::DiagnosticStatusWrapper&
+      status);
+    /// Diagnoses the motion estimation
+    void diagnoseMotionEstimation(diagnostic_updater::DiagnosticStatusWrapper&
+      status);
+    /// Diagnoses the protective fields
+    void diagnoseSafetyFields(diagnostic_updater::DiagnosticStatusWrapper&
+      status);
+    /// Diagnoses the level-of-detail streaming
+    void diagnoseStreaming(diagnostic_updater::DiagnosticStatusWrapper&
+      status);
+    /// Diagnoses the NUMA placement
+    void diagnoseNuma(diagnostic_updater::DiagnosticStatusWrapper& status);
+    /// Diagnoses the hardware performance counters
+    void diagnoseHardwareCounters(diagnostic_updater::DiagnosticStatusWrapper&
+      status);
+    /// Converts a scan buffer into a ROS point cloud
+    static void toRosPointCloud(const ScanBuffer& scan,
+      sensor_msgs::PointCloud2& pointCloud, bool withColor = false);
+    /// Converts the returns of a scan kept at a level of the bandwidth
+    /// controller into a ROS point cloud with the positions quantized to the
+    /// int16 fields qx, qy and qz
+    static void toQuantizedRosPointCloud(const ScanBuffer& scan,
+      const BandwidthController& controller, size_t level, sensor_msgs::
+      PointCloud2& pointCloud, bool withColor = false);
     /** @}
       */
 
@@ -107,20 +328,151 @@ namespace velodyne {
     std::string _calibFileName;
     /// Device name
     std::string _deviceName;
+    /// Return mode (single or dual)
+    std::string _returnMode;
+    /// Returns selected for the point cloud (strongest, last or both)
+    std::string _returnSelection;
     /// Min distance for conversions
     double _minDistance;
     /// Max distance for conversions
     double _maxDistance;
+    /// Data packet converter
+    std::shared_ptr<ScanConverter> _converter;
+    /// Enables range-adaptive downsampling
+    bool _downsamplingEnabled;
+    /// Distance beyond which all returns are kept
+    double _downsamplingReferenceDistance;
+    /// Minimum keep probability for close returns
+    double _downsamplingMinKeepProbability;
+    /// Per-laser weights on the keep probability
+    std::vector<double> _downsamplingLaserWeights;
+    /// Veiling points filter
+    std::shared_ptr<VeilingFilter> _veilingFilter;
+    /// Enables the veiling points filter
+    bool _veilingFilterEnabled;
+    /// Static map filter
+    std::shared_ptr<StaticMap> _staticMap;
+    /// Static map file name, empty to disable the filter
+    std::string _staticMapFileName;
+    /// Frame ID of the static map
+    std::string _staticMapFrameId;
+    /// Max time to wait for the pose of a scan [s]
+    double _staticMapTransformTimeout;
+    /// Number of scans after which an idle map tile is released
+    int _staticMapMaxIdleScans;
+    /// Number of scans passed unfiltered for lack of a pose since the last
+    /// diagnostics
+    std::atomic<size_t> _staticMapNumMissingPoses;
+    /// Transform listener providing the pose in the static map
+    std::shared_ptr<tf::TransformListener> _transformListener;
+    /// Loader of the processing stages, outlives the stages
+    pluginlib::ClassLoader<ScanStage> _stageLoader;
+    /// Processing stages in order
+    std::vector<boost::shared_ptr<ScanStage> > _stages;
+    /// Max angle between beam and neighbour segment for veiling points [deg]
+    double _veilingFilterMaxIncidenceAngle;
+    /// Max azimuth gap between neighbours for veiling points [deg]
+    double _veilingFilterMaxAzimuthGap;
+    /// Enables the high-intensity returns output
+    bool _intensityExtractionEnabled;
+    /// Intensity threshold for lasers without specific threshold
+    double _intensityExtractionDefaultThreshold;
+    /// Returns selected for the high-intensity output
+    std::string _intensityExtractionReturnSelection;
+    /// Per-laser intensity thresholds
+    std::vector<double> _intensityExtractionLaserThresholds;
+    /// Normalizes the intensity by distance before thresholding
+    bool _intensityExtractionNormalizeByDistance;
+    /// Reference distance for intensity normalization
+    double _intensityExtractionReferenceDistance;
+    /// High-intensity point cloud publisher
+    ros::Publisher _intensityPointCloudPublisher;
+    /// High-intensity point cloud topic name
+    std::string _intensityPointCloudTopicName;
+    /// Enables the per-laser statistics
+    bool _statisticsEnabled;
+    /// Publishing rate of the per-laser statistics [Hz]
+    double _statisticsPublishRate;
+    /// Per-laser statistics
+    std::shared_ptr<LaserStatistics> _laserStatistics;
+    /// Per-laser statistics publisher
+    ros::Publisher _laserStatisticsPublisher;
+    /// Per-laser statistics topic name
+    std::string _laserStatisticsTopicName;
+    /// Enables the mesh output
+    bool _meshingEnabled;
+    /// Max ratio between the longest and the shortest range of a triangle
+    double _meshingMaxRangeRatio;
+    /// Max angle between beam and triangle normal [deg]
+    double _meshingMaxIncidenceAngle;
+    /// Max azimuth gap between neighbour columns [deg]
+    double _meshingMaxAzimuthGap;
+    /// Mesh generator
+    std::shared_ptr<MeshGenerator> _meshGenerator;
+    /// Mesh publisher
+    ros::Publisher _meshPublisher;
+    /// Mesh topic name
+    std::string _meshTopicName;
+    /// Enables the bandwidth-adaptive point cloud
+    bool _adaptiveOutputEnabled;
+    /// Number of levels of the bandwidth-adaptive point cloud
+    int _adaptiveOutputNumLevels;
+    /// Target latency of the bandwidth-adaptive point cloud [s]
+    double _adaptiveOutputTargetLatency;
+    /// Reference distance of the decimation at level 2 [m]
+    double _adaptiveOutputReferenceDistance;
+    /// Minimum keep probability of the decimation at level 2
+    double _adaptiveOutputMinKeepProbability;
+    /// Position resolution of the quantized levels [m]
+    double _adaptiveOutputResolution;
+    /// Throughput of the link until the subscribers report statistics [B/s]
+    double _adaptiveOutputInitialThroughput;
+    /// Growth factor of the throughput estimate per statistics window
+    double _adaptiveOutputProbeFactor;
+    /// Resolution controller of the bandwidth-adaptive point cloud
+    std::shared_ptr<BandwidthController> _bandwidthController;
+    /// Mutex protecting the resolution controller
+    std::mutex _bandwidthMutex;
+    /// Level of the last bandwidth-adaptive scan
+    size_t _adaptiveLevel;
+    /// Bandwidth-adaptive point cloud publisher
+    ros::Publisher _adaptivePointCloudPublisher;
+    /// Bandwidth-adaptive point cloud topic name
+    std::string _adaptivePointCloudTopicName;
+    /// Bandwidth-adaptive point cloud resolution publisher
+    ros::Publisher _adaptiveInfoPublisher;
+    /// Bandwidth-adaptive point cloud resolution topic name
+    std::string _adaptiveInfoTopicName;
+    /// Topic statistics subscriber
+    ros::Subscriber _statisticsSubscriber;
+    /// Per-laser statistics publishing timer
+    ros::Timer _statisticsTimer;
     /// Velodyne binary snappy topic name
     std::string _velodyneBinarySnappyTopicName;
     /// Velodyne data packet topic name
     std::string _velodyneDataPacketTopicName;
-    /// Vector for queuing the data packets
+    /// Data packets of the revolution in progress, only accessed by the
+    /// node thread
     std::vector<DataPacket> _dataPackets;
     /// Queue size for receiving messages
     int _queueDepth;
     /// Number of data packets to accumulate before publishing
     int _numDataPackets;
+    /// Enables the hot-standby failover
+    bool _failoverEnabled;
+    /// Name of the failover shared memory segment
+    std::string _failoverShmName;
+    /// Age of a stale heartbeat of the primary [s]
+    double _failoverHeartbeatTimeout;
+    /// Failover channel shared with the primary or the standbys
+    std::shared_ptr<FailoverChannel> _failoverChannel;
+    /// Failover heartbeat timer
+    ros::Timer _failoverTimer;
+    /// Whether the node is a standby, keeping its state warm without
+    /// publishing
+    bool _standby;
+    /// Packets of the revolution in progress read from the failover ring
+    std::vector<DataPacket> _failoverPackets;
     /// Point cloud publisher
     ros::Publisher _pointCloudPublisher;
     /// Point cloud topic name
@@ -133,10 +485,190 @@ namespace velodyne {
     ros::TransportHints _transportHints;
     /// Transport type (tcp or udp)
     std::string _transportType;
+    /// Enables the compressed scan logging
+    bool _loggingEnabled;
+    /// Compressed scan log file name
+    std::string _logFileName;
+    /// Compressed scan log writer, only accessed by the publishing thread
+    std::shared_ptr<ScanLogWriter> _logWriter;
+    /// Whether the scans are logged
+    std::atomic<bool> _logging;
+    /// Cameras for the depth images
+    std::vector<CameraModel> _depthImageCameras;
+    /// Depth image projectors
+    std::vector<std::shared_ptr<DepthImageProjector> > _depthProjectors;
+    /// Depth image publishers
+    std::vector<ros::Publisher> _depthImagePublishers;
+    /// Cameras for the colorization
+    std::vector<CameraModel> _colorizationCameras;
+    /// Number of images buffered per camera for the colorization
+    int _colorizationNumImages;
+    /// Max time offset between a packet and a colorization image [s]
+    double _colorizationMaxTimeOffset;
+    /// Colorizers
+    std::vector<std::shared_ptr<PointColorizer> > _colorizers;
+    /// Colorization image subscribers
+    std::vector<ros::Subscriber> _imageSubscribers;
+    /// Enables the scan-to-scan motion estimation
+    bool _motionEstimationEnabled;
+    /// Grid columns between feature columns
+    int _motionEstimationColumnStride;
+    /// Max number of registration iterations
+    int _motionEstimationMaxIterations;
+    /// Max distance between corresponding features [m]
+    double _motionEstimationMaxCorrespondenceDistance;
+    /// Point-to-plane distance beyond which the loss is linear [m]
+    double _motionEstimationHuberThreshold;
+    /// Min number of correspondences for a registration
+    int _motionEstimationMinCorrespondences;
+    /// Max time between registered scans [s]
+    double _motionEstimationMaxScanGap;
+    /// Motion estimator
+    std::shared_ptr<MotionEstimator> _motionEstimator;
+    /// Frame ID of the scans handed over to the motion estimator
+    std::string _motionFrameId;
+    /// Mutex protecting the frame ID of the motion estimator
+    std::mutex _motionMutex;
+    /// Velocity publisher
+    ros::Publisher _twistPublisher;
+    /// Velocity topic name
+    std::string _twistTopicName;
+    /// Protective fields
+    std::vector<SafetyMonitor::Field> _safetyFields;
+    /// Resolution of the precomputed field boundaries [deg]
+    double _safetyAzimuthResolution;
+    /// Number of returns inside a field in one packet to violate it
+    int _safetyMinReturns;
+    /// Delay without violation before a field is cleared [s]
+    double _safetyClearDelay;
+    /// Protective field monitor
+    std::shared_ptr<SafetyMonitor> _safetyMonitor;
+    /// Protective field state publisher
+    ros::Publisher _safetyStatusPublisher;
+    /// Protective field state topic name
+    std::string _safetyStatusTopicName;
+    /// Number of latest scans kept for region queries (0 disables)
+    int _cacheNumScans;
+    /// Cache of the latest scans
+    std::shared_ptr<ScanCache> _scanCache;
+    /// Mutex protecting the cache from the region queries
+    std::mutex _cacheMutex;
+    /// Region query service
+    ros::ServiceServer _queryRegionService;
+    /// Region query service name
+    std::string _queryRegionServiceName;
+    /// Enables the hardware performance counters
+    bool _hardwareCountersEnabled;
+    /// Hardware performance counters
+    std::shared_ptr<PerfCounters> _perfCounters;
+    /// Diagnostic updater
+    diagnostic_updater::Updater _updater;
     /// Flag for active subscribtions
     bool _subscriptionIsActive;
     /// Update subscription callback timer
     ros::Timer _timer;
+    /// Number of scheduler threads (0 runs the stages on the publishing
+    /// thread)
+    int _schedulerNumThreads;
+    /// Number of sectors converted in parallel (0 for the number of threads)
+    int _schedulerNumSectors;
+    /// Max number of scans in the scheduler
+    int _schedulerMaxScansInFlight;
+    /// Enables the autotuning of the scheduler
+    bool _autotuningEnabled;
+    /// Time budget of the autotuning benchmark [s]
+    double _autotuningBudget;
+    /// Cache file of the autotuned configurations
+    std::string _autotuningCacheFileName;
+    /// CPU model the configuration was tuned for
+    std::string _autotuningCpuModel;
+    /// Cache key of the configuration
+    std::string _autotuningCacheKey;
+    /// Autotuned configuration
+    ConversionAutotuner::Configuration _autotunedConfiguration;
+    /// Autotuned configuration comes from the cache
+    bool _autotuningCached;
+    /// Export file of the filtered scans (empty to disable)
+    std::string _exportFileName;
+    /// Export format, arrow or parquet
+    std::string _exportFormat;
+    /// Exporter of the filtered scans
+    std::shared_ptr<ScanExporter> _scanExporter;
+    /// Exports the filtered scans, cleared on export errors
+    std::atomic<bool> _exporting;
+    /// Enables the level-of-detail streaming server
+    bool _streamingEnabled;
+    /// Address the streaming server binds to
+    std::string _streamingBindAddress;
+    /// Port of the streaming server
+    int _streamingPort;
+    /// Voxel size of the coarsest streamed level [m]
+    double _streamingVoxelSize;
+    /// Number of streamed levels
+    int _streamingNumLevels;
+    /// Max number of streaming clients
+    int _streamingMaxClients;
+    /// Level-of-detail streaming server
+    std::shared_ptr<LodServer> _lodServer;
+    /// NUMA node of the node and publishing threads, the workers and the
+    /// buffers (-1 for no binding)
+    int _numaNode;
+    /// Allocates the buffers by touching them from the bound thread
+    bool _numaFirstTouch;
+    /// NUMA topology of the machine
+    std::shared_ptr<NumaTopology> _numaTopology;
+    /// Allocation counters of the NUMA node at the last diagnostics
+    NumaTopology::Counters _numaCounters;
+    /// Mutex protecting the converter state shared with the callbacks
+    std::mutex _conversionMutex;
+    /// Mutex protecting the scan jobs
+    std::mutex _jobsMutex;
+    /// Signals the completion of a scheduled scan
+    std::condition_variable _jobsCondition;
+    /// Number of scans in the scheduler
+    size_t _numScansInFlight;
+    /// Pool of scan jobs
+    std::vector<std::shared_ptr<ScanJob> > _freeJobs;
+    /// Conversion task of the previous scan
+    TaskScheduler::TaskPtr _lastConvertTask;
+    /// Filter task of the previous scan
+    TaskScheduler::TaskPtr _lastFilterTask;
+    /// Streaming task of the previous scan
+    TaskScheduler::TaskPtr _lastStreamTask;
+    /// Point cloud publishing task of the previous scan
+    TaskScheduler::TaskPtr _lastPointCloudTask;
+    /// Mesh publishing task of the previous scan
+    TaskScheduler::TaskPtr _lastMeshTask;
+    /// Bandwidth-adaptive point cloud publishing task of the previous scan
+    TaskScheduler::TaskPtr _lastAdaptiveTask;
+    /// High-intensity point cloud publishing task of the previous scan
+    TaskScheduler::TaskPtr _lastIntensityTask;
+    /// Depth image publishing tasks of the previous scan
+    std::vector<TaskScheduler::TaskPtr> _lastDepthImageTasks;
+    /// Mutex protecting the revolution handed off to the publishing thread
+    std::mutex _scanMutex;
+    /// Signals a revolution or the stop to the publishing thread
+    std::condition_variable _scanCondition;
+    /// Revolution handed off and not yet taken by the publishing thread
+    std::vector<DataPacket> _pendingPackets;
+    /// Frame ID of the revolution handed off
+    std::string _pendingFrameId;
+    /// Number of revolutions replaced before the publishing thread took them
+    size_t _numSkippedScans;
+    /// Stage counters handed over by the publishing thread
+    PerfCounters::Totals _stageTotals[PerfCounters::numStages];
+    /// Stops the publishing thread
+    bool _stopPublishing;
+    /// Revolution being published, only accessed by the publishing thread
+    std::vector<DataPacket> _scanPackets;
+    /// Frame ID of the revolution being published
+    std::string _scanFrameId;
+    /// Counters of the stages run by the publishing thread
+    std::shared_ptr<PerfCounters> _stagePerfCounters;
+    /// Publishing thread, the packet callbacks never wait for a publication
+    std::thread _publishThread;
+    /// Task scheduler, destroyed first such that pending stages complete
+    std::shared_ptr<TaskScheduler> _scheduler;
     /** @}
       */
 
@@ -0,0 +1,151 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file velodyne_post_safety_monitor_test.cpp
+    \brief This file tests the protective fields by firing beams at their
+           corners.
+  */
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <libvelodyne/sensor/Calibration.h>
+#include <libvelodyne/sensor/DataPacket.h>
+
+#include "SafetyMonitor.h"
+#include "ScanConverter.h"
+
+using namespace velodyne;
+
+namespace {
+
+  /// Returns a 2D field with the vertices of a polygon rotated by an angle
+  SafetyMonitor::Field makeField(const char* name, const double vertices[][2],
+      size_t numVertices, double angle) {
+    SafetyMonitor::Field field;
+    field.mName = name;
+    for (size_t i = 0; i < numVertices; ++i) {
+      field.mX.push_back(std::cos(angle) * vertices[i][0] -
+        std::sin(angle) * vertices[i][1]);
+      field.mY.push_back(std::sin(angle) * vertices[i][0] +
+        std::cos(angle) * vertices[i][1]);
+    }
+    field.mMinZ = -std::numeric_limits<double>::infinity();
+    field.mMaxZ = std::numeric_limits<double>::infinity();
+    return field;
+  }
+
+  /// Fills a packet whose blocks hold one return of a laser of the upper
+  /// bank, on the beam through a point of the xy-plane, returns false if the
+  /// laser cannot measure the point
+  bool fireAt(const ScanConverter& converter, size_t laser, double x,
+      double y, DataPacket& dataPacket) {
+    const ScanConverter::LaserCorrection& correction =
+      converter.getCorrection(laser);
+    // the beam at angle a runs along u = (cos(a), -sin(a)) at the horizontal
+    // offset along n = (sin(a), cos(a))
+    const double r = std::hypot(x, y);
+    const double angle = std::asin(correction.mHorizOffsetCorrection / r) -
+      std::atan2(y, x);
+    const double rotation = angle + std::atan2(correction.mSinRotCorrection,
+      correction.mCosRotCorrection);
+    const double horizDistance = x * std::cos(angle) - y * std::sin(angle) +
+      correction.mVertOffsetCorrection * correction.mSinVertCorrection;
+    const double rawDistance = std::round((horizDistance /
+      correction.mCosVertCorrection - correction.mDistCorrection) /
+      ScanConverter::mDistanceResolution);
+    if (rawDistance < 1.0 || rawDistance > 65535.0)
+      return false;
+    DataPacket::DataChunk dataChunk;
+    dataChunk.mHeaderInfo = ScanConverter::mUpperBank;
+    dataChunk.mRotationalInfo = static_cast<long>(std::round(rotation /
+      ScanConverter::mRotationResolution) + 36000) % 36000;
+    for (size_t i = 0; i < DataPacket::DataChunk::mLasersPerPacket; ++i) {
+      dataChunk.mLaserData[i].mDistance = 0;
+      dataChunk.mLaserData[i].mIntensity = 0;
+    }
+    dataChunk.mLaserData[laser].mDistance = rawDistance;
+    for (size_t i = 0; i < DataPacket::mDataChunkNbr; ++i)
+      dataPacket.setDataChunk(dataChunk, i);
+    dataPacket.setTimestamp(0);
+    return true;
+  }
+
+}
+
+int main() {
+  // a rectangle around the sensor and a thin diamond pointing at it, its
+  // nearest corner halfway between two beams sampled in a bin
+  const double rectangle[][2] = {{1.5, 0.8}, {1.5, -0.8}, {-1.0, -0.8},
+    {-1.0, 0.8}};
+  const double diamond[][2] = {{2.0, 0.0}, {4.0, 0.3}, {6.0, 0.0},
+    {4.0, -0.3}};
+  const double azimuthResolution = 2.0 * M_PI / 180.0;
+  std::vector<SafetyMonitor::Field> fields;
+  fields.push_back(makeField("rectangle", rectangle, 4, 0.0));
+  fields.push_back(makeField("diamond", diamond, 4,
+    -0.25 * azimuthResolution));
+  Calibration calibration;
+  ScanConverter converter(calibration, 0.9, 120.0);
+  SafetyMonitor monitor(converter, fields, 0.9, 120.0, azimuthResolution, 1,
+    0);
+  // a return 2 cm inside each corner must be counted by every laser
+  const double inset = 0.02;
+  DataPacket dataPacket;
+  size_t numFailures = 0;
+  for (size_t field = 0; field < fields.size(); ++field) {
+    const SafetyMonitor::Field& f = fields[field];
+    const size_t numVertices = f.mX.size();
+    double centerX = 0, centerY = 0;
+    for (size_t i = 0; i < numVertices; ++i) {
+      centerX += f.mX[i] / numVertices;
+      centerY += f.mY[i] / numVertices;
+    }
+    for (size_t i = 0; i < numVertices; ++i) {
+      const double dx = centerX - f.mX[i];
+      const double dy = centerY - f.mY[i];
+      const double length = std::hypot(dx, dy);
+      const double x = f.mX[i] + inset * dx / length;
+      const double y = f.mY[i] + inset * dy / length;
+      for (size_t laser = 0; laser < DataPacket::DataChunk::mLasersPerPacket;
+          ++laser) {
+        if (!fireAt(converter, laser, x, y, dataPacket))
+          continue;
+        monitor.update(dataPacket);
+        if (monitor.getNumReturns()[field] == 0) {
+          std::cerr << "missed corner " << i << " of field " << f.mName
+            << " with laser " << laser << std::endl;
+          ++numFailures;
+        }
+      }
+    }
+  }
+  // a return behind the sensor is outside the diamond
+  if (fireAt(converter, 0, -3.0, 0.0, dataPacket)) {
+    monitor.update(dataPacket);
+    if (monitor.getNumReturns()[1] != 0) {
+      std::cerr << "counted a return outside field diamond" << std::endl;
+      ++numFailures;
+    }
+  }
+  std::cout << "failures: " << numFailures << std::endl;
+  return numFailures ? 1 : 0;
+}
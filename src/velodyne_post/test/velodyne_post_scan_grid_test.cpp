@@ -0,0 +1,111 @@
+/******************************************************************************
+ * Copyright (C) 2014 by Jerome Maye                                          *
+ * jerome.maye@gmail.com                                                      *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the Lesser GNU General Public License as published by*
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * Lesser GNU General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the Lesser GNU General Public License   *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.       *
+ ******************************************************************************/
+
+/** \file velodyne_post_scan_grid_test.cpp
+    \brief This file tests the layout of filtered scans on the scan grid.
+  */
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "ScanBuffer.h"
+#include "ScanGrid.h"
+
+using namespace velodyne;
+
+namespace {
+
+  /// Fills a scan with the returns of the lasers fired at a given fraction
+  /// of the firing step, drops a pseudo-random third of the returns and
+  /// returns the firing of each return, dual returns duplicate the first
+  /// remaining return of a firing at the same azimuth
+  std::vector<size_t> makeScan(const std::vector<double>& firingFractions,
+      size_t numFirings, uint16_t firingStep, bool dualReturns,
+      ScanBuffer& scan) {
+    std::vector<size_t> firings;
+    scan.clear();
+    uint32_t state = 42;
+    for (size_t firing = 0; firing < numFirings; ++firing) {
+      bool first = true;
+      for (size_t laser = 0; laser < firingFractions.size(); ++laser) {
+        state = state * 1664525 + 1013904223;
+        // the last laser of a firing is kept, such that no column is empty
+        if (laser + 1 < firingFractions.size() && (state >> 16) % 3 == 0)
+          continue;
+        const uint16_t azimuth = (35000 + firing * firingStep +
+          std::lround(firingFractions[laser] * firingStep)) % 36000;
+        for (size_t i = 0; i < (dualReturns && first ? 2 : 1); ++i) {
+          scan.push_back(0, 0, 0, 0, 10.0 + i, laser, azimuth);
+          firings.push_back(firing);
+        }
+        first = false;
+      }
+    }
+    return firings;
+  }
+
+  /// Returns the number of returns not laid out at their firing
+  size_t check(const std::vector<double>& firingFractions, size_t numFirings,
+      uint16_t firingStep, bool dualReturns) {
+    std::vector<double> elevations(firingFractions.size());
+    for (size_t i = 0; i < elevations.size(); ++i)
+      elevations[i] = elevations.size() - i;
+    ScanGrid grid(elevations, firingFractions);
+    ScanBuffer scan;
+    const std::vector<size_t> firings = makeScan(firingFractions, numFirings,
+      firingStep, dualReturns, scan);
+    grid.fill(scan);
+    size_t numFailures = 0;
+    if (grid.getNumColumns() != numFirings) {
+      std::cerr << grid.getNumColumns() << " columns for " << numFirings
+        << " firings" << std::endl;
+      ++numFailures;
+    }
+    for (size_t i = 0; i < scan.size(); ++i) {
+      // the second return of a dual-return firing is not laid out
+      if (i > 0 && scan.mRing[i] == scan.mRing[i - 1])
+        continue;
+      const size_t column = firings[i];
+      if (column >= grid.getNumColumns() ||
+          grid.getColumn(column)[grid.getRow(scan.mRing[i])] != i) {
+        std::cerr << "return " << i << " of laser " << scan.mRing[i]
+          << " not in column " << column << std::endl;
+        ++numFailures;
+      }
+    }
+    return numFailures;
+  }
+
+}
+
+int main() {
+  size_t numFailures = 0;
+  // lasers firing together, in single and dual-return mode
+  numFailures += check(std::vector<double>(32, 0.0), 500, 16, false);
+  numFailures += check(std::vector<double>(32, 0.0), 500, 16, true);
+  // lasers firing in sequence over the firing step
+  std::vector<double> firingFractions(16);
+  for (size_t i = 0; i < firingFractions.size(); ++i)
+    firingFractions[i] = i / 24.0;
+  numFailures += check(firingFractions, 500, 20, false);
+  numFailures += check(firingFractions, 500, 20, true);
+  std::cout << "failures: " << numFailures << std::endl;
+  return numFailures ? 1 : 0;
+}